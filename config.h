@@ -0,0 +1,6 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#define SO_REUSEPORT_FOUND
+
+#endif /* CONFIG_H */
@@ -31,18 +31,17 @@ rapp_serve(struct RappContainer *handle,
   int err = -1;
   if (handle) {
     size_t len = strlen(handle->message);
-    char *len_s = NULL;
 
     http_response_write_status_line_by_code(response, 200);
     http_response_write_header(response, "Content-Type", "text/plain; charset=utf-8");
 
-    asprintf(&len_s, "%lu", len);
-    http_response_write_header(response, "Content-Length", len_s);
-    free(len_s);
+    /* released with the request */
+    http_response_write_header(response, "Content-Length", rapp_request_sprintf(http_request, "%zu", len));
 
     http_response_end_headers(response);
 
-    http_response_append_data(response, handle->message, len);
+    /* the message lives as long as the container */
+    http_response_append_borrowed_data(response, handle->message, len);
 
     err = 0;
   }
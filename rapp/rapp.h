@@ -8,6 +8,7 @@
 #ifndef RAPP_H
 #define RAPP_H
 
+#include "rapp_async.h"
 #include "rapp_httprequest.h"
 #include "rapp_httpresponse.h"
 #include "rapp_logger.h"
@@ -21,10 +22,37 @@ struct RappContainer *rapp_create(void *cookie, struct RappConfig *config, int *
 int rapp_destroy(struct RappContainer *handle);
 int rapp_init(struct RappContainer *handle, struct RappConfig *config);
 
+/*
+ * rapp_serve is invoked concurrently by all the worker threads:
+ * the handle must be treated as read-only once rapp_init returned.
+ */
 int rapp_serve(struct RappContainer *handle,
                struct HTTPRequest *http_request,
                struct HTTPResponse *response);
 
+/*
+ * rapp_serve_async is optional, and used instead of rapp_serve when the
+ * plugin exports it. Returning RAPP_SERVE_PENDING the plugin keeps the
+ * request and the response until it calls rapp_async_complete on the
+ * context; any other value means the response is already complete.
+ * A plugin exporting it can omit rapp_serve.
+ */
+int rapp_serve_async(struct RappContainer    *handle,
+                     struct HTTPRequest      *http_request,
+                     struct HTTPResponse     *response,
+                     struct RappAsyncContext *context);
+
+/*
+ * rapp_stream_body is optional, and only used with rapp_serve_async: it's
+ * asked about the requests with a body once their headers are received.
+ * Returning non zero the request is served right away, without its body,
+ * which is then passed to the callback set with rapp_async_set_body_callback
+ * as it arrives. The other bodies are buffered, up to the max_body_size
+ * core option.
+ */
+int rapp_stream_body(struct RappContainer *handle,
+                     struct HTTPRequest   *http_request);
+
 #endif /* RAPP_H */
 
 /*
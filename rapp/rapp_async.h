@@ -0,0 +1,74 @@
+/*
+ * rapp_async.h - is part of the public API of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#ifndef RAPP_ASYNC_H
+#define RAPP_ASYNC_H
+
+#include <stddef.h>
+
+/* returned by rapp_serve_async when the response will be completed later */
+#define RAPP_SERVE_PENDING 1
+
+/*
+ * the completion handle of a request served asynchronously. It belongs to
+ * the worker thread serving the request: all the functions below must be
+ * called from it, that is from the callbacks of the context.
+ */
+struct RappAsyncContext;
+
+enum RappAsyncEvent {
+  RAPP_ASYNC_READ = 0,
+  RAPP_ASYNC_WRITE,
+};
+
+typedef void (*RappAsyncFdCallback)(struct RappAsyncContext *context, int fd, void *data);
+typedef void (*RappAsyncCancelCallback)(struct RappAsyncContext *context, void *data);
+typedef void (*RappAsyncBodyCallback)(struct RappAsyncContext *context, const char *chunk, size_t length, void *data);
+typedef void (*RappAsyncWorkCallback)(void *data);
+typedef void (*RappAsyncDoneCallback)(struct RappAsyncContext *context, void *data);
+typedef void (*RappAsyncDrainCallback)(struct RappAsyncContext *context, void *data);
+
+/* the watches last until removed or until the request completes */
+int rapp_async_watch_fd(struct RappAsyncContext *context, int fd, enum RappAsyncEvent event, RappAsyncFdCallback callback, void *data);
+int rapp_async_unwatch_fd(struct RappAsyncContext *context, int fd, enum RappAsyncEvent event);
+
+/*
+ * invoked if the connection goes away while the request is pending: once
+ * it returns the context, the request and the response are gone.
+ */
+void rapp_async_set_cancel_callback(struct RappAsyncContext *context, RappAsyncCancelCallback callback, void *data);
+
+/*
+ * for the requests streaming their body: the chunks are only valid during
+ * the call, and an empty one tells the body is over.
+ */
+void rapp_async_set_body_callback(struct RappAsyncContext *context, RappAsyncBodyCallback callback, void *data);
+
+/*
+ * runs work on a thread of the offload pool, for what would block the
+ * worker: done is called back on the worker thread once it returns. If the
+ * request went away in the meantime, done gets a NULL context and must only
+ * release data, so the cancel callback must leave it alone.
+ */
+int rapp_async_offload(struct RappAsyncContext *context, RappAsyncWorkCallback work, RappAsyncDoneCallback done, void *data);
+
+/*
+ * sends what's written to the response so far, without completing it, and
+ * calls the drain callback once it's all gone to the socket: writing the
+ * next part only then keeps in memory no more than a part at a time.
+ */
+void rapp_async_flush(struct RappAsyncContext *context);
+void rapp_async_set_drain_callback(struct RappAsyncContext *context, RappAsyncDrainCallback callback, void *data);
+
+/* the response is complete: it's sent, and the context can't be used anymore */
+void rapp_async_complete(struct RappAsyncContext *context);
+
+#endif /* RAPP_ASYNC_H */
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
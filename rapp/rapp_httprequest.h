@@ -14,6 +14,9 @@
  */
 #define HTTP_REQUEST_MAX_HEADERS 100
 
+/* the :param and *wildcard segments a route pattern can capture */
+#define HTTP_REQUEST_MAX_PARAMS 8
+
 #define EXTRACT_MEMORY_RANGE(dest, buffer, range)       \
 do {                                                    \
   dest = alloca(range.length + 1);                      \
@@ -72,8 +75,29 @@ enum HTTPURLField {
   HTTP_URL_FIELD_MAX
 };
 
+/* the headers with a slot of their own in every request */
+enum HTTPHeader {
+  HTTP_HEADER_ACCEPT,
+  HTTP_HEADER_ACCEPT_ENCODING,
+  HTTP_HEADER_AUTHORIZATION,
+  HTTP_HEADER_CONNECTION,
+  HTTP_HEADER_CONTENT_LENGTH,
+  HTTP_HEADER_CONTENT_TYPE,
+  HTTP_HEADER_COOKIE,
+  HTTP_HEADER_HOST,
+  HTTP_HEADER_IF_MODIFIED_SINCE,
+  HTTP_HEADER_IF_NONE_MATCH,
+  HTTP_HEADER_TRANSFER_ENCODING,
+  HTTP_HEADER_USER_AGENT,
+  HTTP_HEADER_MAX
+};
+
 struct HTTPRequest;
 
+/*
+ * The buffers belong to the connection the request came from: they're not
+ * null terminated, and they are valid only while the request is served.
+ */
 const char *http_request_get_headers_buffer(struct HTTPRequest *request);
 
 enum HTTPMethod http_request_get_method(struct HTTPRequest *request);
@@ -82,9 +106,24 @@ void http_request_get_url_range(struct HTTPRequest *request, struct MemoryRange
 int http_request_get_url_field_range(struct HTTPRequest *request, enum HTTPURLField field, struct MemoryRange *range);
 
 int http_request_get_header_value_range(struct HTTPRequest *request, const char *header_name, struct MemoryRange *range);
+/* the same for the well known headers, without hashing the name */
+int http_request_get_known_header_range(struct HTTPRequest *request, enum HTTPHeader header, struct MemoryRange *range);
 void http_request_get_headers_ranges(struct HTTPRequest *request, struct HeaderMemoryRange **ranges, unsigned *n_ranges);
 
+/* the path segments captured by the route pattern, by their name in it */
+int http_request_get_param_range(struct HTTPRequest *request, const char *name, struct MemoryRange *range);
+
 const char *http_request_get_body(struct HTTPRequest *request);
+size_t http_request_get_body_length(struct HTTPRequest *request);
+
+/*
+ * Memory that lives as long as the request, for the values needed while
+ * serving it: it must not be freed, it's released all at once after the
+ * request is served. It's not zeroed, and since the response may be sent
+ * later it can't be used as borrowed response data.
+ */
+void *rapp_request_alloc(struct HTTPRequest *request, size_t size);
+char *rapp_request_sprintf(struct HTTPRequest *request, const char *format, ...) __attribute__((format(printf, 2, 3)));
 
 #endif /* RAPP_HTTPREQUEST_H */
 /*
@@ -8,6 +8,8 @@
 #ifndef RAPP_HTTPRESPONSE_H
 #define RAPP_HTTPRESPONSE_H
 
+#include <sys/types.h>
+
 #define HTTP_EOL "\r\n"
 
 struct HTTPResponse;
@@ -19,6 +21,17 @@ ssize_t http_response_write_header(struct HTTPResponse *response, const char *ke
 ssize_t http_response_end_headers(struct HTTPResponse *response);
 
 ssize_t http_response_append_data(struct HTTPResponse *response, const void *data, size_t length);
+/* like append_data without copying: data must stay valid until the response is sent */
+ssize_t http_response_append_borrowed_data(struct HTTPResponse *response, const void *data, size_t length);
+/* sends length bytes of the file from offset with sendfile; takes ownership of fd on success */
+ssize_t http_response_send_file(struct HTTPResponse *response, int fd, off_t offset, size_t length);
+
+/*
+ * a body sent in chunks while it's produced: begin_chunked ends the
+ * headers, and a chunk of length 0 ends the body.
+ */
+ssize_t http_response_begin_chunked(struct HTTPResponse *response);
+ssize_t http_response_write_chunk(struct HTTPResponse *response, const void *data, size_t length);
 
 ssize_t http_response_write_error_by_code(struct HTTPResponse *response, unsigned code);
 
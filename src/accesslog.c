@@ -0,0 +1,247 @@
+/*
+ * accesslog.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include <sys/mman.h>
+
+#include "rapp/rapp_httprequest.h"
+
+#include "accesslog.h"
+#include "logger.h"
+#include "memory.h"
+
+
+/*
+ * The records go straight into a file segment mapped in memory, the
+ * kernel writes them back on its own. A full segment is truncated to the
+ * records written, renamed to path.N with the first N free, and a new one
+ * takes its place. An access log belongs to a single thread.
+ */
+struct AccessLog {
+  char *path;
+  size_t segment_size;
+  unsigned next_rotation;
+
+  int fd;
+  char *segment;
+  size_t length;
+
+  struct Logger *logger;
+};
+
+
+static int
+close_segment(struct AccessLog *log)
+{
+  int ret = 0;
+
+  if (munmap(log->segment, log->segment_size) < 0) {
+    LOGGER_PERROR(log->logger, "munmap");
+    ret = -1;
+  }
+
+  if (ftruncate(log->fd, log->length) < 0) {
+    LOGGER_PERROR(log->logger, "ftruncate");
+    ret = -1;
+  }
+
+  close(log->fd);
+  log->fd = -1;
+  log->segment = NULL;
+
+  return ret;
+}
+
+static int
+open_segment(struct AccessLog *log)
+{
+  struct AccessLogHeader header;
+
+  if ((log->fd = open(log->path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0) {
+    logger_trace(log->logger, LOG_ERROR, "accesslog", "open %s: %s", log->path, strerror(errno));
+    return -1;
+  }
+
+  if (ftruncate(log->fd, log->segment_size) < 0) {
+    LOGGER_PERROR(log->logger, "ftruncate");
+    close(log->fd);
+    return -1;
+  }
+
+  if ((log->segment = mmap(NULL, log->segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, log->fd, 0)) == MAP_FAILED) {
+    LOGGER_PERROR(log->logger, "mmap");
+    close(log->fd);
+    return -1;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ACCESS_LOG_MAGIC, sizeof(header.magic));
+  header.version = ACCESS_LOG_VERSION;
+  header.record_size = sizeof(struct AccessLogRecord);
+
+  memcpy(log->segment, &header, sizeof(header));
+  log->length = sizeof(header);
+
+  return 0;
+}
+
+/* moves the file at path out of the way, if any */
+static int
+move_segment(struct AccessLog *log)
+{
+  char rotated[PATH_MAX];
+
+  if (access(log->path, F_OK) < 0)
+    return 0;
+
+  do {
+    snprintf(rotated, sizeof(rotated), "%s.%u", log->path, ++log->next_rotation);
+  } while (access(rotated, F_OK) == 0);
+
+  if (rename(log->path, rotated) < 0) {
+    logger_trace(log->logger, LOG_ERROR, "accesslog", "rename %s: %s", log->path, strerror(errno));
+    return -1;
+  }
+
+  return 0;
+}
+
+/* a file already at path is rotated first */
+struct AccessLog *
+access_log_new(struct Logger *logger,
+               const char    *path,
+               size_t         segment_size)
+{
+  struct AccessLog *log = NULL;
+
+  assert(logger != NULL);
+  assert(path != NULL);
+  assert(segment_size >= sizeof(struct AccessLogHeader) + sizeof(struct AccessLogRecord));
+
+  if ((log = memory_create(sizeof(struct AccessLog))) == NULL) {
+    LOGGER_PERROR(logger, "memory_create");
+    return NULL;
+  }
+
+  if ((log->path = memory_strdup(path)) == NULL) {
+    LOGGER_PERROR(logger, "memory_strdup");
+    memory_destroy(log);
+    return NULL;
+  }
+
+  log->logger = logger;
+  log->segment_size = segment_size;
+  log->fd = -1;
+
+  if (move_segment(log) < 0 || open_segment(log) < 0) {
+    memory_destroy(log->path);
+    memory_destroy(log);
+    return NULL;
+  }
+
+  return log;
+}
+
+void
+access_log_destroy(struct AccessLog *log)
+{
+  assert(log != NULL);
+
+  if (log->segment != NULL)
+    close_segment(log);
+
+  memory_destroy(log->path);
+  memory_destroy(log);
+}
+
+static uint64_t
+timespec_to_usec(const struct timespec *time)
+{
+  return (uint64_t)time->tv_sec * 1000000 + time->tv_nsec / 1000;
+}
+
+/* a NULL request is one that couldn't be parsed */
+void
+access_log_begin(struct AccessLogEntry *entry,
+                 struct HTTPRequest    *request)
+{
+  struct AccessLogRecord *record = NULL;
+  struct timespec now;
+  struct MemoryRange range;
+
+  assert(entry != NULL);
+
+  record = &(entry->record);
+
+  clock_gettime(CLOCK_MONOTONIC, &(entry->start));
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  record->timestamp = timespec_to_usec(&now);
+  record->bytes = 0;
+  record->method = ACCESS_LOG_NO_METHOD;
+  record->url_length = 0;
+
+  if (request == NULL)
+    return;
+
+  record->method = http_request_get_method(request);
+
+  http_request_get_url_range(request, &range);
+  record->url_length = range.length;
+  memcpy(record->url, &(http_request_get_headers_buffer(request)[range.offset]),
+         range.length < ACCESS_LOG_URL_LEN ? range.length : ACCESS_LOG_URL_LEN);
+}
+
+/* the bytes sent are counted in the entry by the caller */
+int
+access_log_commit(struct AccessLog      *log,
+                  struct AccessLogEntry *entry,
+                  unsigned               status)
+{
+  struct AccessLogRecord *record = NULL;
+  struct timespec now;
+  uint64_t latency = 0;
+
+  assert(log != NULL);
+  assert(entry != NULL);
+
+  record = &(entry->record);
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  latency = timespec_to_usec(&now) - timespec_to_usec(&(entry->start));
+
+  record->latency = latency < UINT32_MAX ? latency : UINT32_MAX;
+  record->status = status;
+
+  if (log->segment == NULL)
+    return -1;
+
+  if (log->length + sizeof(struct AccessLogRecord) > log->segment_size) {
+    close_segment(log);
+    if (move_segment(log) < 0 || open_segment(log) < 0) {
+      log->segment = NULL;
+      return -1;
+    }
+  }
+
+  memcpy(&(log->segment[log->length]), record, sizeof(struct AccessLogRecord));
+  log->length += sizeof(struct AccessLogRecord);
+
+  return 0;
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
@@ -0,0 +1,65 @@
+/*
+ * accesslog.h - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#ifndef ACCESSLOG_H
+#define ACCESSLOG_H
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * The file format, shared with the decoder: a header, then the records
+ * one after the other until the first with a zero timestamp, or the end.
+ * The integers are in the byte order of the host that wrote them.
+ */
+#define ACCESS_LOG_MAGIC "RAPPALOG"
+#define ACCESS_LOG_VERSION 1
+
+#define ACCESS_LOG_URL_LEN 100
+
+/* when the method isn't known, like for the requests never parsed */
+#define ACCESS_LOG_NO_METHOD 0xff
+
+struct AccessLogHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+};
+
+struct AccessLogRecord {
+  uint64_t timestamp;   /* microseconds since the epoch, when the request arrived */
+  uint64_t bytes;       /* sent, headers included */
+  uint32_t latency;     /* microseconds, up to the last byte sent */
+  uint16_t status;
+  uint8_t method;
+  uint8_t reserved;
+  uint32_t url_length;  /* of the whole url, only ACCESS_LOG_URL_LEN bytes are kept */
+  char url[ACCESS_LOG_URL_LEN];
+};
+
+/* a request being served: filled when it arrives, logged once it's sent */
+struct AccessLogEntry {
+  struct AccessLogRecord record;
+  struct timespec start;
+};
+
+#define ACCESS_LOG_DEFAULT_SEGMENT_SIZE (64 * 1024 * 1024)
+
+struct Logger;
+struct HTTPRequest;
+struct AccessLog;
+
+struct AccessLog *access_log_new(struct Logger *logger, const char *path, size_t segment_size);
+void access_log_destroy(struct AccessLog *log);
+
+void access_log_begin(struct AccessLogEntry *entry, struct HTTPRequest *request);
+int access_log_commit(struct AccessLog *log, struct AccessLogEntry *entry, unsigned status);
+
+#endif /* ACCESSLOG_H */
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
@@ -0,0 +1,512 @@
+/*
+ * asynccontext.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include <sys/queue.h>
+
+#include "asynccontext.h"
+#include "eloop.h"
+#include "logger.h"
+#include "memory.h"
+#include "offloadpool.h"
+
+#define ASYNC_MAX_WATCHES 8
+
+/* a slot is free while its callback is NULL */
+struct AsyncWatch {
+  struct RappAsyncContext *context;
+  int fd;
+  enum RappAsyncEvent event;
+  RappAsyncFdCallback callback;
+  void *data;
+};
+
+/* the job must stay first: the pool hands it back to the work callback */
+struct AsyncOffload {
+  struct OffloadJob job;
+
+  /* NULL once the request went away */
+  struct RappAsyncContext *context;
+
+  RappAsyncWorkCallback work;
+  RappAsyncDoneCallback done;
+  void *data;
+
+  LIST_ENTRY(AsyncOffload) entries;
+};
+
+LIST_HEAD(AsyncOffloadList, AsyncOffload);
+
+/*
+ * A connection has one context, reused by all its requests: a request is
+ * pending from the begin of its serve until the plugin completes it.
+ * Completing it while still inside the serve call just tells the caller
+ * the response is ready when the call returns.
+ */
+struct RappAsyncContext {
+  struct Logger *logger;
+  struct ELoop *eloop;
+
+  AsyncContextCompleteCallback complete_callback;
+  void *complete_data;
+
+  AsyncContextFlushCallback flush_callback;
+  void *flush_data;
+
+  RappAsyncCancelCallback cancel_callback;
+  void *cancel_data;
+
+  RappAsyncBodyCallback body_callback;
+  void *body_data;
+
+  RappAsyncDrainCallback drain_callback;
+  void *drain_data;
+
+  int pending;
+  int serving;
+  int flushing;
+
+  struct AsyncWatch watches[ASYNC_MAX_WATCHES];
+
+  struct OffloadPool *offload_pool;
+  struct AsyncOffloadList offloads;
+};
+
+static enum ELoopWatchFdCallbackType
+watch_callback_type(enum RappAsyncEvent event)
+{
+  return event == RAPP_ASYNC_WRITE ? ELOOP_CALLBACK_WRITE : ELOOP_CALLBACK_READ;
+}
+
+static struct AsyncWatch *
+find_watch(struct RappAsyncContext *context,
+           int                      fd,
+           enum RappAsyncEvent      event)
+{
+  unsigned i = 0;
+
+  for (i = 0; i < ASYNC_MAX_WATCHES; i++) {
+    if (context->watches[i].callback != NULL && context->watches[i].fd == fd && context->watches[i].event == event)
+      return &(context->watches[i]);
+  }
+
+  return NULL;
+}
+
+static void
+remove_watch(struct RappAsyncContext *context,
+             struct AsyncWatch       *watch)
+{
+  event_loop_remove_fd_watch(context->eloop, watch->fd, watch_callback_type(watch->event));
+  watch->callback = NULL;
+}
+
+static void
+remove_watches(struct RappAsyncContext *context)
+{
+  unsigned i = 0;
+
+  for (i = 0; i < ASYNC_MAX_WATCHES; i++) {
+    if (context->watches[i].callback != NULL)
+      remove_watch(context, &(context->watches[i]));
+  }
+}
+
+/* the offloads in flight can't be stopped: they are just left behind */
+static void
+orphan_offloads(struct RappAsyncContext *context)
+{
+  struct AsyncOffload *offload = NULL;
+
+  while ((offload = LIST_FIRST(&(context->offloads))) != NULL) {
+    LIST_REMOVE(offload, entries);
+    offload->context = NULL;
+  }
+}
+
+/* drops everything the plugin left on the context */
+static void
+reset(struct RappAsyncContext *context)
+{
+  remove_watches(context);
+  orphan_offloads(context);
+  context->pending = 0;
+  context->cancel_callback = NULL;
+  context->cancel_data = NULL;
+  context->body_callback = NULL;
+  context->body_data = NULL;
+  context->drain_callback = NULL;
+  context->drain_data = NULL;
+  context->flushing = 0;
+}
+
+struct RappAsyncContext *
+async_context_new(struct Logger *logger,
+                  struct ELoop  *eloop)
+{
+  struct RappAsyncContext *context = NULL;
+
+  assert(eloop != NULL);
+
+  if ((context = memory_pool_create(MEMORY_POOL_ASYNC_CONTEXT, sizeof(struct RappAsyncContext))) == NULL) {
+    LOGGER_PERROR(logger, "memory_pool_create");
+    return NULL;
+  }
+
+  context->logger = logger;
+  context->eloop = eloop;
+  LIST_INIT(&(context->offloads));
+
+  return context;
+}
+
+void
+async_context_destroy(struct RappAsyncContext *context)
+{
+  assert(context != NULL);
+
+  async_context_cancel(context);
+
+  memory_pool_destroy(MEMORY_POOL_ASYNC_CONTEXT, context);
+}
+
+void
+async_context_set_complete_callback(struct RappAsyncContext      *context,
+                                    AsyncContextCompleteCallback  complete_callback,
+                                    void                         *data)
+{
+  assert(context != NULL);
+  assert(complete_callback != NULL);
+
+  context->complete_callback = complete_callback;
+  context->complete_data = data;
+}
+
+void
+async_context_set_flush_callback(struct RappAsyncContext   *context,
+                                 AsyncContextFlushCallback  flush_callback,
+                                 void                      *data)
+{
+  assert(context != NULL);
+  assert(flush_callback != NULL);
+
+  context->flush_callback = flush_callback;
+  context->flush_data = data;
+}
+
+void
+async_context_set_offload_pool(struct RappAsyncContext *context,
+                               struct OffloadPool      *pool)
+{
+  assert(context != NULL);
+
+  context->offload_pool = pool;
+}
+
+void
+async_context_begin(struct RappAsyncContext *context)
+{
+  assert(context != NULL);
+  assert(!context->pending);
+
+  context->pending = 1;
+  context->serving = 1;
+}
+
+int
+async_context_end(struct RappAsyncContext *context,
+                  int                      serve_ret)
+{
+  assert(context != NULL);
+
+  context->serving = 0;
+
+  if (serve_ret == RAPP_SERVE_PENDING && context->pending)
+    return 1;
+
+  reset(context);
+
+  return 0;
+}
+
+int
+async_context_is_pending(struct RappAsyncContext *context)
+{
+  assert(context != NULL);
+
+  return context->pending;
+}
+
+void
+async_context_body(struct RappAsyncContext *context,
+                   const char              *chunk,
+                   size_t                   length)
+{
+  assert(context != NULL);
+
+  if (context->pending && context->body_callback != NULL)
+    context->body_callback(context, chunk, length, context->body_data);
+}
+
+/* the plugin may write and flush the next part from the drain callback */
+int
+async_context_drain(struct RappAsyncContext *context)
+{
+  assert(context != NULL);
+
+  if (!context->pending || !context->flushing)
+    return 0;
+
+  context->flushing = 0;
+
+  if (context->drain_callback != NULL)
+    context->drain_callback(context, context->drain_data);
+
+  return 1;
+}
+
+void
+async_context_cancel(struct RappAsyncContext *context)
+{
+  RappAsyncCancelCallback cancel_callback = NULL;
+  void *cancel_data = NULL;
+
+  assert(context != NULL);
+
+  if (!context->pending)
+    return;
+
+  cancel_callback = context->cancel_callback;
+  cancel_data = context->cancel_data;
+
+  reset(context);
+
+  if (cancel_callback != NULL)
+    cancel_callback(context, cancel_data);
+}
+
+static int
+on_watch_event(int         fd,
+               const void *data)
+{
+  const struct AsyncWatch *watch = NULL;
+
+  assert(data != NULL);
+
+  watch = (const struct AsyncWatch *)data;
+
+  /* the callback can remove the watch: nothing is read after it */
+  watch->callback(watch->context, fd, watch->data);
+
+  return 0;
+}
+
+int
+rapp_async_watch_fd(struct RappAsyncContext *context,
+                    int                      fd,
+                    enum RappAsyncEvent      event,
+                    RappAsyncFdCallback      callback,
+                    void                    *data)
+{
+  struct AsyncWatch *watch = NULL;
+  unsigned i = 0;
+
+  assert(context != NULL);
+  assert(fd > -1);
+  assert(callback != NULL);
+
+  if (!context->pending) {
+    logger_trace(context->logger, LOG_ERROR, "async", "watch on a context not pending");
+    return -1;
+  }
+
+  /* watching again just replaces the callback */
+  if ((watch = find_watch(context, fd, event)) == NULL) {
+    for (i = 0; i < ASYNC_MAX_WATCHES && context->watches[i].callback != NULL; i++)
+      ;
+
+    if (i == ASYNC_MAX_WATCHES) {
+      logger_trace(context->logger, LOG_ERROR, "async", "too many watches on a context");
+      return -1;
+    }
+
+    watch = &(context->watches[i]);
+  }
+
+  if (event_loop_add_fd_watch(context->eloop, fd, watch_callback_type(event), on_watch_event, watch) < 0)
+    return -1;
+
+  watch->context = context;
+  watch->fd = fd;
+  watch->event = event;
+  watch->callback = callback;
+  watch->data = data;
+
+  return 0;
+}
+
+int
+rapp_async_unwatch_fd(struct RappAsyncContext *context,
+                      int                      fd,
+                      enum RappAsyncEvent      event)
+{
+  struct AsyncWatch *watch = NULL;
+
+  assert(context != NULL);
+
+  if ((watch = find_watch(context, fd, event)) == NULL)
+    return -1;
+
+  remove_watch(context, watch);
+
+  return 0;
+}
+
+static void
+on_offload_work(struct OffloadJob *job)
+{
+  struct AsyncOffload *offload = NULL;
+
+  offload = (struct AsyncOffload *)job;
+
+  offload->work(offload->data);
+}
+
+static void
+on_offload_done(void *data)
+{
+  struct AsyncOffload *offload = NULL;
+
+  offload = (struct AsyncOffload *)data;
+
+  if (offload->context != NULL)
+    LIST_REMOVE(offload, entries);
+
+  offload->done(offload->context, offload->data);
+
+  memory_destroy(offload);
+}
+
+int
+rapp_async_offload(struct RappAsyncContext *context,
+                   RappAsyncWorkCallback    work,
+                   RappAsyncDoneCallback    done,
+                   void                    *data)
+{
+  struct AsyncOffload *offload = NULL;
+
+  assert(context != NULL);
+  assert(work != NULL);
+  assert(done != NULL);
+
+  if (!context->pending) {
+    logger_trace(context->logger, LOG_ERROR, "async", "offload on a context not pending");
+    return -1;
+  }
+
+  if (context->offload_pool == NULL) {
+    logger_trace(context->logger, LOG_ERROR, "async", "offload without an offload pool");
+    return -1;
+  }
+
+  if ((offload = memory_create(sizeof(struct AsyncOffload))) == NULL) {
+    LOGGER_PERROR(context->logger, "memory_create");
+    return -1;
+  }
+
+  offload->job.work = on_offload_work;
+  offload->job.eloop = context->eloop;
+  offload->job.done.callback = on_offload_done;
+  offload->job.done.data = offload;
+  offload->context = context;
+  offload->work = work;
+  offload->done = done;
+  offload->data = data;
+
+  if (offload_pool_submit(context->offload_pool, &(offload->job)) < 0) {
+    memory_destroy(offload);
+    return -1;
+  }
+
+  LIST_INSERT_HEAD(&(context->offloads), offload, entries);
+
+  return 0;
+}
+
+void
+rapp_async_set_cancel_callback(struct RappAsyncContext *context,
+                               RappAsyncCancelCallback  callback,
+                               void                    *data)
+{
+  assert(context != NULL);
+
+  context->cancel_callback = callback;
+  context->cancel_data = data;
+}
+
+void
+rapp_async_set_body_callback(struct RappAsyncContext *context,
+                             RappAsyncBodyCallback    callback,
+                             void                    *data)
+{
+  assert(context != NULL);
+
+  context->body_callback = callback;
+  context->body_data = data;
+}
+
+void
+rapp_async_set_drain_callback(struct RappAsyncContext *context,
+                              RappAsyncDrainCallback   callback,
+                              void                    *data)
+{
+  assert(context != NULL);
+
+  context->drain_callback = callback;
+  context->drain_data = data;
+}
+
+/* while still inside the serve call, the caller sends it once the call returns */
+void
+rapp_async_flush(struct RappAsyncContext *context)
+{
+  assert(context != NULL);
+
+  if (!context->pending) {
+    logger_trace(context->logger, LOG_WARNING, "async", "flush of a request not pending");
+    return;
+  }
+
+  context->flushing = 1;
+
+  if (!context->serving && context->flush_callback != NULL)
+    context->flush_callback(context, context->flush_data);
+}
+
+void
+rapp_async_complete(struct RappAsyncContext *context)
+{
+  assert(context != NULL);
+
+  if (!context->pending) {
+    logger_trace(context->logger, LOG_WARNING, "async", "completion of a request not pending");
+    return;
+  }
+
+  reset(context);
+
+  if (!context->serving && context->complete_callback != NULL)
+    context->complete_callback(context, context->complete_data);
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
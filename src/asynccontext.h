@@ -0,0 +1,48 @@
+/*
+ * asynccontext.h - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#ifndef ASYNCCONTEXT_H
+#define ASYNCCONTEXT_H
+
+#include "rapp/rapp_async.h"
+
+struct Logger;
+struct ELoop;
+struct OffloadPool;
+
+typedef void (*AsyncContextCompleteCallback)(struct RappAsyncContext *context, void *data);
+typedef void (*AsyncContextFlushCallback)(struct RappAsyncContext *context, void *data);
+
+struct RappAsyncContext *async_context_new(struct Logger *logger, struct ELoop *eloop);
+void async_context_destroy(struct RappAsyncContext *context);
+
+void async_context_set_complete_callback(struct RappAsyncContext *context, AsyncContextCompleteCallback complete_callback, void *data);
+/* the plugin wants what it has written so far to be sent */
+void async_context_set_flush_callback(struct RappAsyncContext *context, AsyncContextFlushCallback flush_callback, void *data);
+
+/* without a pool the plugins can't offload */
+void async_context_set_offload_pool(struct RappAsyncContext *context, struct OffloadPool *pool);
+
+/* wrap the serve call: end returns 1 if the request is still pending */
+void async_context_begin(struct RappAsyncContext *context);
+int async_context_end(struct RappAsyncContext *context, int serve_ret);
+
+int async_context_is_pending(struct RappAsyncContext *context);
+
+/* passes a chunk of the body streamed to the plugin, if still pending */
+void async_context_body(struct RappAsyncContext *context, const char *chunk, size_t length);
+
+/* the flushed data is sent: returns 1 if the plugin was waiting for it */
+int async_context_drain(struct RappAsyncContext *context);
+
+void async_context_cancel(struct RappAsyncContext *context);
+
+#endif /* ASYNCCONTEXT_H */
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
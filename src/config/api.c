@@ -207,8 +207,14 @@ rapp_config_get_nth_bool(const struct RappConfig *conf,
                          int                     position,
                          int                    *value)
 {
-  /* XXX: what if sizeof(int) < sizeof(long) ? */
-  return rapp_config_get_nth_int(conf, section, name, position, (long*) value);
+  long long_value = 0;
+  int ret = 0;
+
+  ret = rapp_config_get_nth_int(conf, section, name, position, &long_value);
+  if (ret == 0)
+    *value = long_value;
+
+  return ret;
 }
 
 int
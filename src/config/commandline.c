@@ -21,6 +21,7 @@
 #define ARG_LOGOUTPUT ARG_INDEX_BASE + 1
 #define ARG_LOGNOCOLOR ARG_INDEX_BASE + 2
 #define ARG_LOAD ARG_INDEX_BASE + 3
+#define ARG_LOGASYNC ARG_INDEX_BASE + 4
 #define ARG_INDEX_OFFSET 150
 
 
@@ -33,6 +34,8 @@ static struct argp_option rappoptions[] = {
     "Log to file, defaults to <stderr>."},
   {"log-nocolor", ARG_LOGNOCOLOR, 0, 0,
     "Disable colors in logs"},
+  {"log-async", ARG_LOGASYNC, 0, 0,
+    "Write logs from a background thread, dropping them when it lags behind"},
   {0, 0, 0, OPTION_DOC, "Containers:", -2},
   {"load", ARG_LOAD, "PATH", 0, "Load container .so"},
   {0}
@@ -239,6 +242,10 @@ parse_commandline_opt(int               key,
     return EINVAL;
   }
 
+  // boolean flags don't take an argument: their presence means true
+  if (!arg && opt->type == PARAM_BOOL)
+    arg = "true";
+
   if (!arg) {
     WARN(conf, "Key %s.%s NULL value", opt->section->name, opt->name);
     return EINVAL;
@@ -342,6 +349,10 @@ parse_early_opt(int               key,
       arguments->lognocolor = 1;
       break;
 
+    case ARG_LOGASYNC:
+      arguments->logasync = 1;
+      break;
+
     case ARG_LOAD:
       if (!arg)
         return EINVAL;
@@ -370,6 +381,7 @@ config_parse_early_commandline(struct RappArguments *arguments,
   arguments->logoutput_is_console = 1;
   arguments->logoutput = stderr;
   arguments->lognocolor = 0;
+  arguments->logasync = 0;
   arguments->container = NULL;
 
   return argp_parse(&argp, argc, argv, ARGP_SILENT, 0, arguments);
@@ -37,7 +37,9 @@ config_new(struct Logger *logger)
   }
 
   TAILQ_INIT(&conf->sections);
+  TAILQ_INIT(&conf->routes);
   conf->num_sections = 0;
+  conf->num_routes = 0;
   conf->logger = logger;
   conf->options = NULL;
 
@@ -49,12 +51,20 @@ void
 config_destroy(struct RappConfig* conf)
 {
   struct ConfigSection *sect = NULL;
+  struct ConfigRoute *route = NULL;
   assert(conf != NULL);
   while (conf->sections.tqh_first != NULL) {
     sect = conf->sections.tqh_first;
     TAILQ_REMOVE(&conf->sections, conf->sections.tqh_first, entries);
     config_section_destroy(sect);
   }
+  while (conf->routes.tqh_first != NULL) {
+    route = conf->routes.tqh_first;
+    TAILQ_REMOVE(&conf->routes, conf->routes.tqh_first, entries);
+    memory_destroy(route->prefix);
+    memory_destroy(route->plugin);
+    memory_destroy(route);
+  }
   config_argp_options_destroy(conf);
   memory_destroy(conf);
 }
@@ -279,6 +289,83 @@ config_section_create(struct RappConfig *conf,
   return sect;
 }
 
+/*
+ * a prefix mounted again is moved to the new plugin, so that the same
+ * file can be parsed twice.
+ */
+int
+config_add_route(struct RappConfig *conf,
+                 const char        *prefix,
+                 const char        *plugin)
+{
+  struct ConfigRoute *route = NULL;
+  char *dup = NULL;
+
+  if (!conf || !prefix || !plugin)
+    return -1;
+
+  if (prefix[0] != '/') {
+    ERROR(conf, "Route prefix must start with '/': %s", prefix);
+    return -1;
+  }
+
+  if ((dup = memory_strdup(plugin)) == NULL)
+    return -1;
+
+  for (route=conf->routes.tqh_first; route != NULL; route=route->entries.tqe_next) {
+    if (strcmp(route->prefix, prefix) == 0) {
+      memory_destroy(route->plugin);
+      route->plugin = dup;
+      DEBUG(conf, "Moved route '%s' to '%s'", prefix, plugin);
+      return 0;
+    }
+  }
+
+  if ((route = memory_create(sizeof(struct ConfigRoute))) == NULL) {
+    memory_destroy(dup);
+    return -1;
+  }
+  route->plugin = dup;
+  route->prefix = memory_strdup(prefix);
+  if (!route->prefix) {
+    memory_destroy(route->plugin);
+    memory_destroy(route);
+    return -1;
+  }
+  conf->num_routes++;
+  TAILQ_INSERT_TAIL(&conf->routes, route, entries);
+  DEBUG(conf, "Added route '%s' = '%s'", prefix, plugin);
+  return 0;
+}
+
+int
+config_get_num_routes(const struct RappConfig *conf)
+{
+  assert(conf != NULL);
+  return conf->num_routes;
+}
+
+/* the strings belong to the config */
+int
+config_get_nth_route(const struct RappConfig  *conf,
+                     int                       n,
+                     const char              **prefix,
+                     const char              **plugin)
+{
+  const struct ConfigRoute *route = NULL;
+  int i = 0;
+
+  if (!conf || !prefix || !plugin || n < 0 || n >= conf->num_routes)
+    return -1;
+
+  for (route=conf->routes.tqh_first; i < n; route=route->entries.tqe_next)
+    i++;
+
+  *prefix = route->prefix;
+  *plugin = route->plugin;
+  return 0;
+}
+
 void
 uppercase(char *str)
 {
@@ -13,7 +13,7 @@
 
 #include "src/logger.h"
 
-#define LOG(conf, level, fmt, ...) logger_trace(conf->logger, level, "config", fmt, __VA_ARGS__)
+#define LOG(conf, level, fmt, ...) LOGGER_TRACE(conf->logger, level, "config", fmt, __VA_ARGS__)
 #define INFO(conf, fmt, ...) LOG(conf, LOG_INFO, fmt, __VA_ARGS__)
 #define WARN(conf, fmt, ...) LOG(conf, LOG_WARNING, fmt, __VA_ARGS__)
 #define DEBUG(conf, fmt, ...) LOG(conf, LOG_DEBUG, fmt, __VA_ARGS__)
@@ -56,6 +56,7 @@ struct RappArguments {
   int logoutput_is_console;
   FILE *logoutput;
   int lognocolor;
+  int logasync;
   char *container;
 };
 
@@ -95,13 +96,22 @@ struct ConfigSection {
   TAILQ_HEAD(ConfigOptionHead, ConfigOption) options;
 };
 
+/* a container mounted on a path prefix by the routes section */
+struct ConfigRoute {
+  char *prefix;
+  char *plugin;
+  TAILQ_ENTRY(ConfigRoute) entries;
+};
+
 struct RappConfig {
   int num_sections;
+  int num_routes;
   struct Logger *logger;
   struct ConfigOption **options_map;
   struct argp_option *options;
   int num_argp_options;
   TAILQ_HEAD(ConfigSectionHead, ConfigSection) sections;
+  TAILQ_HEAD(ConfigRouteHead, ConfigRoute) routes;
 };
 
 struct RappConfig *config_new(struct Logger *logger);
@@ -115,6 +125,10 @@ struct ConfigSection* config_section_get(struct RappConfig *conf, const char *se
 struct ConfigSection* config_section_create(struct RappConfig *conf, const char *name);
 void config_section_destroy(struct ConfigSection *sect);
 
+int config_add_route(struct RappConfig *conf, const char *prefix, const char *plugin);
+int config_get_num_routes(const struct RappConfig *conf);
+int config_get_nth_route(const struct RappConfig *conf, int n, const char **prefix, const char **plugin);
+
 int config_add_value_string(struct RappConfig *conf, const char *section, const char *name, const char* value);
 int config_add_value_int(struct RappConfig *conf, const char *section, const char *name, long value);
 int config_add_value_from_string(struct RappConfig *conf, struct ConfigOption *opt, const char *value);
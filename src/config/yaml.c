@@ -273,6 +273,83 @@ yaml_parse_section(struct RappConfig *conf,
   return 0;
 }
 
+/* routes: a mapping of path prefixes to the plugins mounted on them */
+static int
+yaml_parse_routes(struct RappConfig *conf,
+                  const char        *filename,
+                  yaml_parser_t     *parser)
+{
+  yaml_token_t token;
+  char *prefix = NULL;
+  int ret = -1;
+
+  yaml_parser_scan(parser, &token);
+  if (token.type != YAML_VALUE_TOKEN) {
+    CRITICAL(conf, "Malformed yaml file %s: expected value, got %d",
+        filename, token.type);
+    goto cleanup;
+  }
+  yaml_token_delete(&token);
+  yaml_parser_scan(parser, &token);
+  if (token.type != YAML_BLOCK_MAPPING_START_TOKEN &&
+      token.type != YAML_FLOW_MAPPING_START_TOKEN) {
+    CRITICAL(conf, "Malformed yaml file %s: expected routes mapping, got %d",
+        filename, token.type);
+    goto cleanup;
+  }
+
+  while (1) {
+    yaml_token_delete(&token);
+    yaml_parser_scan(parser, &token);
+    if (token.type == YAML_FLOW_ENTRY_TOKEN) {
+      yaml_token_delete(&token);
+      yaml_parser_scan(parser, &token);
+    }
+    if (token.type == YAML_BLOCK_END_TOKEN ||
+        token.type == YAML_FLOW_MAPPING_END_TOKEN)
+      break;
+    if (token.type != YAML_KEY_TOKEN) {
+      ERROR(conf, "Expected route prefix key, got %d", token.type);
+      goto cleanup;
+    }
+
+    yaml_token_delete(&token);
+    yaml_parser_scan(parser, &token);
+    if (token.type != YAML_SCALAR_TOKEN) {
+      ERROR(conf, "Expected scalar route prefix, got %d", token.type);
+      goto cleanup;
+    }
+    prefix = memory_strdup((const char*) token.data.scalar.value);
+    if (!prefix)
+      goto cleanup;
+
+    yaml_token_delete(&token);
+    yaml_parser_scan(parser, &token);
+    if (token.type != YAML_VALUE_TOKEN) {
+      ERROR(conf, "Expected value token, got %d", token.type);
+      goto cleanup;
+    }
+    yaml_token_delete(&token);
+    yaml_parser_scan(parser, &token);
+    if (token.type != YAML_SCALAR_TOKEN) {
+      ERROR(conf, "Expected plugin path for route %s, got %d", prefix, token.type);
+      goto cleanup;
+    }
+    if (config_add_route(conf, prefix, (const char*) token.data.scalar.value) != 0)
+      goto cleanup;
+
+    memory_destroy(prefix);
+    prefix = NULL;
+  }
+  ret = 0;
+
+cleanup:
+  yaml_token_delete(&token);
+  if (prefix)
+    memory_destroy(prefix);
+  return ret;
+}
+
 static int
 config_parse_main(struct RappConfig *conf,
                   yaml_parser_t     *parser,
@@ -280,6 +357,7 @@ config_parse_main(struct RappConfig *conf,
 {
   yaml_token_t token;
   int ret = 0;
+  int res;
   if (yaml_parse_init(conf, sourcename, parser) != 0) {
     ret = -1;
     goto cleanup;
@@ -307,8 +385,12 @@ config_parse_main(struct RappConfig *conf,
       ret = -1;
       goto cleanup;
     }
-    if (yaml_parse_section(conf, sourcename, (const char*) token.data.scalar.value,
-          parser) != 0) {
+    if (strcmp((const char*) token.data.scalar.value, "routes") == 0)
+      res = yaml_parse_routes(conf, sourcename, parser);
+    else
+      res = yaml_parse_section(conf, sourcename, (const char*) token.data.scalar.value,
+          parser);
+    if (res != 0) {
       ret = -1;
       break;
     }
@@ -25,8 +25,12 @@ struct Container {
   char *name;
 
   RappServeCallback serve;
+  RappServeAsyncCallback serve_async;
+  RappStreamBodyCallback stream_body;
   RappDestroyCallback destroy;
   RappInitCallBack init;
+
+  unsigned metrics_route;
 };
 
 static int
@@ -72,6 +76,21 @@ get_symbol(struct Logger *logger,
 }
 
 
+/* the symbols a plugin can omit: NULL when missing */
+static void *
+get_optional_symbol(void       *handle,
+                    const char *name)
+{
+  void *symbol = NULL;
+
+  dlerror();
+  symbol = dlsym(handle, name);
+  dlerror();
+
+  return symbol;
+}
+
+
 typedef void *(*PluginCreateFunc)(void *cookie, struct RappConfig *config, int *err);
 
 static struct Container *
@@ -114,9 +133,16 @@ container_make(void              *plugin,
 
   container->handle = handle;
 
-  if (get_symbol(logger, plugin, "rapp_serve", (void *)&(container->serve)) != 0)
+  /* an async plugin doesn't need the blocking serve */
+  container->serve_async = get_optional_symbol(plugin, "rapp_serve_async");
+
+  if (container->serve_async != NULL)
+    container->serve = get_optional_symbol(plugin, "rapp_serve");
+  else if (get_symbol(logger, plugin, "rapp_serve", (void *)&(container->serve)) != 0)
     return NULL;
 
+  container->stream_body = get_optional_symbol(plugin, "rapp_stream_body");
+
   if (get_symbol(logger, plugin, "rapp_destroy", (void *)&(container->destroy)) != 0)
     return NULL;
 
@@ -173,7 +199,7 @@ container_init(struct Container *container, struct RappConfig *config)
 {
   assert(container != NULL);
   assert(config != NULL);
-  logger_trace(container->logger, LOG_DEBUG, "loader", "loading config for plugin[%s] id=%p (%p)", container->name, container, container->plugin);
+  LOGGER_DEBUG(container->logger, "loader", "loading config for plugin[%s] id=%p (%p)", container->name, container, container->plugin);
 
   return container->init(container->handle, config);
 }
@@ -205,9 +231,46 @@ container_serve(struct Container          *container,
   assert(http_request != NULL);
   assert(response != NULL);
 
+  if (container->serve == NULL) {
+    logger_trace(container->logger, LOG_ERROR, "loader", "plugin[%s] can only serve asynchronously", container->name);
+    return -1;
+  }
+
   return container->serve(container->handle, http_request, response);
 }
 
+/* may return RAPP_SERVE_PENDING: see rapp_serve_async */
+int
+container_serve_async(struct Container        *container,
+                      struct HTTPRequest      *http_request,
+                      struct HTTPResponse     *response,
+                      struct RappAsyncContext *context)
+{
+  assert(container != NULL);
+  assert(http_request != NULL);
+  assert(response != NULL);
+  assert(context != NULL);
+
+  if (container->serve_async == NULL)
+    return container_serve(container, http_request, response);
+
+  return container->serve_async(container->handle, http_request, response, context);
+}
+
+/* only the async plugins can have their bodies streamed: see rapp_stream_body */
+int
+container_stream_body(struct Container   *container,
+                      struct HTTPRequest *http_request)
+{
+  assert(container != NULL);
+  assert(http_request != NULL);
+
+  if (container->serve_async == NULL || container->stream_body == NULL)
+    return 0;
+
+  return container->stream_body(container->handle, http_request) != 0;
+}
+
 static int
 null_serve(struct RappContainer      *handle,
            struct HTTPRequest        *request,
@@ -220,7 +283,7 @@ null_serve(struct RappContainer      *handle,
   assert(response != NULL);
 
   logger = (struct Logger *)handle;
-  logger_trace(logger, LOG_DEBUG, "null", "received request on unhandled route");
+  LOGGER_DEBUG(logger, "null", "received request on unhandled route");
   return -1;
 }
 
@@ -273,6 +336,42 @@ container_new_custom(struct Logger      *logger,
   return container;
 }
 
+void
+container_set_serve_async(struct Container       *container,
+                          RappServeAsyncCallback  serve_async)
+{
+  assert(container != NULL);
+
+  container->serve_async = serve_async;
+}
+
+void
+container_set_stream_body(struct Container       *container,
+                          RappStreamBodyCallback  stream_body)
+{
+  assert(container != NULL);
+
+  container->stream_body = stream_body;
+}
+
+/* the route of the metrics its handlers are timed in: see metrics_add_route */
+void
+container_set_metrics_route(struct Container *container,
+                            unsigned          route)
+{
+  assert(container != NULL);
+
+  container->metrics_route = route;
+}
+
+unsigned
+container_get_metrics_route(struct Container *container)
+{
+  assert(container != NULL);
+
+  return container->metrics_route;
+}
+
 struct Container *
 container_new_null(struct Logger *logger,
                    const char    *tag)
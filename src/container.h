@@ -14,6 +14,8 @@
 
 
 typedef int (*RappServeCallback)(struct RappContainer *handle, struct HTTPRequest *http_request, struct HTTPResponse *response);
+typedef int (*RappServeAsyncCallback)(struct RappContainer *handle, struct HTTPRequest *http_request, struct HTTPResponse *response, struct RappAsyncContext *context);
+typedef int (*RappStreamBodyCallback)(struct RappContainer *handle, struct HTTPRequest *http_request);
 typedef int (*RappInitCallBack)(struct RappContainer *handle, struct RappConfig *config);
 typedef int (*RappDestroyCallback)(struct RappContainer *handle);
 
@@ -23,9 +25,15 @@ struct Container *container_new(struct Logger *logger, const char *name, struct
 void container_destroy(struct Container *container);
 int container_init(struct Container *container, struct RappConfig *config);
 int container_serve(struct Container *container, struct HTTPRequest *http_request, struct HTTPResponse *response);
+int container_serve_async(struct Container *container, struct HTTPRequest *http_request, struct HTTPResponse *response, struct RappAsyncContext *context);
+int container_stream_body(struct Container *container, struct HTTPRequest *http_request);
 
 struct Container *container_new_null(struct Logger *logger, const char *tag);
 struct Container *container_new_custom(struct Logger *logger, const char *tag, RappInitCallBack init, RappServeCallback serve, RappDestroyCallback destroy, void *user_data);
+void container_set_serve_async(struct Container *container, RappServeAsyncCallback serve_async);
+void container_set_stream_body(struct Container *container, RappStreamBodyCallback stream_body);
+void container_set_metrics_route(struct Container *container, unsigned route);
+unsigned container_get_metrics_route(struct Container *container);
 
 #endif /* CONTAINER_H */
 /*
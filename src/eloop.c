@@ -11,38 +11,126 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <time.h>
 
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/queue.h>
 
 #include "eloop.h"
 #include "logger.h"
 #include "memory.h"
 
 #define MAX_EVENTS 1024
+#define MIN_CALLBACKS 64
 
+/* in milliseconds, also used as epoll_wait timeout */
+#define TIMER_TICK 100
+#define TIMER_WHEEL_SIZE 1024
+
+#define WATCH_EVENTS (EPOLLIN | EPOLLOUT | EPOLLRDHUP)
 
-struct ELoop {
-  int epollfd;
-  struct Collector *collector;
-  struct Logger *logger;
-  struct ELoopCallback *callbacks_list;
-  int running;
-};
 
 struct ELoopCallback {
-  int fd;
   struct epoll_event ev;
   ELoopWatchFdCallback callbacks[ELOOP_CALLBACK_MAX];
   const void *datas[ELOOP_CALLBACK_MAX];
+};
 
-  struct ELoopCallback *next;
+struct ELoopTimer {
+  LIST_ENTRY(ELoopTimer) entries;
+  unsigned long rounds;
+  ELoopTimerCallback callback;
+  const void *data;
 };
 
+LIST_HEAD(ELoopTimerList, ELoopTimer);
+
+/*
+ * callbacks are kept in a dense table indexed by fd (the kernel always hands
+ * out the lowest free fd, so it stays compact): registering and removing a
+ * watch costs O(1) no matter how many fds are watched.
+ */
+struct ELoop {
+  int epollfd;
+  struct Collector *collector;
+  struct Logger *logger;
+  struct ELoopCallback *callbacks;
+  int callbacks_size;
+  int running;           /* atomic: it's stopped from any thread */
+
+  /*
+   * timers are hashed in a wheel by expiration tick, the ones further than
+   * a whole turn wait for the given number of rounds: adding and cancelling
+   * a timer costs O(1), every tick only visits its own slot.
+   * Released timers are kept for reuse.
+   */
+  struct ELoopTimerList timer_wheel[TIMER_WHEEL_SIZE];
+  struct ELoopTimerList free_timers;
+  unsigned long timer_tick;
+  unsigned long timer_tick_time;
+
+  /*
+   * the posts from the other threads are pushed on a lock free stack, and
+   * taken all together by the loop: the eventfd is signalled only when the
+   * stack stops being empty.
+   */
+  int post_fd;
+  struct ELoopPost *posts;
+};
+
+
+static unsigned long
+monotonic_time(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+static void
+run_posts(struct ELoop *eloop)
+{
+  struct ELoopPost *post = NULL;
+  struct ELoopPost *next = NULL;
+  struct ELoopPost *ordered = NULL;
+
+  post = __atomic_exchange_n(&(eloop->posts), NULL, __ATOMIC_ACQUIRE);
+
+  /* the stack has the last posted first */
+  for (; post != NULL; post = next) {
+    next = post->next;
+    post->next = ordered;
+    ordered = post;
+  }
+
+  for (post = ordered; post != NULL; post = next) {
+    next = post->next;
+    post->callback(post->data);
+  }
+}
+
+static int
+on_posts(int         fd,
+         const void *data)
+{
+  eventfd_t value;
+
+  eventfd_read(fd, &value);
+
+  run_posts((struct ELoop *)data);
+
+  return 0;
+}
 
 struct ELoop *
 event_loop_new(struct Logger *logger)
 {
   struct ELoop *eloop = NULL;
+  int i = 0;
 
   if ((eloop = memory_create(sizeof(struct ELoop))) == NULL) {
     LOGGER_PERROR(logger, "memory_create");
@@ -55,80 +143,184 @@ event_loop_new(struct Logger *logger)
   }
 
   eloop->collector = collector_new(logger);
-  eloop->callbacks_list = NULL;
+  eloop->callbacks = NULL;
+  eloop->callbacks_size = 0;
   eloop->logger = logger;
+  eloop->running = 1;
+
+  for (i = 0; i < TIMER_WHEEL_SIZE; i++)
+    LIST_INIT(&(eloop->timer_wheel[i]));
+  LIST_INIT(&(eloop->free_timers));
+  eloop->timer_tick = 0;
+  eloop->timer_tick_time = monotonic_time();
+
+  if ((eloop->post_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+    LOGGER_PERROR(logger, "eventfd");
+    event_loop_destroy(eloop);
+    return NULL;
+  }
+
+  if (event_loop_add_fd_watch(eloop, eloop->post_fd, ELOOP_CALLBACK_READ, on_posts, eloop) < 0) {
+    event_loop_destroy(eloop);
+    return NULL;
+  }
 
   return eloop;
 }
 
+static void
+free_timer_list(struct ELoopTimerList *list)
+{
+  struct ELoopTimer *timer = NULL;
+
+  while ((timer = LIST_FIRST(list)) != NULL) {
+    LIST_REMOVE(timer, entries);
+    memory_destroy(timer);
+  }
+}
+
 void
 event_loop_destroy(struct ELoop *eloop)
 {
+  int i = 0;
+
   assert(eloop != NULL);
 
+  for (i = 0; i < TIMER_WHEEL_SIZE; i++)
+    free_timer_list(&(eloop->timer_wheel[i]));
+  free_timer_list(&(eloop->free_timers));
+
   if (eloop->collector)
     collector_destroy(eloop->collector);
 
+  if (eloop->callbacks)
+    memory_destroy(eloop->callbacks);
+
+  if (eloop->post_fd > 0)
+    close(eloop->post_fd);
+
   close(eloop->epollfd);
   memory_destroy(eloop);
 }
 
+static void
+run_timers(struct ELoop *eloop)
+{
+  struct ELoopTimerList expired;
+  struct ELoopTimerList *slot = NULL;
+  struct ELoopTimer *timer = NULL;
+  struct ELoopTimer *next = NULL;
+  unsigned long now = monotonic_time();
+
+  while (now - eloop->timer_tick_time >= TIMER_TICK) {
+    eloop->timer_tick_time += TIMER_TICK;
+    eloop->timer_tick++;
+
+    slot = &(eloop->timer_wheel[eloop->timer_tick % TIMER_WHEEL_SIZE]);
+    LIST_INIT(&expired);
+
+    for (timer = LIST_FIRST(slot); timer != NULL; timer = next) {
+      next = LIST_NEXT(timer, entries);
+
+      if (timer->rounds > 0) {
+        timer->rounds--;
+        continue;
+      }
+
+      LIST_REMOVE(timer, entries);
+      LIST_INSERT_HEAD(&expired, timer, entries);
+    }
+
+    /*
+     * callbacks can add new timers and cancel the expired ones not yet
+     * called: pop them one at a time.
+     */
+    while ((timer = LIST_FIRST(&expired)) != NULL) {
+      LIST_REMOVE(timer, entries);
+      LIST_INSERT_HEAD(&(eloop->free_timers), timer, entries);
+      timer->callback(timer->data);
+    }
+  }
+}
+
 int
 event_loop_run(struct ELoop *eloop)
 {
   int nfds = 0;
   int i = 0;
-  struct ELoopCallback *eloop_callback = NULL;
+  int fd = -1;
   struct epoll_event events[MAX_EVENTS];
 
-  eloop->running = 1;
-
-  while(eloop->running && ((nfds = epoll_wait(eloop->epollfd, events, MAX_EVENTS, 100)) > -1)) {
+  while(__atomic_load_n(&(eloop->running), __ATOMIC_ACQUIRE) && ((nfds = epoll_wait(eloop->epollfd, events, MAX_EVENTS, TIMER_TICK)) > -1)) {
     for (i = 0; i < nfds; i++) {
-      eloop_callback = events[i].data.ptr;
-
-      if (events[i].events & EPOLLRDHUP && eloop_callback->callbacks[ELOOP_CALLBACK_CLOSE]) {
-        eloop_callback->callbacks[ELOOP_CALLBACK_CLOSE](eloop_callback->fd, eloop_callback->datas[ELOOP_CALLBACK_CLOSE]);
+      fd = events[i].data.fd;
+
+      /*
+       * the table can be resized, and the watches removed, by any callback:
+       * always look the entry up again before dispatching.
+       */
+      if (events[i].events & EPOLLRDHUP && eloop->callbacks[fd].callbacks[ELOOP_CALLBACK_CLOSE]) {
+        eloop->callbacks[fd].callbacks[ELOOP_CALLBACK_CLOSE](fd, eloop->callbacks[fd].datas[ELOOP_CALLBACK_CLOSE]);
       }
 
-      if (events[i].events & EPOLLIN && eloop_callback->callbacks[ELOOP_CALLBACK_READ]) {
-        eloop_callback->callbacks[ELOOP_CALLBACK_READ](eloop_callback->fd, eloop_callback->datas[ELOOP_CALLBACK_READ]);
+      if (events[i].events & EPOLLIN && eloop->callbacks[fd].callbacks[ELOOP_CALLBACK_READ]) {
+        eloop->callbacks[fd].callbacks[ELOOP_CALLBACK_READ](fd, eloop->callbacks[fd].datas[ELOOP_CALLBACK_READ]);
       }
 
-      if (events[i].events & EPOLLOUT && eloop_callback->callbacks[ELOOP_CALLBACK_WRITE]) {
-        eloop_callback->callbacks[ELOOP_CALLBACK_WRITE](eloop_callback->fd, eloop_callback->datas[ELOOP_CALLBACK_WRITE]);
+      if (events[i].events & EPOLLOUT && eloop->callbacks[fd].callbacks[ELOOP_CALLBACK_WRITE]) {
+        eloop->callbacks[fd].callbacks[ELOOP_CALLBACK_WRITE](fd, eloop->callbacks[fd].datas[ELOOP_CALLBACK_WRITE]);
       }
     }
     collector_collect(eloop->collector);
+
+    /* after the collection: the owners of the fired timers are still alive */
+    run_timers(eloop);
   }
 
+  /*
+   * a stop request is consumed by the run it interrupts: this way it can be
+   * issued from another thread even before the loop starts running.
+   */
+  __atomic_store_n(&(eloop->running), 1, __ATOMIC_RELEASE);
+
   return -1;
 }
 
+/* safe to call from any thread: the loop is woken up as for a post */
 void
 event_loop_stop(struct ELoop *eloop)
 {
-  eloop->running = 0;
+  assert(eloop != NULL);
+
+  __atomic_store_n(&(eloop->running), 0, __ATOMIC_RELEASE);
+  eventfd_write(eloop->post_fd, 1);
 }
 
 static int
-find_callback_by_fd(struct ELoop          *eloop,
-                    int                    fd,
-                    struct ELoopCallback **ec,
-                    struct ELoopCallback **pec)
+ensure_callbacks_size(struct ELoop *eloop,
+                      int           fd)
 {
-  assert(ec != NULL);
+  struct ELoopCallback *callbacks = NULL;
+  int size = 0;
 
-  for (*ec = eloop->callbacks_list; *ec != NULL; *ec = (*ec)->next) {
-    if ((*ec)->fd == fd) {
-      return 0;
-    }
+  if (fd < eloop->callbacks_size)
+    return 0;
 
-    if (pec != NULL)
-      *pec = *ec;
+  size = eloop->callbacks_size > 0 ? eloop->callbacks_size : MIN_CALLBACKS;
+  while (size <= fd)
+    size *= 2;
+
+  if ((callbacks = memory_resize(eloop->callbacks, sizeof(struct ELoopCallback) * size)) == NULL) {
+    LOGGER_PERROR(eloop->logger, "memory_resize");
+    return -1;
   }
 
-  return -1;
+  memset(&(callbacks[eloop->callbacks_size]), 0, sizeof(struct ELoopCallback) * (size - eloop->callbacks_size));
+
+  eloop->callbacks = callbacks;
+  eloop->callbacks_size = size;
+
+  return 0;
 }
 
 static uint32_t
@@ -168,28 +360,24 @@ event_loop_add_fd_watch(struct ELoop                 *eloop,
   assert(fd > -1);
   assert(callback != NULL);
 
-  if (find_callback_by_fd(eloop, fd, &ec, NULL) < 0) {
-    if ((ec = memory_create(sizeof(struct ELoopCallback))) == NULL) {
-      LOGGER_PERROR(eloop->logger, "memory_create");
-      return -1;
-    }
+  if (ensure_callbacks_size(eloop, fd) < 0)
+    return -1;
 
-    ec->next = eloop->callbacks_list;
-    eloop->callbacks_list = ec;
+  ec = &(eloop->callbacks[fd]);
 
+  if ((ec->ev.events & WATCH_EVENTS) == 0)
     epoll_operation = EPOLL_CTL_ADD;
-  }
 
   ec->ev.events |= eloop_callback_type_to_epoll_event(callback_type);
-  ec->ev.data.ptr = ec;
+  ec->ev.data.fd = fd;
 
-  ec->fd = fd;
   ec->callbacks[callback_type] = callback;
   ec->datas[callback_type] = data;
 
   if ((ret = epoll_ctl(eloop->epollfd, epoll_operation, fd, &(ec->ev))) < 0) {
     LOGGER_PERROR(eloop->logger, "epoll_ctl");
-    /* FIXME: ec is now leaked */
+    if (epoll_operation == EPOLL_CTL_ADD)
+      memset(ec, 0, sizeof(struct ELoopCallback));
   }
   return ret;
 }
@@ -200,36 +388,115 @@ event_loop_remove_fd_watch(struct ELoop                 *eloop,
                            enum ELoopWatchFdCallbackType callback_type)
 {
   struct ELoopCallback *ec = NULL;
-  struct ELoopCallback *pec = NULL;
   int epoll_operation = EPOLL_CTL_MOD;
   struct epoll_event *ev = NULL;
 
   assert(eloop != NULL);
   assert(fd > -1);
 
-  if (find_callback_by_fd(eloop, fd, &ec, &pec) < 0)
+  if (fd >= eloop->callbacks_size || (eloop->callbacks[fd].ev.events & WATCH_EVENTS) == 0)
     return -1;
 
+  ec = &(eloop->callbacks[fd]);
+
   ec->callbacks[callback_type] = NULL;
   ec->datas[callback_type] = NULL;
 
   ec->ev.events &= ~(eloop_callback_type_to_epoll_event(callback_type));
   ev = &(ec->ev);
 
-  if (ec->ev.events == 0) {
+  if ((ec->ev.events & WATCH_EVENTS) == 0) {
     epoll_operation = EPOLL_CTL_DEL;
-
-    if (pec == NULL)
-      eloop->callbacks_list = ec->next;
-    else
-      pec->next = ec->next;
-    memory_destroy(ec);
+    memset(ec, 0, sizeof(struct ELoopCallback));
     ev = NULL;
   }
 
   return epoll_ctl(eloop->epollfd, epoll_operation, fd, ev);
 }
 
+/*
+ * In edge triggered mode the callbacks are invoked only when the fd state
+ * changes: they must consume all the available data (or fill the send
+ * buffer) until EAGAIN, or they won't be notified again.
+ * The fd must have at least one watch registered.
+ */
+int
+event_loop_set_fd_edge_triggered(struct ELoop *eloop,
+                                 int           fd,
+                                 int           edge_triggered)
+{
+  struct ELoopCallback *ec = NULL;
+
+  assert(eloop != NULL);
+  assert(fd > -1);
+
+  if (fd >= eloop->callbacks_size || (eloop->callbacks[fd].ev.events & WATCH_EVENTS) == 0)
+    return -1;
+
+  ec = &(eloop->callbacks[fd]);
+
+  if (edge_triggered)
+    ec->ev.events |= EPOLLET;
+  else
+    ec->ev.events &= ~EPOLLET;
+
+  if (epoll_ctl(eloop->epollfd, EPOLL_CTL_MOD, fd, &(ec->ev)) < 0) {
+    LOGGER_PERROR(eloop->logger, "epoll_ctl");
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * The callback is called once, after at least timeout milliseconds; then
+ * the timer is released and the returned handle is no longer valid.
+ */
+struct ELoopTimer *
+event_loop_add_timer(struct ELoop       *eloop,
+                     unsigned            timeout,
+                     ELoopTimerCallback  callback,
+                     const void         *data)
+{
+  struct ELoopTimer *timer = NULL;
+  unsigned long ticks = 0;
+
+  assert(eloop != NULL);
+  assert(callback != NULL);
+
+  if ((timer = LIST_FIRST(&(eloop->free_timers))) != NULL) {
+    LIST_REMOVE(timer, entries);
+  }
+  else if ((timer = memory_create(sizeof(struct ELoopTimer))) == NULL) {
+    LOGGER_PERROR(eloop->logger, "memory_create");
+    return NULL;
+  }
+
+  /* counted from the last tick, so that it never expires early */
+  ticks = (timeout + (monotonic_time() - eloop->timer_tick_time) + TIMER_TICK - 1) / TIMER_TICK;
+  if (ticks == 0)
+    ticks = 1;
+
+  timer->rounds = (ticks - 1) / TIMER_WHEEL_SIZE;
+  timer->callback = callback;
+  timer->data = data;
+
+  LIST_INSERT_HEAD(&(eloop->timer_wheel[(eloop->timer_tick + ticks) % TIMER_WHEEL_SIZE]), timer, entries);
+
+  return timer;
+}
+
+void
+event_loop_cancel_timer(struct ELoop      *eloop,
+                        struct ELoopTimer *timer)
+{
+  assert(eloop != NULL);
+  assert(timer != NULL);
+
+  LIST_REMOVE(timer, entries);
+  LIST_INSERT_HEAD(&(eloop->free_timers), timer, entries);
+}
+
 void
 event_loop_schedule_free(struct ELoop     *eloop,
                          CollectorFreeFunc free_func,
@@ -242,6 +509,26 @@ event_loop_schedule_free(struct ELoop     *eloop,
   collector_schedule_free(eloop->collector, free_func, data);
 }
 
+/* safe to call from any thread */
+void
+event_loop_post(struct ELoop     *eloop,
+                struct ELoopPost *post)
+{
+  struct ELoopPost *head = NULL;
+
+  assert(eloop != NULL);
+  assert(post != NULL);
+  assert(post->callback != NULL);
+
+  head = __atomic_load_n(&(eloop->posts), __ATOMIC_RELAXED);
+  do {
+    post->next = head;
+  } while (!__atomic_compare_exchange_n(&(eloop->posts), &head, post, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+  if (head == NULL)
+    eventfd_write(eloop->post_fd, 1);
+}
+
 /*
  * vim: expandtab shiftwidth=2 tabstop=2:
  */
@@ -12,8 +12,22 @@
 
 struct Logger;
 struct ELoop;
+struct ELoopTimer;
 
 typedef int (*ELoopWatchFdCallback)(int fd, const void *data);
+typedef void (*ELoopTimerCallback)(const void *data);
+typedef void (*ELoopPostCallback)(void *data);
+
+/*
+ * a callback to run on the loop thread, posted from any thread: the post
+ * must stay valid until it runs. The ones still queued when the loop is
+ * destroyed are dropped.
+ */
+struct ELoopPost {
+  struct ELoopPost *next;
+  ELoopPostCallback callback;
+  void *data;
+};
 
 enum ELoopWatchFdCallbackType {
   ELOOP_CALLBACK_READ = 0,
@@ -32,8 +46,15 @@ int event_loop_add_fd_watch(struct ELoop *eloop, int fd, enum ELoopWatchFdCallba
 
 int event_loop_remove_fd_watch(struct ELoop *eloop, int fd, enum ELoopWatchFdCallbackType callback_type);
 
+int event_loop_set_fd_edge_triggered(struct ELoop *eloop, int fd, int edge_triggered);
+
+struct ELoopTimer *event_loop_add_timer(struct ELoop *eloop, unsigned timeout, ELoopTimerCallback callback, const void *data);
+void event_loop_cancel_timer(struct ELoop *eloop, struct ELoopTimer *timer);
+
 void event_loop_schedule_free(struct ELoop *eloop, CollectorFreeFunc free_func, void *data);
 
+void event_loop_post(struct ELoop *eloop, struct ELoopPost *post);
+
 #endif /* ELOOP_H */
 
 /*
@@ -11,6 +11,11 @@
 #include <errno.h>
 #include <assert.h>
 
+#include <sys/uio.h>
+
+#include "accesslog.h"
+#include "asynccontext.h"
+#include "eloop.h"
 #include "logger.h"
 #include "tcpconnection.h"
 #include "httprequestqueue.h"
@@ -20,30 +25,297 @@
 #include "httprouter.h"
 #include "logger.h"
 #include "memory.h"
+#include "metrics.h"
+#include "requesttracer.h"
 #include "tcpconnection.h"
 #include "rapp/rapp_version.h"
 
 
-#define BUFSIZE 80 * 1024
+#define MAX_IOVEC 64
+#define MAX_PENDING_RESPONSES 16
 
+/*
+ * Every request gets its own response, queued in a ring and sent in the
+ * requests order, so that pipelined requests are served without waiting
+ * for the previous responses to be sent. The responses are kept in their
+ * slots once sent, and reused for the following requests.
+ * When the ring is full, or a request asked to close the connection, the
+ * next requests aren't read until there's room again.
+ * A request served asynchronously holds the reading too, until the plugin
+ * completes it: its response is the last in the ring, and waits there.
+ * What the plugin writes to it is sent as soon as it's the first in the
+ * ring, without dropping it, and the plugin is told when it's all sent.
+ * A request streaming its body is served as soon as its headers arrive,
+ * and it's kept until the end of its body even if its response is
+ * complete before; the reading is held only after the body.
+ * With an access log, every slot of the ring has an entry too, and the
+ * request is logged once its response leaves the ring. The same goes for
+ * the traces of the requests phases, with a tracer.
+ */
 struct HTTPConnection {
   struct TcpConnection *tcp_connection;
 
   HTTPConnectionFinishCallback finish_callback;
   void *data;
+  int finished;
 
   struct HTTPRequestQueue *request_queue;
-  struct HTTPResponse *response;
+  int reading_paused;
+  int closing;
+  int writing;
+
+  struct HTTPResponse *responses[MAX_PENDING_RESPONSES];
+  size_t first_response;
+  size_t pending_responses;
+
+  struct AccessLog *access_log;
+  struct AccessLogEntry *access_entries;
+
+  struct RequestTracer *tracer;
+  struct RequestTrace *traces;
+  uint64_t read_at;
+
+  struct RappAsyncContext *async;
+  struct HTTPRequest *async_request;
+  struct HTTPRequest *stream_request;
+
+  /* a request with a body is routed with its headers, once */
+  struct HTTPRequest *routed_request;
+  struct Container *routed_container;
 
   struct HTTPRouter *router;
+  struct HTTPDate *date;
   struct Logger *logger;
+
+  struct ELoop *eloop;
+  struct HTTPConnectionTimeouts timeouts;
+  struct ELoopTimer *timer;
+  enum HTTPRequestQueueState timer_state;
 };
 
+static const char *timeout_names[] = {
+  "keep alive",
+  "header",
+  "body",
+};
+
+static void
+finish(struct HTTPConnection *http_connection)
+{
+  if (http_connection->finished)
+    return;
+
+  http_connection->finished = 1;
+  async_context_cancel(http_connection->async);
+  http_request_queue_pause(http_connection->request_queue);
+  tcp_connection_close(http_connection->tcp_connection);
+  http_connection->finish_callback(http_connection, http_connection->data);
+}
+
+static void
+pause_reading(struct HTTPConnection *http_connection)
+{
+  if (http_connection->reading_paused)
+    return;
+
+  http_connection->reading_paused = 1;
+  http_request_queue_pause(http_connection->request_queue);
+  tcp_connection_set_read_paused(http_connection->tcp_connection, 1);
+}
+
+static struct HTTPResponse *
+push_response(struct HTTPConnection *http_connection)
+{
+  struct HTTPResponse **slot = NULL;
+
+  assert(http_connection->pending_responses < MAX_PENDING_RESPONSES);
+
+  slot = &(http_connection->responses[(http_connection->first_response + http_connection->pending_responses) % MAX_PENDING_RESPONSES]);
+
+  if (*slot == NULL) {
+    if ((*slot = http_response_new(http_connection->logger, rapp_get_banner())) == NULL)
+      return NULL;
+    http_response_set_date(*slot, http_connection->date);
+  }
+  else {
+    http_response_reset(*slot);
+  }
+
+  http_connection->pending_responses++;
+
+  return *slot;
+}
+
+/* for the response just pushed */
+static void
+begin_access(struct HTTPConnection *http_connection,
+             struct HTTPRequest    *request)
+{
+  size_t last = (http_connection->first_response + http_connection->pending_responses - 1) % MAX_PENDING_RESPONSES;
+
+  if (http_connection->access_log != NULL)
+    access_log_begin(&(http_connection->access_entries[last]), request);
+}
+
+/* for the first response, once it's all sent */
+static void
+commit_access(struct HTTPConnection *http_connection)
+{
+  size_t first = http_connection->first_response;
+
+  if (http_connection->access_log != NULL)
+    access_log_commit(http_connection->access_log, &(http_connection->access_entries[first]),
+                      http_response_get_status(http_connection->responses[first]));
+}
+
+/* for the response just pushed */
+static void
+begin_trace(struct HTTPConnection *http_connection,
+            struct HTTPRequest    *request)
+{
+  size_t last = (http_connection->first_response + http_connection->pending_responses - 1) % MAX_PENDING_RESPONSES;
+
+  if (http_connection->tracer != NULL)
+    request_tracer_begin(http_connection->tracer, &(http_connection->traces[last]), request, http_connection->read_at);
+}
+
+/* the request being served is always the one of the last response */
+static void
+mark_trace(struct HTTPConnection *http_connection,
+           enum RequestPhase      phase)
+{
+  size_t last = (http_connection->first_response + http_connection->pending_responses - 1) % MAX_PENDING_RESPONSES;
+
+  if (http_connection->tracer != NULL)
+    request_trace_mark(&(http_connection->traces[last]), phase);
+}
+
+/* for the first response, once it's all sent */
+static void
+end_trace(struct HTTPConnection *http_connection)
+{
+  if (http_connection->tracer != NULL)
+    request_tracer_end(http_connection->tracer, &(http_connection->traces[http_connection->first_response]));
+}
+
+/*
+ * a body too large gets its answer after the responses already queued,
+ * the other errors just close the connection
+ */
+static void
+on_parse_error(struct HTTPConnection *http_connection)
+{
+  struct HTTPResponse *response = NULL;
+
+  if (http_request_queue_get_error(http_connection->request_queue) != HTTP_REQUEST_QUEUE_ERROR_BODY_TOO_LARGE ||
+      http_connection->async_request != NULL ||
+      http_connection->pending_responses == MAX_PENDING_RESPONSES ||
+      (response = push_response(http_connection)) == NULL) {
+    finish(http_connection);
+    return;
+  }
+
+  begin_access(http_connection, NULL);
+  begin_trace(http_connection, NULL);
+
+  /* before writing it, for the Connection header */
+  http_response_set_last(response, 1);
+  http_response_write_error_by_code(response, 413);
+
+  http_connection->closing = 1;
+  pause_reading(http_connection);
+  tcp_connection_try_write(http_connection->tcp_connection);
+}
+
+/* the requests already received are served right away */
+static void
+resume_reading(struct HTTPConnection *http_connection)
+{
+  http_connection->reading_paused = 0;
+  tcp_connection_set_read_paused(http_connection->tcp_connection, 0);
+
+  if (http_request_queue_resume(http_connection->request_queue) < 0) {
+    logger_trace(http_connection->logger, LOG_ERROR, "httpconnection", "Error parsing queued data");
+    on_parse_error(http_connection);
+  }
+}
+
+static void
+pop_response(struct HTTPConnection *http_connection)
+{
+  http_connection->first_response = (http_connection->first_response + 1) % MAX_PENDING_RESPONSES;
+  http_connection->pending_responses--;
+}
+
+static void
+on_timeout(const void *data)
+{
+  struct HTTPConnection *http_connection = NULL;
+
+  assert(data != NULL);
+
+  http_connection = (struct HTTPConnection *)data;
+  http_connection->timer = NULL;
+
+  LOGGER_INFO(http_connection->logger, "httpconnection", "%s timeout expired, closing connection",
+                                                         timeout_names[http_connection->timer_state]);
+
+  finish(http_connection);
+}
+
+/*
+ * the header and body timeouts are armed when the request enters that
+ * part, the keep alive one is armed again on every activity, but only
+ * once the connection is really idle: a request still being served, or a
+ * response still to send, aren't the client's fault.
+ */
+static void
+update_timer(struct HTTPConnection *http_connection)
+{
+  enum HTTPRequestQueueState state;
+  unsigned timeout = 0;
+
+  if (http_connection->finished)
+    return;
+
+  state = http_request_queue_get_state(http_connection->request_queue);
+
+  if (http_connection->timer != NULL) {
+    if (state == http_connection->timer_state && state != HTTP_REQUEST_QUEUE_IDLE)
+      return;
+
+    event_loop_cancel_timer(http_connection->eloop, http_connection->timer);
+    http_connection->timer = NULL;
+  }
+
+  if (state == HTTP_REQUEST_QUEUE_IDLE &&
+      (http_connection->async_request != NULL || http_connection->pending_responses > 0))
+    return;
+
+  switch (state) {
+  case HTTP_REQUEST_QUEUE_HEADERS:
+    timeout = http_connection->timeouts.header;
+    break;
+  case HTTP_REQUEST_QUEUE_BODY:
+    timeout = http_connection->timeouts.body;
+    break;
+  default:
+    timeout = http_connection->timeouts.keep_alive;
+    break;
+  }
+
+  http_connection->timer_state = state;
+
+  if (timeout > 0)
+    http_connection->timer = event_loop_add_timer(http_connection->eloop, timeout, on_timeout, http_connection);
+}
+
 static void
 on_read(struct TcpConnection *tcp_connection,
         const void           *data)
 {
-  char buffer[BUFSIZE];
+  char *buffer = NULL;
+  size_t length = 0;
   ssize_t got = -1;
   struct HTTPConnection *http_connection = NULL;
 
@@ -51,10 +323,15 @@ on_read(struct TcpConnection *tcp_connection,
 
   http_connection = (struct HTTPConnection *)data;
 
-  if ((got = tcp_connection_read_data(tcp_connection, buffer, BUFSIZE)) < 0) {
+  if (http_request_queue_get_read_buffer(http_connection->request_queue, &buffer, &length) < 0) {
+    finish(http_connection);
+    return;
+  }
+
+  if ((got = tcp_connection_read_data(tcp_connection, buffer, length)) < 0) {
     if (errno != EAGAIN) {
       LOGGER_PERROR(http_connection->logger, "read");
-      http_connection->finish_callback(http_connection, http_connection->data);
+      finish(http_connection);
     }
     return;
   }
@@ -63,36 +340,113 @@ on_read(struct TcpConnection *tcp_connection,
     return;
   }
 
-  if (http_request_queue_append_data(http_connection->request_queue, buffer, got) < 0) {
+  /* the requests starting in this data arrived now */
+  if (http_connection->tracer != NULL &&
+      http_request_queue_get_state(http_connection->request_queue) == HTTP_REQUEST_QUEUE_IDLE)
+    http_connection->read_at = request_tracer_clock();
+
+  if (http_request_queue_commit_data(http_connection->request_queue, got) < 0) {
     logger_trace(http_connection->logger, LOG_ERROR, "httpconnection", "Error appending data to queue");
-    http_connection->finish_callback(http_connection, http_connection->data);
+    on_parse_error(http_connection);
+    return;
   }
+
+  update_timer(http_connection);
 }
 
+/*
+ * sends the responses in order, as much as the socket takes: a response is
+ * dropped from the ring once sent, the connection is closed after the last.
+ * The one of an async request stays until it's complete, the plugin can
+ * add to it from the drain callback. Returns 1 once there's nothing left.
+ */
+static int
+write_responses(struct HTTPConnection *http_connection,
+                struct TcpConnection  *tcp_connection)
+{
+  struct iovec iov[MAX_IOVEC];
+  int iovcnt = 0;
+  int file_fd = -1;
+  off_t file_offset = 0;
+  size_t file_length = 0;
+  ssize_t written = -1;
+  struct HTTPResponse *response = NULL;
+
+  while (http_connection->pending_responses > 0) {
+    response = http_connection->responses[http_connection->first_response];
+
+    if ((iovcnt = http_response_get_iovec(response, iov, MAX_IOVEC)) > 0) {
+      written = tcp_connection_writev(tcp_connection, iov, iovcnt);
+    }
+    else if (http_response_get_file(response, &file_fd, &file_offset, &file_length) == 0) {
+      /* 0 means the file is shorter than promised: the response can't be completed */
+      if ((written = tcp_connection_sendfile(tcp_connection, file_fd, &file_offset, file_length)) == 0) {
+        logger_trace(http_connection->logger, LOG_ERROR, "httpconnection", "sendfile: unexpected end of file");
+        finish(http_connection);
+        return 0;
+      }
+    }
+    else if (http_connection->async_request != NULL && http_connection->pending_responses == 1) {
+      if (!async_context_drain(http_connection->async))
+        break;
+      continue;
+    }
+    else {
+      commit_access(http_connection);
+      end_trace(http_connection);
+      if (http_response_is_last(response) != 0) {
+        finish(http_connection);
+        return 0;
+      }
+      pop_response(http_connection);
+      continue;
+    }
+
+    if (written < 0) {
+      if (errno != EAGAIN) {
+        LOGGER_PERROR(http_connection->logger, "write");
+        finish(http_connection);
+        return 0;
+      }
+      tcp_connection_set_write_pending(tcp_connection, 1);
+      return 0;
+    }
+
+    http_response_consume_data(response, written);
+    metrics_count(METRICS_BYTES_OUT, written);
+    if (http_connection->access_log != NULL)
+      http_connection->access_entries[http_connection->first_response].record.bytes += written;
+  }
+
+  tcp_connection_set_write_pending(tcp_connection, 0);
+  /* all sent: the keep alive starts now */
+  update_timer(http_connection);
+
+  return 1;
+}
+
+/* the plugin can flush or complete while its response is being sent */
 static void
 on_write(struct TcpConnection *tcp_connection,
          const void           *data)
 {
-  char buffer[BUFSIZE];
-  ssize_t got = -1;
   struct HTTPConnection *http_connection = NULL;
+  int done = 0;
 
   assert(data != NULL);
 
   http_connection = (struct HTTPConnection *)data;
 
-  if ((got = http_response_read_data(http_connection->response, buffer, BUFSIZE)) > 0) {
-    if (tcp_connection_write_data(tcp_connection, buffer, got) < 0) {
-      if (errno != EAGAIN)
-        LOGGER_PERROR(http_connection->logger, "write");
-    }
-  }
-  else {
-    if (http_response_is_last(http_connection->response) != 0) {
-      tcp_connection_close(tcp_connection);
-      http_connection->finish_callback(http_connection, http_connection->data);
-    }
-  }
+  if (http_connection->writing)
+    return;
+
+  http_connection->writing = 1;
+  done = write_responses(http_connection, tcp_connection);
+  http_connection->writing = 0;
+
+  /* out of the loop: the requests served now queue more responses */
+  if (done && http_connection->reading_paused && !http_connection->closing && http_connection->async_request == NULL)
+    resume_reading(http_connection);
 }
 
 static void
@@ -105,8 +459,62 @@ on_close(struct TcpConnection *tcp_connection,
 
   http_connection = (struct HTTPConnection *)data;
 
-  tcp_connection_close(tcp_connection);
-  http_connection->finish_callback(http_connection, http_connection->data);
+  finish(http_connection);
+}
+
+/* the response is complete: it's sent once the previous ones are */
+static void
+end_request(struct HTTPConnection *http_connection,
+            struct HTTPRequest    *request)
+{
+  /* the rest of the body is dropped: see on_body */
+  if (request == http_connection->stream_request) {
+    tcp_connection_try_write(http_connection->tcp_connection);
+    return;
+  }
+
+  if (http_request_is_last(request)) {
+    http_connection->closing = 1;
+    pause_reading(http_connection);
+  }
+  else if (http_connection->pending_responses == MAX_PENDING_RESPONSES) {
+    pause_reading(http_connection);
+  }
+
+  http_request_destroy(request);
+  tcp_connection_try_write(http_connection->tcp_connection);
+}
+
+static void
+on_async_complete(struct RappAsyncContext *context,
+                  void                    *data)
+{
+  struct HTTPConnection *http_connection = NULL;
+  struct HTTPRequest *request = NULL;
+
+  assert(data != NULL);
+
+  http_connection = (struct HTTPConnection *)data;
+
+  request = http_connection->async_request;
+  http_connection->async_request = NULL;
+  mark_trace(http_connection, REQUEST_PHASE_SERVED);
+
+  /* the reading resumes once the responses are sent */
+  end_request(http_connection, request);
+}
+
+static void
+on_async_flush(struct RappAsyncContext *context,
+               void                    *data)
+{
+  struct HTTPConnection *http_connection = NULL;
+
+  assert(data != NULL);
+
+  http_connection = (struct HTTPConnection *)data;
+
+  tcp_connection_try_write(http_connection->tcp_connection);
 }
 
 static void
@@ -115,50 +523,138 @@ on_new_request(struct HTTPRequestQueue *request_queue,
 {
   struct HTTPConnection *http_connection = NULL;
   struct HTTPRequest *request = NULL;
+  struct HTTPResponse *response = NULL;
+  struct Container *container = NULL;
+  int ret = 0;
 
   assert(data != NULL);
 
   http_connection = (struct HTTPConnection *)data;
 
-  request = http_request_queue_get_next_request(request_queue);
-  http_response_set_last(http_connection->response, http_request_is_last(request));
+  if ((request = http_request_queue_get_next_request(request_queue)) == NULL) {
+    logger_trace(http_connection->logger, LOG_ERROR, "httpconnection", "NULL request");
+    finish(http_connection);
+    return;
+  }
 
-  if (request != NULL) {
-    http_router_serve(http_connection->router, request, http_connection->response);
+  if ((response = push_response(http_connection)) == NULL) {
     http_request_destroy(request);
+    finish(http_connection);
+    return;
   }
-  else {
-    http_request_destroy(request);
-    logger_trace(http_connection->logger, LOG_ERROR, "httpconnection", "NULL request");
-    http_connection->finish_callback(http_connection, http_connection->data);
+
+  http_response_set_last(response, http_request_is_last(request));
+  begin_access(http_connection, request);
+  begin_trace(http_connection, request);
+
+  if (request == http_connection->routed_request)
+    container = http_connection->routed_container;
+  else
+    container = http_router_route(http_connection->router, request);
+  http_connection->routed_request = NULL;
+  mark_trace(http_connection, REQUEST_PHASE_ROUTED);
+
+  async_context_begin(http_connection->async);
+  ret = http_router_serve_container_async(http_connection->router, container, request, response, http_connection->async);
+
+  /* the following requests wait: the queue buffer must stay as it is */
+  if (async_context_end(http_connection->async, ret)) {
+    http_connection->async_request = request;
+    if (request != http_connection->stream_request)
+      pause_reading(http_connection);
+    /* for what the plugin has flushed already */
+    tcp_connection_try_write(http_connection->tcp_connection);
+    return;
+  }
+
+  mark_trace(http_connection, REQUEST_PHASE_SERVED);
+  end_request(http_connection, request);
+}
+
+static int
+on_stream_request(struct HTTPRequestQueue *request_queue,
+                  struct HTTPRequest      *request,
+                  void                    *data)
+{
+  struct HTTPConnection *http_connection = NULL;
+
+  assert(data != NULL);
+
+  http_connection = (struct HTTPConnection *)data;
+
+  /* the same container serves it, streamed or not */
+  http_connection->routed_request = request;
+  http_connection->routed_container = http_router_route(http_connection->router, request);
+
+  if (!http_router_stream_body(http_connection->router, http_connection->routed_container, request))
+    return 0;
+
+  http_connection->stream_request = request;
+
+  return 1;
+}
+
+static void
+on_body(struct HTTPRequestQueue *request_queue,
+        const char              *chunk,
+        size_t                   length,
+        void                    *data)
+{
+  struct HTTPConnection *http_connection = NULL;
+  struct HTTPRequest *request = NULL;
+
+  assert(data != NULL);
+
+  http_connection = (struct HTTPConnection *)data;
+  request = http_connection->stream_request;
+
+  if (request == http_connection->async_request)
+    async_context_body(http_connection->async, chunk, length);
+
+  if (length > 0)
+    return;
+
+  http_connection->stream_request = NULL;
+
+  /* from now on it's like any other request served asynchronously */
+  if (request == http_connection->async_request) {
+    pause_reading(http_connection);
+    return;
   }
+
+  end_request(http_connection, request);
 }
 
 struct HTTPConnection *
 http_connection_new(struct Logger        *logger,
+                    struct ELoop         *eloop,
                     struct TcpConnection *tcp_connection,
                     struct HTTPRouter    *router)
 {
   struct HTTPConnection *http_connection = NULL;
 
+  assert(eloop != NULL);
   assert(tcp_connection != NULL);
 
-  if ((http_connection = memory_create(sizeof(struct HTTPConnection))) == NULL) {
-    LOGGER_PERROR(logger, "memory_create");
+  if ((http_connection = memory_pool_create(MEMORY_POOL_HTTP_CONNECTION, sizeof(struct HTTPConnection))) == NULL) {
+    LOGGER_PERROR(logger, "memory_pool_create");
     return NULL;
   }
 
   if ((http_connection->request_queue = http_request_queue_new(logger)) == NULL) {
-    memory_destroy(http_connection);
+    memory_pool_destroy(MEMORY_POOL_HTTP_CONNECTION, http_connection);
     return NULL;
   }
   http_request_queue_set_new_request_callback(http_connection->request_queue, on_new_request, http_connection);
+  http_request_queue_set_stream_callbacks(http_connection->request_queue, on_stream_request, on_body, http_connection);
 
-  if ((http_connection->response = http_response_new(logger, rapp_get_banner())) == NULL) {
-    memory_destroy(http_connection->request_queue);
-    memory_destroy(http_connection);
+  if ((http_connection->async = async_context_new(logger, eloop)) == NULL) {
+    http_request_queue_destroy(http_connection->request_queue);
+    memory_pool_destroy(MEMORY_POOL_HTTP_CONNECTION, http_connection);
     return NULL;
   }
+  async_context_set_complete_callback(http_connection->async, on_async_complete, http_connection);
+  async_context_set_flush_callback(http_connection->async, on_async_flush, http_connection);
 
   http_connection->router = router;
 
@@ -167,24 +663,57 @@ http_connection_new(struct Logger        *logger,
 
   http_connection->logger = logger;
 
+  http_connection->eloop = eloop;
+  http_connection->timeouts.header = HTTP_CONNECTION_DEFAULT_HEADER_TIMEOUT;
+  http_connection->timeouts.body = HTTP_CONNECTION_DEFAULT_BODY_TIMEOUT;
+  http_connection->timeouts.keep_alive = HTTP_CONNECTION_DEFAULT_KEEP_ALIVE_TIMEOUT;
+  update_timer(http_connection);
+
+  metrics_count(METRICS_CONNECTIONS, 1);
+
   return http_connection;
 }
 
 void
 http_connection_destroy(struct HTTPConnection *http_connection)
 {
+  size_t i = 0;
+
   assert(http_connection != NULL);
 
+  if (http_connection->timer != NULL)
+    event_loop_cancel_timer(http_connection->eloop, http_connection->timer);
+
   if (http_connection->tcp_connection != NULL)
     tcp_connection_destroy(http_connection->tcp_connection);
 
+  /* the plugin is told first: it may still use the request */
+  if (http_connection->async != NULL)
+    async_context_destroy(http_connection->async);
+
+  if (http_connection->async_request != NULL)
+    http_request_destroy(http_connection->async_request);
+
+  if (http_connection->stream_request != NULL && http_connection->stream_request != http_connection->async_request)
+    http_request_destroy(http_connection->stream_request);
+
   if (http_connection->request_queue != NULL)
     http_request_queue_destroy(http_connection->request_queue);
 
-  if (http_connection->response != NULL)
-    http_response_destroy(http_connection->response);
+  for (i = 0; i < MAX_PENDING_RESPONSES; i++) {
+    if (http_connection->responses[i] != NULL)
+      http_response_destroy(http_connection->responses[i]);
+  }
 
-  memory_destroy(http_connection);
+  if (http_connection->access_entries != NULL)
+    memory_destroy(http_connection->access_entries);
+
+  if (http_connection->traces != NULL)
+    memory_destroy(http_connection->traces);
+
+  metrics_count(METRICS_CONNECTIONS, -1);
+
+  memory_pool_destroy(MEMORY_POOL_HTTP_CONNECTION, http_connection);
 }
 
 void
@@ -199,6 +728,87 @@ http_connection_set_finish_callback(struct HTTPConnection        *http_connectio
   http_connection->data = data;
 }
 
+void
+http_connection_set_timeouts(struct HTTPConnection               *http_connection,
+                             const struct HTTPConnectionTimeouts *timeouts)
+{
+  assert(http_connection != NULL);
+  assert(timeouts != NULL);
+
+  http_connection->timeouts = *timeouts;
+
+  if (http_connection->timer != NULL) {
+    event_loop_cancel_timer(http_connection->eloop, http_connection->timer);
+    http_connection->timer = NULL;
+  }
+  update_timer(http_connection);
+}
+
+/* 0 means no limit */
+void
+http_connection_set_max_body_size(struct HTTPConnection *http_connection,
+                                  size_t                 max_body_size)
+{
+  assert(http_connection != NULL);
+
+  http_request_queue_set_max_body_size(http_connection->request_queue, max_body_size);
+}
+
+void
+http_connection_set_offload_pool(struct HTTPConnection *http_connection,
+                                 struct OffloadPool    *pool)
+{
+  assert(http_connection != NULL);
+
+  async_context_set_offload_pool(http_connection->async, pool);
+}
+
+/* applies to the responses created from now on: it must outlive them */
+void
+http_connection_set_date(struct HTTPConnection *http_connection,
+                         struct HTTPDate       *date)
+{
+  assert(http_connection != NULL);
+
+  http_connection->date = date;
+}
+
+/* the requests arrived from now on are logged to log, if not NULL */
+int
+http_connection_set_access_log(struct HTTPConnection *http_connection,
+                               struct AccessLog      *log)
+{
+  assert(http_connection != NULL);
+
+  if (log != NULL && http_connection->access_entries == NULL &&
+      (http_connection->access_entries = memory_create(sizeof(struct AccessLogEntry) * MAX_PENDING_RESPONSES)) == NULL) {
+    LOGGER_PERROR(http_connection->logger, "memory_create");
+    return -1;
+  }
+
+  http_connection->access_log = log;
+
+  return 0;
+}
+
+/* the requests arrived from now on are traced by tracer, if not NULL */
+int
+http_connection_set_tracer(struct HTTPConnection *http_connection,
+                           struct RequestTracer  *tracer)
+{
+  assert(http_connection != NULL);
+
+  if (tracer != NULL && http_connection->traces == NULL &&
+      (http_connection->traces = memory_create(sizeof(struct RequestTrace) * MAX_PENDING_RESPONSES)) == NULL) {
+    LOGGER_PERROR(http_connection->logger, "memory_create");
+    return -1;
+  }
+
+  http_connection->tracer = tracer;
+
+  return 0;
+}
+
 /*
  * vim: expandtab shiftwidth=2 tabstop=2:
  */
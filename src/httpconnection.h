@@ -8,19 +8,49 @@
 #ifndef HTTPCONNECTION_H
 #define HTTPCONNECTION_H
 
+#include <stddef.h>
+
 struct Logger;
+struct ELoop;
 struct TcpConnection;
 struct HTTPConnection;
 struct HTTPRouter;
+struct OffloadPool;
+struct HTTPDate;
+struct AccessLog;
+struct RequestTracer;
+
+/* milliseconds */
+#define HTTP_CONNECTION_DEFAULT_HEADER_TIMEOUT 10000
+#define HTTP_CONNECTION_DEFAULT_BODY_TIMEOUT 30000
+#define HTTP_CONNECTION_DEFAULT_KEEP_ALIVE_TIMEOUT 15000
 
+/*
+ * header and body are the time allowed to receive the whole headers and
+ * the whole body of a request, keep_alive is the time a connection can stay
+ * idle between requests. 0 disables the timeout.
+ */
+struct HTTPConnectionTimeouts {
+  unsigned header;
+  unsigned body;
+  unsigned keep_alive;
+};
 
 typedef void (*HTTPConnectionFinishCallback)(struct HTTPConnection *connection, void *data);
 
-struct HTTPConnection *http_connection_new(struct Logger *logger, struct TcpConnection *tcp_connection, struct HTTPRouter *router);
+struct HTTPConnection *http_connection_new(struct Logger *logger, struct ELoop *eloop, struct TcpConnection *tcp_connection, struct HTTPRouter *router);
 void http_connection_destroy(struct HTTPConnection *http_connection);
 
 void http_connection_set_finish_callback(struct HTTPConnection *connection, HTTPConnectionFinishCallback finish_callback, void *data);
 
+void http_connection_set_timeouts(struct HTTPConnection *connection, const struct HTTPConnectionTimeouts *timeouts);
+
+void http_connection_set_max_body_size(struct HTTPConnection *connection, size_t max_body_size);
+void http_connection_set_offload_pool(struct HTTPConnection *connection, struct OffloadPool *pool);
+void http_connection_set_date(struct HTTPConnection *connection, struct HTTPDate *date);
+int http_connection_set_access_log(struct HTTPConnection *connection, struct AccessLog *log);
+int http_connection_set_tracer(struct HTTPConnection *connection, struct RequestTracer *tracer);
+
 #endif /* HTTPCONNECTION_H */
 
 /*
@@ -0,0 +1,132 @@
+/*
+ * httpdate.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <assert.h>
+
+#include "eloop.h"
+#include "httpdate.h"
+#include "logger.h"
+#include "memory.h"
+#include "rapp/rapp_httpresponse.h"
+
+/*
+ * The Date header of the responses of a loop, formatted once when the
+ * second changes instead of for every response: a timer fires right after
+ * every second begins, late by the loop tick at most.
+ */
+struct HTTPDate {
+  char header[HTTP_DATE_HEADER_SIZE];
+  size_t length;
+
+  struct ELoop *eloop;
+  struct ELoopTimer *timer;
+  struct Logger *logger;
+};
+
+static void
+refresh(struct HTTPDate *date);
+
+static void
+on_tick(const void *data)
+{
+  struct HTTPDate *date = NULL;
+
+  assert(data != NULL);
+
+  date = (struct HTTPDate *)data;
+  date->timer = NULL;
+
+  refresh(date);
+}
+
+static void
+refresh(struct HTTPDate *date)
+{
+  struct timespec now;
+  size_t length = 0;
+
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  /* on error the previous second is better than nothing */
+  if ((length = http_date_format_header(date->header, now.tv_sec)) > 0)
+    date->length = length;
+  else
+    logger_trace(date->logger, LOG_ERROR, "httpdate", "error formatting datetime");
+
+  date->timer = event_loop_add_timer(date->eloop, 1000 - now.tv_nsec / 1000000, on_tick, date);
+}
+
+struct HTTPDate *
+http_date_new(struct Logger *logger,
+              struct ELoop  *eloop)
+{
+  struct HTTPDate *date = NULL;
+
+  assert(eloop != NULL);
+
+  if ((date = memory_create(sizeof(struct HTTPDate))) == NULL) {
+    LOGGER_PERROR(logger, "memory_create");
+    return NULL;
+  }
+
+  date->eloop = eloop;
+  date->logger = logger;
+
+  refresh(date);
+
+  if (date->length == 0) {
+    http_date_destroy(date);
+    return NULL;
+  }
+
+  return date;
+}
+
+void
+http_date_destroy(struct HTTPDate *date)
+{
+  assert(date != NULL);
+
+  if (date->timer != NULL)
+    event_loop_cancel_timer(date->eloop, date->timer);
+
+  memory_destroy(date);
+}
+
+const char *
+http_date_get_header(struct HTTPDate *date,
+                     size_t          *length)
+{
+  assert(date != NULL);
+  assert(length != NULL);
+
+  *length = date->length;
+
+  return date->header;
+}
+
+size_t
+http_date_format_header(char   *buffer,
+                        time_t  now)
+{
+  struct tm now_tm;
+
+  assert(buffer != NULL);
+
+  if (gmtime_r(&now, &now_tm) == NULL)
+    return 0;
+
+  return strftime(buffer, HTTP_DATE_HEADER_SIZE, "Date: %a, %d %b %Y %H:%M:%S %z" HTTP_EOL, &now_tm);
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
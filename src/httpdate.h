@@ -0,0 +1,34 @@
+/*
+ * httpdate.h - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#ifndef HTTPDATE_H
+#define HTTPDATE_H
+
+#include <stddef.h>
+#include <time.h>
+
+/* Date: %a, %d %b %Y %H:%M:%S %z + HTTP_EOL + NULL, with room to spare */
+#define HTTP_DATE_HEADER_SIZE 48
+
+struct Logger;
+struct ELoop;
+struct HTTPDate;
+
+struct HTTPDate *http_date_new(struct Logger *logger, struct ELoop *eloop);
+void http_date_destroy(struct HTTPDate *date);
+
+/* the whole header line, HTTP_EOL included: it's rewritten in place every second */
+const char *http_date_get_header(struct HTTPDate *date, size_t *length);
+
+/* returns the length of the line, 0 on error */
+size_t http_date_format_header(char *buffer, time_t now);
+
+#endif /* HTTPDATE_H */
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
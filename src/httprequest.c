@@ -5,6 +5,7 @@
  *     see LICENSE for all the details.
  */
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,6 +16,57 @@
 #include "logger.h"
 #include "memory.h"
 
+#define ARENA_BLOCK_SIZE 4096
+#define ARENA_ALIGNMENT 16
+#define ARENA_ALIGN(size) (((size) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+/*
+ * The arena hands out memory by bumping a pointer in its first block: the
+ * blocks are released all together when the request is destroyed.
+ * The blocks of ARENA_BLOCK_SIZE bytes come from a pool, the ones for the
+ * bigger allocations are chained after the first one, which stays in use.
+ */
+struct ArenaBlock {
+  struct ArenaBlock *next;
+  size_t size;
+  size_t used;
+};
+
+#define ARENA_HEADER_SIZE ARENA_ALIGN(sizeof(struct ArenaBlock))
+
+/* a power of two, over twice HTTP_REQUEST_MAX_HEADERS */
+#define HEADERS_INDEX_SIZE 256
+
+#define FNV_PRIME 16777619u
+
+/*
+ * The headers are indexed by the hash of their name, given by the queue
+ * while it parses them, in a table with linear probing: a lookup only
+ * compares the names with the same hash, in place. The well known ones
+ * also get a slot of their own, looked up without hashing anything.
+ * The names are checked on lookup: they aren't at hand while indexing.
+ */
+struct KnownHeader {
+  const char *name;
+  size_t length;
+  unsigned hash;
+};
+
+/* by enum HTTPHeader, with the hashes given by http_header_hash */
+static const struct KnownHeader known_headers[HTTP_HEADER_MAX] = {
+  {"Accept", 6, 0x08247e29u},
+  {"Accept-Encoding", 15, 0xc9715a99u},
+  {"Authorization", 13, 0x913657beu},
+  {"Connection", 10, 0x38b99ed9u},
+  {"Content-Length", 14, 0x4df9451du},
+  {"Content-Type", 12, 0xfcf70995u},
+  {"Cookie", 6, 0x77a740bfu},
+  {"Host", 4, 0xaffea56fu},
+  {"If-Modified-Since", 17, 0x83e879a9u},
+  {"If-None-Match", 13, 0x972b6177u},
+  {"Transfer-Encoding", 17, 0xddb4744cu},
+  {"User-Agent", 10, 0x24259beeu},
+};
 
 struct HTTPRequest {
   enum HTTPMethod method;
@@ -24,23 +76,86 @@ struct HTTPRequest {
   struct HeaderMemoryRange headers_ranges[HTTP_REQUEST_MAX_HEADERS];
   unsigned current_header;
 
-  char *headers_buffer;
+  /* the header index + 1, 0 when free */
+  unsigned headers_hashes[HTTP_REQUEST_MAX_HEADERS];
+  unsigned char headers_index[HEADERS_INDEX_SIZE];
+  unsigned char known_headers[HTTP_HEADER_MAX];
+
+  /* points into the queue buffer, or into the arena for the fake ones */
+  const char *headers_buffer;
+
+  struct MemoryRange body_range;
 
-  char *body;
-  size_t body_length;
+  /* the names belong to the route */
+  char *const *params_names;
+  struct MemoryRange params_ranges[HTTP_REQUEST_MAX_PARAMS];
+  unsigned params_num;
 
   int is_last;
 
+  struct ArenaBlock *arena;
+
   struct Logger *logger;
 };
 
+static void
+arena_reset(struct HTTPRequest *request)
+{
+  struct ArenaBlock *block = NULL;
+
+  while ((block = request->arena) != NULL) {
+    request->arena = block->next;
+
+    if (block->size == ARENA_BLOCK_SIZE)
+      memory_pool_destroy(MEMORY_POOL_HTTP_REQUEST_ARENA, block);
+    else
+      memory_destroy(block);
+  }
+}
+
+static struct ArenaBlock *
+arena_add_block(struct HTTPRequest *request,
+                size_t              size)
+{
+  struct ArenaBlock *block = NULL;
+  size_t block_size = ARENA_BLOCK_SIZE;
+
+  if (ARENA_HEADER_SIZE + size > ARENA_BLOCK_SIZE)
+    block_size = ARENA_HEADER_SIZE + size;
+
+  if (block_size == ARENA_BLOCK_SIZE)
+    block = memory_pool_create(MEMORY_POOL_HTTP_REQUEST_ARENA, ARENA_BLOCK_SIZE);
+  else
+    block = memory_create(block_size);
+
+  if (block == NULL) {
+    LOGGER_PERROR(request->logger, "memory_create");
+    return NULL;
+  }
+
+  block->size = block_size;
+  block->used = ARENA_HEADER_SIZE;
+
+  /* a dedicated block leaves the current one in use */
+  if (request->arena != NULL && block_size > ARENA_BLOCK_SIZE) {
+    block->next = request->arena->next;
+    request->arena->next = block;
+  }
+  else {
+    block->next = request->arena;
+    request->arena = block;
+  }
+
+  return block;
+}
+
 struct HTTPRequest *
 http_request_new(struct Logger *logger)
 {
   struct HTTPRequest *request = NULL;
 
-  if ((request = memory_create(sizeof(struct HTTPRequest))) == NULL) {
-    LOGGER_PERROR(logger, "memory_create");
+  if ((request = memory_pool_create(MEMORY_POOL_HTTP_REQUEST, sizeof(struct HTTPRequest))) == NULL) {
+    LOGGER_PERROR(logger, "memory_pool_create");
     return NULL;
   }
 
@@ -54,31 +169,23 @@ http_request_destroy(struct HTTPRequest *request)
 {
   assert(request != NULL);
 
-  if (request->headers_buffer != NULL)
-    memory_destroy(request->headers_buffer);
-
-  if (request->body != NULL)
-    memory_destroy(request->body);
+  arena_reset(request);
 
-  memory_destroy(request);
+  memory_pool_destroy(MEMORY_POOL_HTTP_REQUEST, request);
 }
 
-int
+/*
+ * the buffer is not copied: all the ranges are relative to it, and it must
+ * outlive the request.
+ */
+void
 http_request_set_headers_buffer(struct HTTPRequest *request,
-                                const char         *buffer,
-                                size_t              length)
+                                const char         *buffer)
 {
   assert(request != NULL);
   assert(buffer != NULL);
-  assert(length > 0);
-
-  if ((request->headers_buffer = memory_create(length)) == NULL) {
-    LOGGER_PERROR(request->logger, "memory_create");
-    return -1;
-  }
-  memcpy(request->headers_buffer, buffer, length);
 
-  return 0;
+  request->headers_buffer = buffer;
 }
 
 const char *
@@ -155,16 +262,56 @@ http_request_get_url_field_range(struct HTTPRequest *request,
   return 0;
 }
 
+/* FNV-1a of the lowercase name: it can be fed a piece at a time */
+unsigned
+http_header_hash(unsigned    hash,
+                 const char *name,
+                 size_t      length)
+{
+  size_t i = 0;
+  unsigned char c = 0;
+
+  assert(name != NULL || length == 0);
+
+  for (i = 0; i < length; i++) {
+    c = name[i];
+    if (c >= 'A' && c <= 'Z')
+      c += 'a' - 'A';
+    hash = (hash ^ c) * FNV_PRIME;
+  }
+
+  return hash;
+}
+
+/* the first of the headers with the same name is the one found */
 void
 http_request_set_header_key_range(struct HTTPRequest *request,
                                   unsigned            header_index,
                                   size_t              offset,
-                                  size_t              length)
+                                  size_t              length,
+                                  unsigned            hash)
 {
+  unsigned slot = 0;
+  unsigned i = 0;
+
   assert(request != NULL);
+  assert(header_index < HTTP_REQUEST_MAX_HEADERS);
 
   request->headers_ranges[header_index].key.offset = offset;
   request->headers_ranges[header_index].key.length = length;
+  request->headers_hashes[header_index] = hash;
+
+  for (slot = hash % HEADERS_INDEX_SIZE; request->headers_index[slot] != 0; slot = (slot + 1) % HEADERS_INDEX_SIZE)
+    ;
+  request->headers_index[slot] = header_index + 1;
+
+  for (i = 0; i < HTTP_HEADER_MAX; i++) {
+    if (known_headers[i].hash == hash && known_headers[i].length == length) {
+      if (request->known_headers[i] == 0)
+        request->known_headers[i] = header_index + 1;
+      break;
+    }
+  }
 }
 
 void
@@ -181,36 +328,83 @@ http_request_set_header_value_range(struct HTTPRequest *request,
   request->current_header++;
 }
 
+static int
+header_name_is(struct HTTPRequest *request,
+               unsigned            header_index,
+               const char         *name,
+               size_t              length)
+{
+  const struct MemoryRange *key = &(request->headers_ranges[header_index].key);
+
+  return key->length == length && strncasecmp(&(request->headers_buffer[key->offset]), name, length) == 0;
+}
+
+static int
+find_header(struct HTTPRequest *request,
+            const char         *name,
+            size_t              length,
+            unsigned            hash)
+{
+  unsigned slot = 0;
+  unsigned i = 0;
+
+  for (slot = hash % HEADERS_INDEX_SIZE; request->headers_index[slot] != 0; slot = (slot + 1) % HEADERS_INDEX_SIZE) {
+    i = request->headers_index[slot] - 1;
+
+    if (i < request->current_header && request->headers_hashes[i] == hash && header_name_is(request, i, name, length))
+      return i;
+  }
+
+  return -1;
+}
+
 int
 http_request_get_header_value_range(struct HTTPRequest *request,
                                     const char         *header_name,
                                     struct MemoryRange *range)
 {
+  size_t length = 0;
   int i = 0;
-  char *current_header_name = NULL;
-  size_t current_header_name_length = 0;
 
   assert(request != NULL);
   assert(header_name != NULL);
   assert(range != NULL);
 
-  while (i < request->current_header) {
-    current_header_name_length = request->headers_ranges[i].key.length;
+  length = strlen(header_name);
 
-    current_header_name = alloca(current_header_name_length + 1);
+  if ((i = find_header(request, header_name, length, http_header_hash(HTTP_HEADER_HASH_INIT, header_name, length))) < 0)
+    return -1;
 
-    memcpy(current_header_name, &(request->headers_buffer[request->headers_ranges[i].key.offset]), current_header_name_length);
-    current_header_name[current_header_name_length] = 0;
+  *range = request->headers_ranges[i].value;
 
-    if (strcasecmp(header_name, current_header_name) == 0) {
-      *range = request->headers_ranges[i].value;
-      return 0;
-    }
+  return 0;
+}
 
-    i++;
-  }
+/* a name with the same hash can take the slot: then it's looked up as usual */
+int
+http_request_get_known_header_range(struct HTTPRequest *request,
+                                    enum HTTPHeader     header,
+                                    struct MemoryRange *range)
+{
+  const struct KnownHeader *known = NULL;
+  int i = 0;
 
-  return -1;
+  assert(request != NULL);
+  assert(header < HTTP_HEADER_MAX);
+  assert(range != NULL);
+
+  known = &(known_headers[header]);
+
+  if ((i = request->known_headers[header] - 1) < 0 || i >= request->current_header)
+    return -1;
+
+  if (!header_name_is(request, i, known->name, known->length) &&
+      (i = find_header(request, known->name, known->length, known->hash)) < 0)
+    return -1;
+
+  *range = request->headers_ranges[i].value;
+
+  return 0;
 }
 
 void
@@ -226,40 +420,35 @@ http_request_get_headers_ranges(struct HTTPRequest        *request,
   *n_ranges = request->current_header;
 }
 
+/* the body is not null terminated: see http_request_get_body_length */
 const char *
 http_request_get_body(struct HTTPRequest *request)
 {
   assert(request != NULL);
 
-  return request->body;
+  if (request->body_range.length == 0)
+    return NULL;
+
+  return &(request->headers_buffer[request->body_range.offset]);
 }
 
-int
-http_request_set_body_length(struct HTTPRequest *request,
-                             size_t              length)
+size_t
+http_request_get_body_length(struct HTTPRequest *request)
 {
   assert(request != NULL);
-  assert(length > 0);
-
-  if ((request->body = memory_create(length)) == NULL) {
-    LOGGER_PERROR(request->logger, "memory_create");
-    return -1;
-  }
 
-  return 0;
+  return request->body_range.length;
 }
 
 void
-http_request_append_body_data(struct HTTPRequest *request,
-                              const char         *data,
-                              size_t              length)
+http_request_set_body_range(struct HTTPRequest *request,
+                            size_t              offset,
+                            size_t              length)
 {
-    assert(request != NULL);
-    assert(data != NULL);
-    assert(length > 0);
+  assert(request != NULL);
 
-    memcpy(&(request->body[request->body_length]), data, length);
-    request->body_length += length;
+  request->body_range.offset = offset;
+  request->body_range.length = length;
 }
 
 void
@@ -279,6 +468,42 @@ http_request_is_last(struct HTTPRequest *request)
   return request->is_last;
 }
 
+/* the names are not copied, they must outlive the request */
+void
+http_request_set_params(struct HTTPRequest       *request,
+                        char *const              *names,
+                        const struct MemoryRange *ranges,
+                        unsigned                  n_params)
+{
+  assert(request != NULL);
+  assert(n_params <= HTTP_REQUEST_MAX_PARAMS);
+
+  request->params_names = names;
+  memcpy(request->params_ranges, ranges, n_params * sizeof(struct MemoryRange));
+  request->params_num = n_params;
+}
+
+int
+http_request_get_param_range(struct HTTPRequest *request,
+                             const char         *name,
+                             struct MemoryRange *range)
+{
+  unsigned i = 0;
+
+  assert(request != NULL);
+  assert(name != NULL);
+  assert(range != NULL);
+
+  for (i = 0; i < request->params_num; i++) {
+    if (strcmp(request->params_names[i], name) == 0) {
+      *range = request->params_ranges[i];
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
 struct HTTPRequest *
 http_request_new_fake_url(struct Logger *logger,
                           const char    *url)
@@ -290,15 +515,15 @@ http_request_new_fake_url(struct Logger *logger,
   assert(url);
 
   request_len = strlen(url);
-  if ((request_url = memory_strdup(url)) == NULL) {
-    LOGGER_PERROR(logger, "memory_strdup");
+
+  if ((request = http_request_new(logger)) == NULL)
     return NULL;
-  }
 
-  if ((request = http_request_new(logger)) == NULL) {
-    memory_destroy(request_url);
+  if ((request_url = rapp_request_alloc(request, request_len)) == NULL) {
+    http_request_destroy(request);
     return NULL;
   }
+  memcpy(request_url, url, request_len);
 
   request->headers_buffer = request_url;
   request->url_range.offset = 0;
@@ -306,6 +531,71 @@ http_request_new_fake_url(struct Logger *logger,
   return request;
 }
 
+void *
+rapp_request_alloc(struct HTTPRequest *request,
+                   size_t              size)
+{
+  struct ArenaBlock *block = NULL;
+  char *mem = NULL;
+
+  assert(request != NULL);
+
+  size = ARENA_ALIGN(size > 0 ? size : 1);
+
+  block = request->arena;
+  if (block == NULL || block->size - block->used < size) {
+    if ((block = arena_add_block(request, size)) == NULL)
+      return NULL;
+  }
+
+  mem = (char *)block + block->used;
+  block->used += size;
+
+  return mem;
+}
+
+/* tries to format right in the room left in the current block first */
+char *
+rapp_request_sprintf(struct HTTPRequest *request,
+                     const char         *format,
+                     ...)
+{
+  struct ArenaBlock *block = NULL;
+  va_list args;
+  char *str = NULL;
+  size_t room = 0;
+  int length = 0;
+
+  assert(request != NULL);
+  assert(format != NULL);
+
+  if ((block = request->arena) != NULL) {
+    str = (char *)block + block->used;
+    room = block->size - block->used;
+  }
+
+  va_start(args, format);
+  length = vsnprintf(str, room, format, args);
+  va_end(args);
+
+  if (length < 0)
+    return NULL;
+
+  if ((size_t)length < room) {
+    block->used += ARENA_ALIGN(length + 1);
+    return str;
+  }
+
+  if ((str = rapp_request_alloc(request, length + 1)) == NULL)
+    return NULL;
+
+  va_start(args, format);
+  vsnprintf(str, length + 1, format, args);
+  va_end(args);
+
+  return str;
+}
+
 /*
  * vim: expandtab shiftwidth=2 tabstop=2:
  */
@@ -20,12 +20,17 @@ void http_request_set_method(struct HTTPRequest *request, enum HTTPMethod method
 void http_request_set_url_range(struct HTTPRequest *request, size_t offset, size_t length);
 void http_request_set_url_field_range(struct HTTPRequest *request, enum HTTPURLField field, size_t offset, size_t length);
 
-int http_request_set_headers_buffer(struct HTTPRequest *request, const char *buffer, size_t length);
-void http_request_set_header_key_range(struct HTTPRequest *request, unsigned header_index, size_t offset, size_t length);
+void http_request_set_headers_buffer(struct HTTPRequest *request, const char *buffer);
+/* FNV-1a of the lowercase name: the first piece is hashed from HTTP_HEADER_HASH_INIT */
+#define HTTP_HEADER_HASH_INIT 2166136261u
+unsigned http_header_hash(unsigned hash, const char *name, size_t length);
+
+void http_request_set_header_key_range(struct HTTPRequest *request, unsigned header_index, size_t offset, size_t length, unsigned hash);
 void http_request_set_header_value_range(struct HTTPRequest *request, unsigned header_index, size_t offset, size_t length);
 
-int http_request_set_body_length(struct HTTPRequest *request, size_t length);
-void http_request_append_body_data(struct HTTPRequest *request, const char *data, size_t length);
+void http_request_set_body_range(struct HTTPRequest *request, size_t offset, size_t length);
+
+void http_request_set_params(struct HTTPRequest *request, char *const *names, const struct MemoryRange *ranges, unsigned n_params);
 
 void http_request_set_last(struct HTTPRequest *request, int last);
 int http_request_is_last(struct HTTPRequest *request);
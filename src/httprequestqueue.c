@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #include <assert.h>
 
 
@@ -14,82 +15,189 @@
 
 #include "memory.h"
 #include "logger.h"
+#include "metrics.h"
 #include "httprequest.h"
 #include "httprequestqueue.h"
 
-#define MAX_REQUESTS 100
+#define MAX_PENDING_REQUESTS 16
 
+#define BUFFER_SIZE (16 * 1024)
+#define MIN_READ_SPACE (4 * 1024)
+
+/*
+ * Data is read straight into the buffer and parsed in place: the requests
+ * point into it and get their ranges relative to their own start.
+ * The buffer is only compacted (or grown) when there's not enough room for
+ * the next read, keeping the requests not yet handed out; the ones already
+ * handed out are valid until the next read.
+ * The requests waiting to be handed out are kept in a ring, indexed by
+ * incoming_index and outgoing_index modulo its size.
+ * The bodies are buffered up to max_body_size, unless the request asks for
+ * its body to be streamed: then it's handed out as soon as its headers are
+ * complete, the body goes to the body callback as it's parsed, and it's
+ * dropped from the buffer on the next read. The headers of the request
+ * streamed are kept until the end of its body.
+ */
 struct HTTPRequestQueue {
   http_parser parser;
   http_parser_settings parser_settings;
   unsigned current_header;
+  enum HTTPRequestQueueState state;
+  int paused;
 
-  struct HTTPRequest *requests[MAX_REQUESTS];
+  struct HTTPRequest *requests[MAX_PENDING_REQUESTS];
   size_t incoming_index;
   size_t outgoing_index;
 
   char *buffer;
+  size_t buffer_size;
   size_t buffer_length;
+  size_t parsed_length;
+
+  /* the ranges of the message being parsed, relative to message_start */
+  size_t message_start;
+  struct MemoryRange url;
+  struct HeaderMemoryRange header;
+  unsigned header_hash;
+  int in_header_value;
+  struct MemoryRange body;
+
+  size_t max_body_size;
+  enum HTTPRequestQueueError error;
+
+  /* stream_request is set once handed out, stream_start is its body start */
+  int stream_starting;
+  struct HTTPRequest *stream_request;
+  size_t stream_start;
 
   HTTPRequestQueueNewRequestCallback new_request_callback;
   void *data;
 
+  HTTPRequestQueueStreamCallback stream_callback;
+  HTTPRequestQueueBodyCallback body_callback;
+  void *stream_data;
+
   struct Logger *logger;
 };
 
+static struct HTTPRequest **
+request_slot(struct HTTPRequestQueue *queue,
+             size_t                   index)
+{
+  return &(queue->requests[index % MAX_PENDING_REQUESTS]);
+}
+
+static size_t
+message_offset(struct HTTPRequestQueue *queue,
+               const char              *at)
+{
+  return at - &(queue->buffer[queue->message_start]);
+}
+
+/*
+ * the parser can split a token across reads: since the data is contiguous
+ * in the buffer the range is just extended.
+ */
+static void
+set_or_extend_range(struct MemoryRange *range,
+                    size_t              offset,
+                    size_t              length)
+{
+  if (range->length == 0)
+    range->offset = offset;
+
+  range->length = (offset + length) - range->offset;
+}
+
 static int
-on_message_begin(http_parser *parser)
+flush_header(struct HTTPRequestQueue *queue)
 {
-  struct HTTPRequestQueue *queue = (struct HTTPRequestQueue *)parser->data;
+  struct HTTPRequest *request = *request_slot(queue, queue->incoming_index);
 
-  if ((queue->requests[queue->incoming_index] = http_request_new(queue->logger)) == NULL)
+  if (queue->current_header >= HTTP_REQUEST_MAX_HEADERS)
     return -1;
 
+  http_request_set_header_key_range(request, queue->current_header, queue->header.key.offset, queue->header.key.length, queue->header_hash);
+  http_request_set_header_value_range(request, queue->current_header, queue->header.value.offset, queue->header.value.length);
+
+  queue->current_header++;
+  memset(&(queue->header), 0, sizeof(struct HeaderMemoryRange));
+  queue->in_header_value = 0;
+
   return 0;
 }
 
 static int
-on_url(http_parser *parser,
-       const char  *at,
-       size_t       length)
+set_url(struct HTTPRequestQueue *queue)
 {
-  struct HTTPRequestQueue *queue = NULL;
-  struct HTTPRequest *request = NULL;
-  struct http_parser_url url;
+  struct HTTPRequest *request = *request_slot(queue, queue->incoming_index);
+  const char *url = &(queue->buffer[queue->message_start + queue->url.offset]);
+  struct http_parser_url url_fields;
   int i = 0;
 
-  queue = (struct HTTPRequestQueue *)parser->data;
-  request = queue->requests[queue->incoming_index];
-
-  if (http_parser_parse_url(at, length, 0, &url) != 0)
+  if (http_parser_parse_url(url, queue->url.length, 0, &url_fields) != 0)
     return -1;
 
-  http_request_set_url_range(request, at - queue->buffer, length);
+  http_request_set_url_range(request, queue->url.offset, queue->url.length);
 
   while (i < HTTP_URL_FIELD_MAX) {
-    if (url.field_set & (1 << i))
-      http_request_set_url_field_range(request, i, (at - queue->buffer) + url.field_data[i].off, url.field_data[i].len);
+    if (url_fields.field_set & (1 << i))
+      http_request_set_url_field_range(request, i, queue->url.offset + url_fields.field_data[i].off, url_fields.field_data[i].len);
     i++;
   }
 
   return 0;
 }
 
+static int
+on_message_begin(http_parser *parser)
+{
+  struct HTTPRequestQueue *queue = (struct HTTPRequestQueue *)parser->data;
+
+  if (queue->incoming_index - queue->outgoing_index == MAX_PENDING_REQUESTS) {
+    logger_trace(queue->logger, LOG_ERROR, "httprequestqueue", "too many requests waiting to be served");
+    return -1;
+  }
+
+  if ((*request_slot(queue, queue->incoming_index) = http_request_new(queue->logger)) == NULL)
+    return -1;
+
+  queue->state = HTTP_REQUEST_QUEUE_HEADERS;
+
+  return 0;
+}
+
+static int
+on_url(http_parser *parser,
+       const char  *at,
+       size_t       length)
+{
+  struct HTTPRequestQueue *queue = (struct HTTPRequestQueue *)parser->data;
+
+  set_or_extend_range(&(queue->url), message_offset(queue, at), length);
+
+  return 0;
+}
+
 static int
 on_header_field(http_parser *parser,
                 const char  *at,
                 size_t       length)
 {
-  struct HTTPRequestQueue *queue = NULL;
-  struct HTTPRequest *request = NULL;
+  struct HTTPRequestQueue *queue = (struct HTTPRequestQueue *)parser->data;
 
-  queue = (struct HTTPRequestQueue *)parser->data;
-  request = queue->requests[queue->incoming_index];
+  if (queue->in_header_value && flush_header(queue) < 0)
+    return -1;
 
   if (queue->current_header >= HTTP_REQUEST_MAX_HEADERS)
     return -1;
 
-  http_request_set_header_key_range(request, queue->current_header, at - queue->buffer, length);
+  /* the name can come in pieces: the hash goes on from the previous one */
+  if (queue->header.key.length == 0)
+    queue->header_hash = HTTP_HEADER_HASH_INIT;
+  queue->header_hash = http_header_hash(queue->header_hash, at, length);
+
+  set_or_extend_range(&(queue->header.key), message_offset(queue, at), length);
 
   return 0;
 }
@@ -99,19 +207,34 @@ on_header_value(http_parser *parser,
                 const char  *at,
                 size_t       length)
 {
-  struct HTTPRequestQueue *queue = NULL;
-  struct HTTPRequest *request = NULL;
-
-  queue = (struct HTTPRequestQueue *)parser->data;
-  request = queue->requests[queue->incoming_index];
+  struct HTTPRequestQueue *queue = (struct HTTPRequestQueue *)parser->data;
 
-  http_request_set_header_value_range(request, queue->current_header, at - queue->buffer, length);
+  queue->in_header_value = 1;
 
-  queue->current_header++;
+  set_or_extend_range(&(queue->header.value), message_offset(queue, at), length);
 
   return 0;
 }
 
+static int
+has_body(http_parser *parser)
+{
+  return (parser->flags & F_CHUNKED) || (parser->content_length != ULLONG_MAX && parser->content_length > 0);
+}
+
+static int
+body_too_large(struct HTTPRequestQueue *queue,
+               unsigned long long       length)
+{
+  if (queue->max_body_size == 0 || length <= queue->max_body_size)
+    return 0;
+
+  logger_trace(queue->logger, LOG_ERROR, "httprequestqueue", "body larger than %zu bytes", queue->max_body_size);
+  queue->error = HTTP_REQUEST_QUEUE_ERROR_BODY_TOO_LARGE;
+
+  return 1;
+}
+
 static int
 on_headers_complete(http_parser *parser)
 {
@@ -119,29 +242,32 @@ on_headers_complete(http_parser *parser)
   struct HTTPRequest *request = NULL;
 
   queue = (struct HTTPRequestQueue *)parser->data;
-  request = queue->requests[queue->incoming_index];
+  request = *request_slot(queue, queue->incoming_index);
+
+  if (queue->in_header_value && flush_header(queue) < 0)
+    return -1;
+
+  if (set_url(queue) < 0)
+    return -1;
 
   http_request_set_method(request, parser->method);
   http_request_set_last(request, http_should_keep_alive(parser) == 0);
+  http_request_set_headers_buffer(request, &(queue->buffer[queue->message_start]));
 
-  if (http_request_set_headers_buffer(request, queue->buffer, parser->nread) < 0)
-    return -1;
+  queue->state = HTTP_REQUEST_QUEUE_BODY;
 
-  queue->buffer_length -= (parser->nread);
+  if (!has_body(parser))
+    return 0;
 
-  if (queue->buffer_length == 0) {
-    free(queue->buffer);
-    queue->buffer = NULL;
-  }
-  else {
-    memmove(queue->buffer, &(queue->buffer[parser->nread]), queue->buffer_length);
-    if ((queue->buffer = realloc(queue->buffer, queue->buffer_length)) == NULL) {
-      LOGGER_PERROR(queue->logger, "realloc");
-      return -1;
-    }
+  /* stop here: the request is handed out before its body */
+  if (queue->stream_callback != NULL && queue->stream_callback(queue, request, queue->stream_data)) {
+    queue->stream_starting = 1;
+    http_parser_pause(parser, 1);
+    return 0;
   }
 
-  if (((int64_t)parser->content_length) > 0 && http_request_set_body_length(request, parser->content_length) < 0)
+  /* no need to wait for the body to refuse it */
+  if (parser->content_length != ULLONG_MAX && body_too_large(queue, parser->content_length))
     return -1;
 
   return 0;
@@ -153,12 +279,29 @@ on_body(http_parser *parser,
         size_t       length)
 {
   struct HTTPRequestQueue *queue = NULL;
-  struct HTTPRequest *request = NULL;
+  char *body_end = NULL;
 
   queue = (struct HTTPRequestQueue *)parser->data;
-  request = queue->requests[queue->incoming_index];
 
-  http_request_append_body_data(request, at, length);
+  if (queue->stream_request != NULL) {
+    queue->body_callback(queue, at, length, queue->stream_data);
+    return 0;
+  }
+
+  if (body_too_large(queue, queue->body.length + length))
+    return -1;
+
+  if (queue->body.length == 0) {
+    queue->body.offset = message_offset(queue, at);
+  }
+  else {
+    /* chunks are moved back over the chunk headers to keep the body contiguous */
+    body_end = &(queue->buffer[queue->message_start + queue->body.offset + queue->body.length]);
+    if (at != body_end)
+      memmove(body_end, at, length);
+  }
+
+  queue->body.length += length;
 
   return 0;
 }
@@ -166,20 +309,78 @@ on_body(http_parser *parser,
 static int
 on_message_complete(http_parser *parser)
 {
-  struct HTTPRequestQueue *queue = NULL;
+  /* stop right after the message, so that its end is known */
+  http_parser_pause(parser, 1);
 
-  queue = (struct HTTPRequestQueue *)parser->data;
+  return 0;
+}
 
-  queue->incoming_index++;
+/* the next message starts where the parser stopped */
+static void
+reset_message(struct HTTPRequestQueue *queue)
+{
   queue->current_header = 0;
+  queue->state = HTTP_REQUEST_QUEUE_IDLE;
+
+  queue->message_start = queue->parsed_length;
+  memset(&(queue->url), 0, sizeof(struct MemoryRange));
+  memset(&(queue->body), 0, sizeof(struct MemoryRange));
+}
+
+static void
+complete_request(struct HTTPRequestQueue *queue)
+{
+  struct HTTPRequest *request = *request_slot(queue, queue->incoming_index);
+
+  http_request_set_headers_buffer(request, &(queue->buffer[queue->message_start]));
+  http_request_set_body_range(request, queue->body.offset, queue->body.length);
 
-  if (queue->incoming_index == MAX_REQUESTS)
-    http_request_set_last(queue->requests[queue->incoming_index - 1], 1);
+  queue->incoming_index++;
+  reset_message(queue);
+  metrics_count(METRICS_REQUESTS, 1);
 
   if (queue->new_request_callback != NULL)
     queue->new_request_callback(queue, queue->data);
+}
 
-  return 0;
+/* the request is handed out with its headers, and stays in the body state */
+static void
+start_stream(struct HTTPRequestQueue *queue)
+{
+  queue->stream_starting = 0;
+  queue->stream_request = *request_slot(queue, queue->incoming_index);
+  queue->stream_start = queue->parsed_length;
+
+  queue->incoming_index++;
+  metrics_count(METRICS_REQUESTS, 1);
+
+  if (queue->new_request_callback != NULL)
+    queue->new_request_callback(queue, queue->data);
+}
+
+/* an empty chunk tells the body is over */
+static void
+end_stream(struct HTTPRequestQueue *queue)
+{
+  queue->stream_request = NULL;
+  reset_message(queue);
+
+  queue->body_callback(queue, NULL, 0, queue->stream_data);
+}
+
+/* drops the body already streamed, the data not parsed yet takes its place */
+static void
+drop_streamed_body(struct HTTPRequestQueue *queue)
+{
+  if (queue->parsed_length == queue->stream_start)
+    return;
+
+  memmove(&(queue->buffer[queue->stream_start]),
+          &(queue->buffer[queue->parsed_length]),
+          queue->buffer_length - queue->parsed_length);
+
+  queue->buffer_length -= queue->parsed_length - queue->stream_start;
+  queue->parsed_length = queue->stream_start;
 }
 
 
@@ -190,8 +391,8 @@ http_request_queue_new(struct Logger *logger)
 
   assert(logger != NULL);
 
-  if ((queue = memory_create(sizeof(struct HTTPRequestQueue))) == NULL) {
-    LOGGER_PERROR(logger, "memory_create");
+  if ((queue = memory_pool_create(MEMORY_POOL_HTTP_REQUEST_QUEUE, sizeof(struct HTTPRequestQueue))) == NULL) {
+    LOGGER_PERROR(logger, "memory_pool_create");
     return NULL;
   }
 
@@ -206,6 +407,8 @@ http_request_queue_new(struct Logger *logger)
   queue->parser_settings.on_body = on_body;
   queue->parser_settings.on_message_complete = on_message_complete;
 
+  queue->max_body_size = HTTP_REQUEST_QUEUE_DEFAULT_MAX_BODY_SIZE;
+
   queue->logger = logger;
 
   return queue;
@@ -214,12 +417,21 @@ http_request_queue_new(struct Logger *logger)
 void
 http_request_queue_destroy(struct HTTPRequestQueue *queue)
 {
+  size_t i = 0;
+
   assert(queue != NULL);
 
+  /* the requests not handed out, and the one being received if any */
+  for (i = queue->outgoing_index; i < queue->incoming_index; i++)
+    http_request_destroy(*request_slot(queue, i));
+
+  if (queue->state != HTTP_REQUEST_QUEUE_IDLE && queue->stream_request == NULL)
+    http_request_destroy(*request_slot(queue, queue->incoming_index));
+
   if (queue->buffer != NULL)
     memory_destroy(queue->buffer);
 
-  memory_destroy(queue);
+  memory_pool_destroy(MEMORY_POOL_HTTP_REQUEST_QUEUE, queue);
 }
 
 void
@@ -234,38 +446,222 @@ http_request_queue_set_new_request_callback(struct HTTPRequestQueue           *q
   queue->data = data;
 }
 
+/*
+ * the stream callback is asked about the requests with a body, once their
+ * headers are complete: the request can't be used after the end of body.
+ */
+void
+http_request_queue_set_stream_callbacks(struct HTTPRequestQueue        *queue,
+                                        HTTPRequestQueueStreamCallback  stream_callback,
+                                        HTTPRequestQueueBodyCallback    body_callback,
+                                        void                           *data)
+{
+  assert(queue != NULL);
+  assert(stream_callback != NULL);
+  assert(body_callback != NULL);
+
+  queue->stream_callback = stream_callback;
+  queue->body_callback = body_callback;
+  queue->stream_data = data;
+}
+
+/* 0 means no limit: the bodies streamed have none anyway */
+void
+http_request_queue_set_max_body_size(struct HTTPRequestQueue *queue,
+                                     size_t                   max_body_size)
+{
+  assert(queue != NULL);
+
+  queue->max_body_size = max_body_size;
+}
+
+static void
+rebase_request(struct HTTPRequestQueue *queue,
+               struct HTTPRequest      *request,
+               const char              *old_buffer,
+               size_t                   shift)
+{
+  const char *headers_buffer = http_request_get_headers_buffer(request);
+
+  http_request_set_headers_buffer(request, &(queue->buffer[(headers_buffer - old_buffer) - shift]));
+}
+
+/*
+ * points the requests not yet handed out, and the one streamed, to the
+ * data moved by shift bytes
+ */
+static void
+rebase_requests(struct HTTPRequestQueue *queue,
+                const char              *old_buffer,
+                size_t                   shift)
+{
+  size_t i = 0;
+
+  for (i = queue->outgoing_index; i < queue->incoming_index; i++)
+    rebase_request(queue, *request_slot(queue, i), old_buffer, shift);
+
+  if (queue->stream_request != NULL)
+    rebase_request(queue, queue->stream_request, old_buffer, shift);
+}
+
+static int
+resize_buffer(struct HTTPRequestQueue *queue,
+              size_t                   size)
+{
+  char *buffer = NULL;
+
+  if ((buffer = memory_resize(queue->buffer, size)) == NULL) {
+    LOGGER_PERROR(queue->logger, "memory_resize");
+    return -1;
+  }
+
+  if (buffer != queue->buffer) {
+    char *old_buffer = queue->buffer;
+
+    queue->buffer = buffer;
+    rebase_requests(queue, old_buffer, 0);
+  }
+  queue->buffer_size = size;
+
+  return 0;
+}
+
+/*
+ * Returns the room at the end of the buffer, where the next data must be
+ * written before calling http_request_queue_commit_data.
+ */
+int
+http_request_queue_get_read_buffer(struct HTTPRequestQueue  *queue,
+                                   char                    **buffer,
+                                   size_t                   *length)
+{
+  size_t keep_from = 0;
+  size_t size = 0;
+
+  assert(queue != NULL);
+  assert(buffer != NULL);
+  assert(length != NULL);
+
+  if (queue->stream_request != NULL)
+    drop_streamed_body(queue);
+
+  keep_from = queue->message_start;
+  if (queue->outgoing_index < queue->incoming_index)
+    keep_from = http_request_get_headers_buffer(*request_slot(queue, queue->outgoing_index)) - queue->buffer;
+
+  if (keep_from == queue->buffer_length) {
+    /* nothing to keep: start over, without copying anything */
+    queue->buffer_length = 0;
+    queue->parsed_length = 0;
+    queue->message_start = 0;
+
+    if (queue->buffer_size > BUFFER_SIZE && resize_buffer(queue, BUFFER_SIZE) < 0)
+      return -1;
+  }
+  else if (queue->buffer_size - queue->buffer_length < MIN_READ_SPACE && keep_from > 0) {
+    memmove(queue->buffer, &(queue->buffer[keep_from]), queue->buffer_length - keep_from);
+    queue->buffer_length -= keep_from;
+    queue->parsed_length -= keep_from;
+    queue->message_start -= keep_from;
+    rebase_requests(queue, queue->buffer, keep_from);
+  }
+
+  if (queue->buffer_size - queue->buffer_length < MIN_READ_SPACE) {
+    size = queue->buffer_size > 0 ? queue->buffer_size : BUFFER_SIZE;
+    while (size - queue->buffer_length < MIN_READ_SPACE)
+      size *= 2;
+
+    if (resize_buffer(queue, size) < 0)
+      return -1;
+  }
+
+  *buffer = &(queue->buffer[queue->buffer_length]);
+  *length = queue->buffer_size - queue->buffer_length;
+
+  return 0;
+}
+
+/* parses the data received and not parsed yet, until the queue is paused */
+static int
+parse_data(struct HTTPRequestQueue *queue)
+{
+  size_t parsed = 0;
+  size_t to_parse = 0;
+
+  while (!queue->paused && queue->parsed_length < queue->buffer_length) {
+    to_parse = queue->buffer_length - queue->parsed_length;
+    parsed = http_parser_execute(&(queue->parser),
+                                 &(queue->parser_settings),
+                                 &(queue->buffer[queue->parsed_length]),
+                                 to_parse);
+    queue->parsed_length += parsed;
+
+    if (queue->parser.http_errno == HPE_PAUSED) {
+      http_parser_pause(&(queue->parser), 0);
+
+      if (queue->stream_starting)
+        start_stream(queue);
+      else if (queue->stream_request != NULL)
+        end_stream(queue);
+      else
+        complete_request(queue);
+      continue;
+    }
+
+    if (parsed != to_parse) {
+      if (queue->error == HTTP_REQUEST_QUEUE_ERROR_NONE)
+        queue->error = HTTP_REQUEST_QUEUE_ERROR_PARSE;
+      metrics_count(METRICS_PARSE_ERRORS, 1);
+
+      logger_trace(queue->logger, LOG_ERROR, "httprequestqueue", "parser error: %s: %s",
+                                                                 http_errno_name(queue->parser.http_errno),
+                                                                 http_errno_description(queue->parser.http_errno));
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/* parses length bytes written at the buffer returned by get_read_buffer */
+int
+http_request_queue_commit_data(struct HTTPRequestQueue *queue,
+                               size_t                   length)
+{
+  assert(queue != NULL);
+  assert(queue->buffer_length + length <= queue->buffer_size);
+
+  queue->buffer_length += length;
+  metrics_count(METRICS_BYTES_IN, length);
+
+  return parse_data(queue);
+}
+
 int
 http_request_queue_append_data(struct HTTPRequestQueue *queue,
                                void                    *data,
                                size_t                   length)
 {
-  size_t offset = 0;
+  char *buffer = NULL;
+  size_t buffer_length = 0;
+  size_t chunk_length = 0;
 
   assert(queue != NULL);
   assert(data != NULL);
   assert(length > 0);
 
-  ssize_t parsed = -1;
-
-  if ((queue->buffer = memory_resize(queue->buffer, queue->buffer_length + length)) == NULL) {
-    LOGGER_PERROR(queue->logger, "realloc");
-    return -1;
-  }
-  memcpy(&(queue->buffer[queue->buffer_length]), data, length);
+  while (length > 0) {
+    if (http_request_queue_get_read_buffer(queue, &buffer, &buffer_length) < 0)
+      return -1;
 
-  offset = queue->buffer_length;
-  queue->buffer_length += length;
+    chunk_length = length < buffer_length ? length : buffer_length;
+    memcpy(buffer, data, chunk_length);
 
-  parsed = http_parser_execute(&(queue->parser),
-                               &(queue->parser_settings),
-                               &(queue->buffer[offset]),
-                               length);
+    if (http_request_queue_commit_data(queue, chunk_length) < 0)
+      return -1;
 
-  if (parsed != length) {
-    logger_trace(queue->logger, LOG_ERROR, "httprequestqueue", "parser error: %s: %s",
-                                                               http_errno_name(queue->parser.http_errno),
-                                                               http_errno_description(queue->parser.http_errno));
-    return -1;
+    data = (char *)data + chunk_length;
+    length -= chunk_length;
   }
 
   return 0;
@@ -276,10 +672,52 @@ http_request_queue_get_next_request(struct HTTPRequestQueue *queue)
 {
   assert(queue != NULL);
 
-  return queue->requests[queue->outgoing_index++];
+  if (queue->outgoing_index == queue->incoming_index)
+    return NULL;
+
+  return *request_slot(queue, queue->outgoing_index++);
 }
 
 /*
- * vim: expandtab shiftwidth=2 tabstop=2:
+ * stops parsing after the current request: the data already received is
+ * kept, and parsed on resume.
  */
+void
+http_request_queue_pause(struct HTTPRequestQueue *queue)
+{
+  assert(queue != NULL);
+
+  queue->paused = 1;
+}
+
+int
+http_request_queue_resume(struct HTTPRequestQueue *queue)
+{
+  assert(queue != NULL);
+
+  queue->paused = 0;
 
+  return parse_data(queue);
+}
+
+/* tells which part of a request is being received, if any */
+enum HTTPRequestQueueState
+http_request_queue_get_state(struct HTTPRequestQueue *queue)
+{
+  assert(queue != NULL);
+
+  return queue->state;
+}
+
+/* tells why the data couldn't be parsed */
+enum HTTPRequestQueueError
+http_request_queue_get_error(struct HTTPRequestQueue *queue)
+{
+  assert(queue != NULL);
+
+  return queue->error;
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
@@ -8,21 +8,53 @@
 #ifndef HTTPREQUESTQUEUE_H
 #define HTTPREQUESTQUEUE_H
 
+#include <stddef.h>
+
+#define HTTP_REQUEST_QUEUE_DEFAULT_MAX_BODY_SIZE (1024 * 1024)
+
 struct Logger;
 struct HTTPRequest;
 struct HTTPRequestQueue;
 
+enum HTTPRequestQueueState {
+  HTTP_REQUEST_QUEUE_IDLE = 0,
+  HTTP_REQUEST_QUEUE_HEADERS,
+  HTTP_REQUEST_QUEUE_BODY,
+};
+
+enum HTTPRequestQueueError {
+  HTTP_REQUEST_QUEUE_ERROR_NONE = 0,
+  HTTP_REQUEST_QUEUE_ERROR_PARSE,
+  HTTP_REQUEST_QUEUE_ERROR_BODY_TOO_LARGE,
+};
+
 typedef void (*HTTPRequestQueueNewRequestCallback)(struct HTTPRequestQueue *queue, void *data);
 
+/* the stream callback returns 1 for the requests which want their body streamed */
+typedef int (*HTTPRequestQueueStreamCallback)(struct HTTPRequestQueue *queue, struct HTTPRequest *request, void *data);
+typedef void (*HTTPRequestQueueBodyCallback)(struct HTTPRequestQueue *queue, const char *chunk, size_t length, void *data);
+
 struct HTTPRequestQueue *http_request_queue_new(struct Logger *logger);
 void http_request_queue_destroy(struct HTTPRequestQueue *queue);
 
 void http_request_queue_set_new_request_callback(struct HTTPRequestQueue *queue, HTTPRequestQueueNewRequestCallback callback, void *data);
+void http_request_queue_set_stream_callbacks(struct HTTPRequestQueue *queue, HTTPRequestQueueStreamCallback stream_callback, HTTPRequestQueueBodyCallback body_callback, void *data);
+
+void http_request_queue_set_max_body_size(struct HTTPRequestQueue *queue, size_t max_body_size);
+
+int http_request_queue_get_read_buffer(struct HTTPRequestQueue *queue, char **buffer, size_t *length);
+int http_request_queue_commit_data(struct HTTPRequestQueue *queue, size_t length);
 
 int http_request_queue_append_data(struct HTTPRequestQueue *queue, void *data, size_t length);
 
 struct HTTPRequest *http_request_queue_get_next_request(struct HTTPRequestQueue *queue);
 
+void http_request_queue_pause(struct HTTPRequestQueue *queue);
+int http_request_queue_resume(struct HTTPRequestQueue *queue);
+
+enum HTTPRequestQueueState http_request_queue_get_state(struct HTTPRequestQueue *queue);
+enum HTTPRequestQueueError http_request_queue_get_error(struct HTTPRequestQueue *queue);
+
 #endif /* HTTPREQUESTQUEUE_H */
 
 /*
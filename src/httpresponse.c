@@ -10,97 +10,157 @@
 #include <string.h>
 #include <errno.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <assert.h>
 
+#include <sys/uio.h>
+
+#include "httpdate.h"
 #include "httpresponse.h"
 #include "logger.h"
 #include "memory.h"
 
-/* code + space + message + NULL */
-#define STATUSLINE_LEN 36
-
 /* HTTP/1.1 */
 #define PROTOCOL_LEN 8
 
-/* %a, %d %b %Y %H:%M:%S %z */
-#define DATETIME_LEN 32
+/* the error page with the longest status message, twice */
+#define ERROR_BODY_LEN 256
+
+/* the longest status line, Content-Type and Content-Length */
+#define ERROR_HEAD_LEN 128
+
+/* at least the number of statuses known */
+#define ERROR_PAGES 64
+
+/* the size of a chunk in hex + HTTP_EOL + NULL */
+#define CHUNK_SIZE_LEN 20
+
+#define MIN_SEGMENTS 8
+#define CHUNK_SIZE 4096
+
+/*
+ * the data to send, in order: the borrowed segments point to data owned by
+ * someone else, the owned ones to a chunk allocated by the response, which
+ * is filled by the following appends while there's room.
+ * The file segments are sent from file_fd, with iov_len bytes left.
+ * Sending advances iov_base (or file_offset), nothing is ever moved.
+ * The chunks of CHUNK_SIZE bytes come from a pool, the bigger ones don't.
+ */
+struct HTTPResponseSegment {
+  struct iovec iov;
+  char *chunk;
+  size_t chunk_size;
+  int file_fd;
+  off_t file_offset;
+};
+
+static void
+release_segment(struct HTTPResponseSegment *segment)
+{
+  if (segment->chunk != NULL) {
+    if (segment->chunk_size == CHUNK_SIZE)
+      memory_pool_destroy(MEMORY_POOL_HTTP_RESPONSE_CHUNK, segment->chunk);
+    else
+      memory_destroy(segment->chunk);
+    segment->chunk = NULL;
+  }
+
+  if (segment->file_fd >= 0) {
+    close(segment->file_fd);
+    segment->file_fd = -1;
+  }
+}
 
 struct HTTPResponse {
-  char *buffer;
-  size_t buffer_length;
+  struct HTTPResponseSegment *segments;
+  size_t segments_size;
+  size_t first_segment;
+  size_t last_segment;
 
   const char *server_name;
+  struct HTTPDate *date;
   int is_last;
+  unsigned status;
 
   struct Logger *logger;
 };
 
+/* the whole status line, and the message alone for the error pages */
 struct HTTPStatus {
-  unsigned code;
+  const char *line;
+  size_t length;
   const char *message;
 };
 
-/* http://www.iana.org/assignments/http-status-codes/http-status-codes.xhtml */
-static const struct HTTPStatus http_statuses[] = {
-  {100, "Continue"},
-  {101, "Switching Protocols"},
-  {102, "Processing"},
-  {200, "OK"},
-  {201, "Created"},
-  {202, "Accepted"},
-  {203, "Non-Authoritative Information"},
-  {204, "No Content"},
-  {205, "Reset Content"},
-  {206, "Partial Content"},
-  {207, "Multi-Status"},
-  {208, "Already Reported"},
-  {226, "IM Used"},
-  {300, "Multiple Choices"},
-  {301, "Moved Permanently"},
-  {302, "Found"},
-  {303, "See Other"},
-  {304, "Not Modified"},
-  {305, "Use Proxy"},
-  {306, "Reserved"},
-  {307, "Temporary Redirect"},
-  {308, "Permanent Redirect"},
-  {400, "Bad Request"},
-  {401, "Unauthorized"},
-  {402, "Payment Required"},
-  {403, "Forbidden"},
-  {404, "Not Found"},
-  {405, "Method Not Allowed"},
-  {406, "Not Acceptable"},
-  {407, "Proxy Authentication Required"},
-  {408, "Request Timeout"},
-  {409, "Conflict"},
-  {410, "Gone"},
-  {411, "Length Required"},
-  {412, "Precondition Failed"},
-  {413, "Request Entity Too Large"},
-  {414, "Request-URI Too Long"},
-  {415, "Unsupported Media Type"},
-  {416, "Requested Range Not Satisfiable"},
-  {417, "Expectation Failed"},
-  {422, "Unprocessable Entity"},
-  {423, "Locked"},
-  {424, "Failed Dependency"},
-  {426, "Upgrade Required"},
-  {428, "Precondition Required"},
-  {429, "Too Many Requests"},
-  {431, "Request Header Fields Too Large"},
-  {500, "Internal Server Error"},
-  {501, "Not Implemented"},
-  {502, "Bad Gateway"},
-  {503, "Service Unavailable"},
-  {504, "Gateway Timeout"},
-  {505, "HTTP Version Not Supported"},
-  {506, "Variant Also Negotiates"},
-  {507, "Insufficient Storage"},
-  {508, "Loop Detected"},
-  {510, "Not Extended"},
-  {511, "Network Authentication Required"},
-  {0, NULL}
+#define HTTP_STATUS(code, message) \
+  [code] = {"HTTP/1.1 " #code " " message HTTP_EOL, sizeof("HTTP/1.1 " #code " " message HTTP_EOL) - 1, message}
+
+/* the codes above the last one here are unknown */
+#define HTTP_STATUS_MAX 512
+
+/*
+ * indexed by code: http://www.iana.org/assignments/http-status-codes/http-status-codes.xhtml
+ */
+static const struct HTTPStatus http_statuses[HTTP_STATUS_MAX] = {
+  HTTP_STATUS(100, "Continue"),
+  HTTP_STATUS(101, "Switching Protocols"),
+  HTTP_STATUS(102, "Processing"),
+  HTTP_STATUS(200, "OK"),
+  HTTP_STATUS(201, "Created"),
+  HTTP_STATUS(202, "Accepted"),
+  HTTP_STATUS(203, "Non-Authoritative Information"),
+  HTTP_STATUS(204, "No Content"),
+  HTTP_STATUS(205, "Reset Content"),
+  HTTP_STATUS(206, "Partial Content"),
+  HTTP_STATUS(207, "Multi-Status"),
+  HTTP_STATUS(208, "Already Reported"),
+  HTTP_STATUS(226, "IM Used"),
+  HTTP_STATUS(300, "Multiple Choices"),
+  HTTP_STATUS(301, "Moved Permanently"),
+  HTTP_STATUS(302, "Found"),
+  HTTP_STATUS(303, "See Other"),
+  HTTP_STATUS(304, "Not Modified"),
+  HTTP_STATUS(305, "Use Proxy"),
+  HTTP_STATUS(306, "Reserved"),
+  HTTP_STATUS(307, "Temporary Redirect"),
+  HTTP_STATUS(308, "Permanent Redirect"),
+  HTTP_STATUS(400, "Bad Request"),
+  HTTP_STATUS(401, "Unauthorized"),
+  HTTP_STATUS(402, "Payment Required"),
+  HTTP_STATUS(403, "Forbidden"),
+  HTTP_STATUS(404, "Not Found"),
+  HTTP_STATUS(405, "Method Not Allowed"),
+  HTTP_STATUS(406, "Not Acceptable"),
+  HTTP_STATUS(407, "Proxy Authentication Required"),
+  HTTP_STATUS(408, "Request Timeout"),
+  HTTP_STATUS(409, "Conflict"),
+  HTTP_STATUS(410, "Gone"),
+  HTTP_STATUS(411, "Length Required"),
+  HTTP_STATUS(412, "Precondition Failed"),
+  HTTP_STATUS(413, "Request Entity Too Large"),
+  HTTP_STATUS(414, "Request-URI Too Long"),
+  HTTP_STATUS(415, "Unsupported Media Type"),
+  HTTP_STATUS(416, "Requested Range Not Satisfiable"),
+  HTTP_STATUS(417, "Expectation Failed"),
+  HTTP_STATUS(422, "Unprocessable Entity"),
+  HTTP_STATUS(423, "Locked"),
+  HTTP_STATUS(424, "Failed Dependency"),
+  HTTP_STATUS(426, "Upgrade Required"),
+  HTTP_STATUS(428, "Precondition Required"),
+  HTTP_STATUS(429, "Too Many Requests"),
+  HTTP_STATUS(431, "Request Header Fields Too Large"),
+  HTTP_STATUS(500, "Internal Server Error"),
+  HTTP_STATUS(501, "Not Implemented"),
+  HTTP_STATUS(502, "Bad Gateway"),
+  HTTP_STATUS(503, "Service Unavailable"),
+  HTTP_STATUS(504, "Gateway Timeout"),
+  HTTP_STATUS(505, "HTTP Version Not Supported"),
+  HTTP_STATUS(506, "Variant Also Negotiates"),
+  HTTP_STATUS(507, "Insufficient Storage"),
+  HTTP_STATUS(508, "Loop Detected"),
+  HTTP_STATUS(510, "Not Extended"),
+  HTTP_STATUS(511, "Network Authentication Required"),
 };
 
 static const char *error_body = \
@@ -114,6 +174,59 @@ static const char *error_body = \
   "</body>"             \
 "</html>";
 
+/*
+ * The error pages are all the same but for the Server and Date headers:
+ * the rest is formatted once for every status, the first time it's needed
+ * by any thread, and borrowed by the responses. It never changes nor goes
+ * away, so it's shared without any counting.
+ */
+struct HTTPErrorPage {
+  const char *head;
+  size_t head_length;
+  const char *body;
+  size_t body_length;
+};
+
+static struct HTTPErrorPage error_pages[HTTP_STATUS_MAX];
+static char error_pages_data[ERROR_PAGES][ERROR_HEAD_LEN + ERROR_BODY_LEN];
+static pthread_once_t error_pages_once = PTHREAD_ONCE_INIT;
+
+static void
+build_error_pages(void)
+{
+  const struct HTTPStatus *status = NULL;
+  unsigned code = 0;
+  unsigned n = 0;
+  char *head = NULL;
+  char *body = NULL;
+  int head_length = 0;
+  int body_length = 0;
+
+  for (code = 0; code < HTTP_STATUS_MAX; code++) {
+    status = &(http_statuses[code]);
+    if (status->line == NULL)
+      continue;
+
+    assert(n < ERROR_PAGES);
+    head = error_pages_data[n];
+    body = &(error_pages_data[n][ERROR_HEAD_LEN]);
+    n++;
+
+    body_length = snprintf(body, ERROR_BODY_LEN, error_body, status->message, status->message);
+    assert(body_length > 0 && body_length < ERROR_BODY_LEN);
+
+    head_length = snprintf(head, ERROR_HEAD_LEN, "%s"
+                                                 "Content-Type: text/html" HTTP_EOL
+                                                 "Content-Length: %d" HTTP_EOL, status->line, body_length);
+    assert(head_length > 0 && head_length < ERROR_HEAD_LEN);
+
+    error_pages[code].head = head;
+    error_pages[code].head_length = head_length;
+    error_pages[code].body = body;
+    error_pages[code].body_length = body_length;
+  }
+}
+
 
 struct HTTPResponse*
 http_response_new(struct Logger *logger, const char *server_name)
@@ -123,8 +236,8 @@ http_response_new(struct Logger *logger, const char *server_name)
   assert(logger != NULL);
   assert(server_name != NULL);
 
-  if ((response = memory_create(sizeof(struct HTTPResponse))) == NULL) {
-    LOGGER_PERROR(logger, "memory_create");
+  if ((response = memory_pool_create(MEMORY_POOL_HTTP_RESPONSE, sizeof(struct HTTPResponse))) == NULL) {
+    LOGGER_PERROR(logger, "memory_pool_create");
     return NULL;
   }
 
@@ -137,51 +250,136 @@ http_response_new(struct Logger *logger, const char *server_name)
 void
 http_response_destroy(struct HTTPResponse *response)
 {
+  size_t i = 0;
+
   assert(response != NULL);
 
-  if (response->buffer != NULL && response->buffer_length != 0)
-    memory_destroy(response->buffer);
+  for (i = response->first_segment; i < response->last_segment; i++)
+    release_segment(&(response->segments[i]));
 
-  memory_destroy(response);
+  if (response->segments != NULL)
+    memory_destroy(response->segments);
+
+  memory_pool_destroy(MEMORY_POOL_HTTP_RESPONSE, response);
 }
 
-static const char *
-status_message_by_code(unsigned code)
+static struct HTTPResponseSegment *
+add_segment(struct HTTPResponse *response)
 {
-  const struct HTTPStatus *sp = NULL;
+  struct HTTPResponseSegment *segments = NULL;
+  size_t pending = response->last_segment - response->first_segment;
+  size_t size = 0;
+
+  if (response->last_segment == response->segments_size && response->first_segment > 0) {
+    memmove(response->segments, &(response->segments[response->first_segment]), pending * sizeof(struct HTTPResponseSegment));
+    response->first_segment = 0;
+    response->last_segment = pending;
+  }
+
+  if (response->last_segment == response->segments_size) {
+    size = response->segments_size > 0 ? response->segments_size * 2 : MIN_SEGMENTS;
 
-  for (sp = http_statuses; sp->code != 0; sp++) {
-    if (sp->code == code)
-      return sp->message;
+    if ((segments = memory_resize(response->segments, size * sizeof(struct HTTPResponseSegment))) == NULL) {
+      LOGGER_PERROR(response->logger, "memory_resize");
+      return NULL;
+    }
+
+    response->segments = segments;
+    response->segments_size = size;
   }
 
-  return NULL;
+  response->segments[response->last_segment].file_fd = -1;
+
+  return &(response->segments[response->last_segment++]);
+}
+
+/*
+ * returns where to write length bytes, at the end of the last chunk if there's
+ * room or in a new one: they are sent with the rest of the data.
+ */
+static char *
+reserve_data(struct HTTPResponse *response,
+             size_t               length)
+{
+  struct HTTPResponseSegment *segment = NULL;
+  char *end = NULL;
+  size_t chunk_size = 0;
+
+  if (response->last_segment > response->first_segment) {
+    segment = &(response->segments[response->last_segment - 1]);
+    end = (char *)segment->iov.iov_base + segment->iov.iov_len;
+
+    if (segment->chunk != NULL && end + length <= segment->chunk + segment->chunk_size) {
+      segment->iov.iov_len += length;
+      return end;
+    }
+  }
+
+  chunk_size = length > CHUNK_SIZE ? length : CHUNK_SIZE;
+
+  if ((segment = add_segment(response)) == NULL)
+    return NULL;
+
+  if (chunk_size == CHUNK_SIZE)
+    segment->chunk = memory_pool_create(MEMORY_POOL_HTTP_RESPONSE_CHUNK, chunk_size);
+  else
+    segment->chunk = memory_create(chunk_size);
+
+  if (segment->chunk == NULL) {
+    LOGGER_PERROR(response->logger, "memory_create");
+    response->last_segment--;
+    return NULL;
+  }
+
+  segment->chunk_size = chunk_size;
+  segment->iov.iov_base = segment->chunk;
+  segment->iov.iov_len = length;
+
+  return segment->chunk;
+}
+
+static const struct HTTPStatus *
+status_by_code(unsigned code)
+{
+  if (code >= HTTP_STATUS_MAX || http_statuses[code].line == NULL)
+    return NULL;
+
+  return &(http_statuses[code]);
 }
 
 ssize_t http_response_write_status_line_by_code(struct HTTPResponse *response,
                                                 unsigned             code)
 {
-  const char *message = NULL;
-  char *status_line = alloca(STATUSLINE_LEN);
+  const struct HTTPStatus *status = NULL;
 
-  if ((message = status_message_by_code(code)) == NULL)
+  assert(response != NULL);
+
+  if ((status = status_by_code(code)) == NULL)
     return -1;
 
-  snprintf(status_line, STATUSLINE_LEN, "%d %s", code, message);
+  response->status = code;
 
-  return http_response_write_status_line(response, status_line);
+  return http_response_append_data(response, status->line, status->length);
 }
 
 ssize_t http_response_write_status_line(struct HTTPResponse *response,
                                         const char          *status_line)
 {
-  /* HTTP/1.1 + space + status_line + HTTP_EOL + NULL */
-  size_t status_len = PROTOCOL_LEN + 1 + strlen(status_line) + strlen(HTTP_EOL) + 1;
-  char *status = alloca(status_len);
+  size_t status_line_len = strlen(status_line);
+  /* HTTP/1.1 + space + status_line + HTTP_EOL */
+  size_t status_len = PROTOCOL_LEN + 1 + status_line_len + strlen(HTTP_EOL);
+  char *status = NULL;
+
+  if ((status = reserve_data(response, status_len)) == NULL)
+    return -1;
 
-  snprintf(status, status_len, "HTTP/1.1 %s" HTTP_EOL, status_line);
+  memcpy(status, "HTTP/1.1 ", PROTOCOL_LEN + 1);
+  memcpy(&(status[PROTOCOL_LEN + 1]), status_line, status_line_len);
+  memcpy(&(status[PROTOCOL_LEN + 1 + status_line_len]), HTTP_EOL, strlen(HTTP_EOL));
 
-  return http_response_append_data(response, status, status_len - 1);
+  response->status = strtoul(status_line, NULL, 10);
+
+  return status_len;
 }
 
 ssize_t
@@ -189,26 +387,38 @@ http_response_write_header(struct HTTPResponse *response,
                            const char           *key,
                            const char           *value)
 {
+  size_t key_len = 0;
+  size_t value_len = 0;
+  size_t header_len = 0;
   char *header = NULL;
-  ssize_t ret = 0;
 
   assert(response != NULL);
   assert(key != NULL);
   assert(value != NULL);
 
-  if (memory_asprintf(&header, "%s: %s" HTTP_EOL, key, value) < 0)
+  key_len = strlen(key);
+  value_len = strlen(value);
+  /* key + colon + space + value + HTTP_EOL */
+  header_len = key_len + 2 + value_len + strlen(HTTP_EOL);
+
+  if ((header = reserve_data(response, header_len)) == NULL)
     return -1;
 
-  ret = http_response_append_data(response, header, strlen(header));
-  memory_destroy(header);
+  memcpy(header, key, key_len);
+  memcpy(&(header[key_len]), ": ", 2);
+  memcpy(&(header[key_len + 2]), value, value_len);
+  memcpy(&(header[key_len + 2 + value_len]), HTTP_EOL, strlen(HTTP_EOL));
 
-  return ret;
+  return header_len;
 }
 
+/* without the date of the loop, the Date header is formatted right here */
 ssize_t
 http_response_end_headers(struct HTTPResponse *response)
 {
-  char *datetime = alloca(DATETIME_LEN);
+  char datetime[HTTP_DATE_HEADER_SIZE];
+  const char *date_header = datetime;
+  size_t date_length = 0;
   time_t now = 0;
   ssize_t total_length = 0;
   ssize_t ret = 0;
@@ -219,17 +429,22 @@ http_response_end_headers(struct HTTPResponse *response)
     return -1;
   total_length += ret;
 
-  if (time(&now) < 0) {
-    logger_trace(response->logger, LOG_ERROR, "httpresponse", "time: %s", strerror(errno));
-    return -1;
+  if (response->date != NULL) {
+    date_header = http_date_get_header(response->date, &date_length);
   }
+  else {
+    if (time(&now) < 0) {
+      logger_trace(response->logger, LOG_ERROR, "httpresponse", "time: %s", strerror(errno));
+      return -1;
+    }
 
-  if (strftime(datetime, DATETIME_LEN, "%a, %d %b %Y %H:%M:%S %z", gmtime(&now)) == 0) {
-    logger_trace(response->logger, LOG_ERROR, "httpresponse", "strftime: error formatting datetime");
-    return -1;
+    if ((date_length = http_date_format_header(datetime, now)) == 0) {
+      logger_trace(response->logger, LOG_ERROR, "httpresponse", "strftime: error formatting datetime");
+      return -1;
+    }
   }
 
-  if ((ret = http_response_write_header(response, "Date", datetime)) < 0)
+  if ((ret = http_response_append_data(response, date_header, date_length)) < 0)
     return -1;
   total_length += ret;
 
@@ -251,52 +466,260 @@ http_response_append_data(struct HTTPResponse *response,
                           const void          *data,
                           size_t               length)
 {
+  char *dest = NULL;
+
   assert(response != NULL);
   assert(data != NULL);
   assert(length > 0);
 
-  if ((response->buffer = memory_resize(response->buffer, response->buffer_length + length)) == NULL) {
-    LOGGER_PERROR(response->logger, "memory_resize");
+  if ((dest = reserve_data(response, length)) == NULL)
     return -1;
-  }
 
-  memcpy(&(response->buffer[response->buffer_length]), data, length);
+  memcpy(dest, data, length);
 
-  response->buffer_length += length;
+  return length;
+}
+
+/* the data is not copied: it must stay valid until the response is sent */
+ssize_t
+http_response_append_borrowed_data(struct HTTPResponse *response,
+                                   const void          *data,
+                                   size_t               length)
+{
+  struct HTTPResponseSegment *segment = NULL;
+
+  assert(response != NULL);
+  assert(data != NULL);
+  assert(length > 0);
+
+  if ((segment = add_segment(response)) == NULL)
+    return -1;
+
+  segment->chunk = NULL;
+  segment->chunk_size = 0;
+  segment->iov.iov_base = (void *)data;
+  segment->iov.iov_len = length;
 
   return length;
 }
 
+/*
+ * the body follows in chunks, so it can be sent while it's produced: the
+ * headers are ended here, after telling the client.
+ */
 ssize_t
-http_response_read_data(struct HTTPResponse *response,
-                        void                *data,
+http_response_begin_chunked(struct HTTPResponse *response)
+{
+  ssize_t total_length = 0;
+  ssize_t ret = 0;
+
+  assert(response != NULL);
+
+  if ((ret = http_response_write_header(response, "Transfer-Encoding", "chunked")) < 0)
+    return -1;
+  total_length += ret;
+
+  if ((ret = http_response_end_headers(response)) < 0)
+    return -1;
+  total_length += ret;
+
+  return total_length;
+}
+
+/* an empty chunk ends the body: nothing can be written after it */
+ssize_t
+http_response_write_chunk(struct HTTPResponse *response,
+                          const void          *data,
+                          size_t               length)
+{
+  char size[CHUNK_SIZE_LEN];
+  int size_len = 0;
+  size_t chunk_len = 0;
+  char *chunk = NULL;
+
+  assert(response != NULL);
+  assert(data != NULL || length == 0);
+
+  size_len = snprintf(size, sizeof(size), "%zx" HTTP_EOL, length);
+  /* size line + data + HTTP_EOL, and the empty trailer after the last one */
+  chunk_len = size_len + length + strlen(HTTP_EOL);
+
+  if ((chunk = reserve_data(response, chunk_len)) == NULL)
+    return -1;
+
+  memcpy(chunk, size, size_len);
+  if (length > 0)
+    memcpy(&(chunk[size_len]), data, length);
+  memcpy(&(chunk[size_len + length]), HTTP_EOL, strlen(HTTP_EOL));
+
+  return chunk_len;
+}
+
+/*
+ * length bytes of the file from offset are sent with sendfile, without
+ * passing through user space: on success the response takes ownership of
+ * fd and closes it once sent.
+ */
+ssize_t
+http_response_send_file(struct HTTPResponse *response,
+                        int                  fd,
+                        off_t                offset,
                         size_t               length)
 {
-  ssize_t avaiable_length = 0;
+  struct HTTPResponseSegment *segment = NULL;
 
   assert(response != NULL);
-  assert(data != NULL);
+  assert(fd >= 0);
   assert(length > 0);
 
-  avaiable_length = response->buffer_length < length ? response->buffer_length : length;
+  if ((segment = add_segment(response)) == NULL)
+    return -1;
 
-  memcpy(data, response->buffer, avaiable_length);
+  segment->chunk = NULL;
+  segment->chunk_size = 0;
+  segment->iov.iov_base = NULL;
+  segment->iov.iov_len = length;
+  segment->file_fd = fd;
+  segment->file_offset = offset;
 
-  response->buffer_length -= avaiable_length;
+  return length;
+}
 
-  if (response->buffer_length == 0) {
-    memory_destroy(response->buffer);
-    response->buffer = NULL;
+/*
+ * fills iov with the pending data up to the first file, returns the number
+ * of entries used.
+ */
+int
+http_response_get_iovec(struct HTTPResponse *response,
+                        struct iovec        *iov,
+                        int                  iovcnt)
+{
+  size_t i = 0;
+  int n = 0;
+
+  assert(response != NULL);
+  assert(iov != NULL);
+
+  for (i = response->first_segment; i < response->last_segment && n < iovcnt; i++) {
+    if (response->segments[i].file_fd >= 0)
+      break;
+
+    if (response->segments[i].iov.iov_len > 0)
+      iov[n++] = response->segments[i].iov;
   }
-  else {
-    memmove(response->buffer, &(response->buffer[avaiable_length]), response->buffer_length);
-    if ((response->buffer = memory_resize(response->buffer, response->buffer_length)) == NULL) {
-      LOGGER_PERROR(response->logger, "memory_resize");
-      return -1;
+
+  return n;
+}
+
+/* returns 0 if the pending data starts with a file, -1 otherwise */
+int
+http_response_get_file(struct HTTPResponse *response,
+                       int                 *fd,
+                       off_t               *offset,
+                       size_t              *length)
+{
+  struct HTTPResponseSegment *segment = NULL;
+  size_t i = 0;
+
+  assert(response != NULL);
+  assert(fd != NULL);
+  assert(offset != NULL);
+  assert(length != NULL);
+
+  for (i = response->first_segment; i < response->last_segment; i++) {
+    segment = &(response->segments[i]);
+
+    if (segment->file_fd >= 0) {
+      *fd = segment->file_fd;
+      *offset = segment->file_offset;
+      *length = segment->iov.iov_len;
+      return 0;
+    }
+
+    if (segment->iov.iov_len > 0)
+      break;
+  }
+
+  return -1;
+}
+
+/* drops length bytes of data from the front, after they have been sent */
+void
+http_response_consume_data(struct HTTPResponse *response,
+                           size_t               length)
+{
+  struct HTTPResponseSegment *segment = NULL;
+  size_t consumed = 0;
+
+  assert(response != NULL);
+
+  while (response->first_segment < response->last_segment) {
+    segment = &(response->segments[response->first_segment]);
+
+    consumed = length < segment->iov.iov_len ? length : segment->iov.iov_len;
+    if (segment->file_fd >= 0)
+      segment->file_offset += consumed;
+    else
+      segment->iov.iov_base = (char *)segment->iov.iov_base + consumed;
+    segment->iov.iov_len -= consumed;
+    length -= consumed;
+
+    if (segment->iov.iov_len > 0)
+      break;
+
+    if (segment->file_fd >= 0) {
+      close(segment->file_fd);
+      segment->file_fd = -1;
     }
+
+    /* the last chunk is kept, and reused from the start, for the next data */
+    if (response->first_segment == response->last_segment - 1) {
+      if (segment->chunk != NULL)
+        segment->iov.iov_base = segment->chunk;
+      break;
+    }
+
+    release_segment(segment);
+    response->first_segment++;
   }
+}
+
+ssize_t
+http_response_read_data(struct HTTPResponse *response,
+                        void                *data,
+                        size_t               length)
+{
+  struct iovec iov[MIN_SEGMENTS];
+  int iovcnt = 0;
+  int i = 0;
+  size_t copied = 0;
+  size_t chunk_length = 0;
+
+  assert(response != NULL);
+  assert(data != NULL);
+  assert(length > 0);
 
-  return avaiable_length;
+  iovcnt = http_response_get_iovec(response, iov, MIN_SEGMENTS);
+
+  for (i = 0; i < iovcnt && copied < length; i++) {
+    chunk_length = iov[i].iov_len < length - copied ? iov[i].iov_len : length - copied;
+    memcpy((char *)data + copied, iov[i].iov_base, chunk_length);
+    copied += chunk_length;
+  }
+
+  http_response_consume_data(response, copied);
+
+  return copied;
+}
+
+/* the date is shared by the responses of a loop, and must outlive them */
+void
+http_response_set_date(struct HTTPResponse *response,
+                       struct HTTPDate     *date)
+{
+  assert(response != NULL);
+
+  response->date = date;
 }
 
 void
@@ -316,68 +739,56 @@ http_response_is_last(struct HTTPResponse *response)
   return response->is_last;
 }
 
+/* the code of the status line written, 0 if none */
+unsigned
+http_response_get_status(struct HTTPResponse *response)
+{
+  assert(response != NULL);
+
+  return response->status;
+}
+
+/* for the next request, once everything has been sent */
+void
+http_response_reset(struct HTTPResponse *response)
+{
+  assert(response != NULL);
+
+  response->is_last = 0;
+  response->status = 0;
+}
+
+/* only the Server and Date headers are written, the rest is borrowed */
 ssize_t
 http_response_write_error_by_code(struct HTTPResponse *response,
                                   unsigned             code)
 {
-  const char *message = NULL;
-  char *body = NULL;
-  char *len_s = NULL;
+  const struct HTTPErrorPage *page = NULL;
   ssize_t total_length = 0;
   ssize_t ret;
 
   assert(response != NULL);
 
-  if ((message = status_message_by_code(code)) == NULL)
-    return -1;
-
-  if (memory_asprintf(&body, error_body, message, message) < 0) {
-    LOGGER_PERROR(response->logger, "memory_asprintf: body");
-    return -1;
-  }
-
-  if (memory_asprintf(&len_s, "%lu", strlen(body)) < 0) {
-    LOGGER_PERROR(response->logger, "memory_asprintf: len_s");
-    memory_destroy(body);
+  if (status_by_code(code) == NULL)
     return -1;
-  }
 
-  if ((ret = http_response_write_status_line_by_code(response, code)) < 0) {
-    memory_destroy(body);
-    memory_destroy(len_s);
-    return -1;
-  }
-  total_length += ret;
+  pthread_once(&error_pages_once, build_error_pages);
+  page = &(error_pages[code]);
+  /* the status line is in the borrowed head */
+  response->status = code;
 
-  if ((ret = http_response_write_header(response, "Content-Type", "text/html")) < 0) {
-    memory_destroy(body);
-    memory_destroy(len_s);
+  if ((ret = http_response_append_borrowed_data(response, page->head, page->head_length)) < 0)
     return -1;
-  }
   total_length += ret;
 
-  if ((ret = http_response_write_header(response, "Content-Length", len_s)) < 0) {
-    memory_destroy(body);
-    memory_destroy(len_s);
+  if ((ret = http_response_end_headers(response)) < 0)
     return -1;
-  }
-  memory_destroy(len_s);
   total_length += ret;
 
-  if ((ret = http_response_end_headers(response)) < 0) {
-    memory_destroy(body);
+  if ((ret = http_response_append_borrowed_data(response, page->body, page->body_length)) < 0)
     return -1;
-  }
-  total_length += ret;
-
-  if ((ret = http_response_append_data(response, body, strlen(body))) < 0) {
-    memory_destroy(body);
-    return -1;
-  }
   total_length += ret;
 
-  memory_destroy(body);
-
   return total_length;
 }
 
@@ -12,13 +12,24 @@
 
 struct Logger;
 struct TcpConnection;
+struct iovec;
+struct HTTPDate;
 
 struct HTTPResponse* http_response_new(struct Logger *logger, const char *server_name);
 void http_response_destroy(struct HTTPResponse *response);
 
+void http_response_set_date(struct HTTPResponse *response, struct HTTPDate *date);
+
 void http_response_set_last(struct HTTPResponse *response, int last);
 int http_response_is_last(struct HTTPResponse *response);
 
+unsigned http_response_get_status(struct HTTPResponse *response);
+void http_response_reset(struct HTTPResponse *response);
+
+int http_response_get_iovec(struct HTTPResponse *response, struct iovec *iov, int iovcnt);
+int http_response_get_file(struct HTTPResponse *response, int *fd, off_t *offset, size_t *length);
+void http_response_consume_data(struct HTTPResponse *response, size_t length);
+
 ssize_t http_response_read_data(struct HTTPResponse *response, void *data, size_t length);
 
 #endif /* HTTTPRESPONSE_H */
@@ -6,40 +6,93 @@
  */
 
 #include <assert.h>
-#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 
 #include "container.h"
+#include "httprequest.h"
 #include "httprouter.h"
 #include "memory.h"
+#include "metrics.h"
 
-#define ROUTE_BASE_LEN 14
-#define ROUTE_GROUP_LEN 30
 #define ROUTE_MAX_LEN 1023
 
-struct RouteBinding {
-  char *route;
-  struct Container *container;
-  char name[ROUTE_BASE_LEN];
-  int16_t route_len; /* FIXME */
+/*
+ * The routes are kept in a radix tree: every node holds a piece of route,
+ * which its children continue each with a different first character, and
+ * the pieces from the root to a node with a container make a bound route.
+ * The routes matching an URL, i.e. its prefixes, are the nodes with a
+ * container on the path walked by the URL: a lookup reads the URL once.
+ * A route can be bound more than once: the first binding is kept for
+ * ROUTE_MATCH_FIRST, the last one for ROUTE_MATCH_LONGEST, as scanning all
+ * the bindings in order would do.
+ */
+struct RouteNode {
+  char *label;
+  size_t label_len;
+
+  struct RouteNode **children;
+  size_t children_num;
+
+  struct Container *first_container;
+  unsigned first_binding;
+  struct Container *last_container;
 };
 
 /*
- * keep sizeof() <= 1024
- * when tune constants, remember to optimize
- * for a cacheline of 64 bytes
+ * The pattern routes match the whole path, segment by segment: a segment
+ * of the pattern is either static, a :param matching any non empty
+ * segment, or a *wildcard matching the rest of the path. They are kept in
+ * a tree of segments, where the static children are tried first, then the
+ * param and then the wildcard one, and every node lists the bindings of
+ * its pattern. Among the bindings matching the method and the Host header,
+ * the most specific one is taken, the first bound on a tie.
  */
-struct RoutePack {
-  struct RouteBinding bindings[ROUTE_GROUP_LEN];
-  struct RoutePack *next;
-  int32_t binding_num;
+struct PatternBinding {
+  enum HTTPMethod method;
+  char *host;
+  size_t host_len;
+  struct Container *container;
+  char *params_names[HTTP_REQUEST_MAX_PARAMS];
+  unsigned params_num;
+  struct PatternBinding *next;
+};
+
+struct PatternNode {
+  char *segment;
+  size_t segment_len;
+
+  struct PatternNode **children;
+  size_t children_num;
+  struct PatternNode *param;
+  struct PatternNode *wildcard;
+
+  struct PatternBinding *bindings;
+};
+
+/* the state of a lookup, the host is looked up only if needed */
+struct PatternMatch {
+  struct HTTPRequest *request;
+  const char *path;
+  size_t path_len;
+  size_t path_offset;
+  enum HTTPMethod method;
+
+  int host_looked_up;
+  const char *host;
+  size_t host_len;
+
+  struct MemoryRange params[HTTP_REQUEST_MAX_PARAMS];
+  unsigned params_num;
 };
 
 struct HTTPRouter {
-  struct RoutePack pack;
-  struct RoutePack *last;
+  struct RouteNode root;
+  unsigned bindings_num;
+  struct PatternNode patterns;
+  unsigned patterns_num;
   struct Logger *logger;
   struct Container *null;
   struct Container *starter; /* because `default` is a keyword. */
@@ -61,75 +114,589 @@ http_router_new(struct Logger      *logger,
   }
 
   if ((router = memory_create(sizeof(struct HTTPRouter))) == NULL) {
-    LOGGER_PERROR(router->logger, "memory_create");
+    LOGGER_PERROR(logger, "memory_create");
     container_destroy(null);
     return NULL;
   }
 
   router->logger = logger;
   router->null = null;
-  router->last = &router->pack;
   router->match_mode = match_mode;
 
   return router;
 }
 
+static struct RouteNode *
+route_node_new(struct Logger *logger,
+               const char    *label,
+               size_t         label_len)
+{
+  struct RouteNode *node = NULL;
+
+  if ((node = memory_create(sizeof(struct RouteNode))) == NULL) {
+    LOGGER_PERROR(logger, "memory_create");
+    return NULL;
+  }
+
+  if ((node->label = memory_create(label_len)) == NULL) {
+    LOGGER_PERROR(logger, "memory_create");
+    memory_destroy(node);
+    return NULL;
+  }
+
+  memcpy(node->label, label, label_len);
+  node->label_len = label_len;
+
+  return node;
+}
+
+/* frees the children and the label, not the node itself */
 static void
-route_pack_clean(struct RoutePack *pack)
+route_node_clean(struct RouteNode *node)
 {
-  int i = 0;
+  size_t i = 0;
 
-  assert(pack);
+  for (i = 0; i < node->children_num; i++) {
+    route_node_clean(node->children[i]);
+    memory_destroy(node->children[i]);
+  }
 
-  for (i = 0; i < pack->binding_num; i++)
-    if (pack->bindings[i].route != pack->bindings[i].name)
-      memory_destroy(pack->bindings[i].route);
+  if (node->children != NULL)
+    memory_destroy(node->children);
+
+  if (node->label != NULL)
+    memory_destroy(node->label);
+}
+
+static struct RouteNode **
+route_node_find_child(struct RouteNode *node,
+                      char              c)
+{
+  size_t i = 0;
+
+  for (i = 0; i < node->children_num; i++) {
+    if (node->children[i]->label[0] == c)
+      return &(node->children[i]);
+  }
+
+  return NULL;
+}
+
+static int
+route_node_add_child(struct Logger    *logger,
+                     struct RouteNode *node,
+                     struct RouteNode *child)
+{
+  struct RouteNode **children = NULL;
+
+  if ((children = memory_resize(node->children, (node->children_num + 1) * sizeof(struct RouteNode *))) == NULL) {
+    LOGGER_PERROR(logger, "memory_resize");
+    return -1;
+  }
+
+  children[node->children_num++] = child;
+  node->children = children;
+
+  return 0;
 }
 
 /*
- * can be invoked against NULL packs,
- * so we need something lighter than an assert()
+ * puts a new node with the first prefix_len characters of the child
+ * label in its place, with the child under it.
  */
+static struct RouteNode *
+route_node_split(struct Logger     *logger,
+                 struct RouteNode **child_slot,
+                 size_t             prefix_len)
+{
+  struct RouteNode *child = *child_slot;
+  struct RouteNode *parent = NULL;
+
+  if ((parent = route_node_new(logger, child->label, prefix_len)) == NULL)
+    return NULL;
+
+  if (route_node_add_child(logger, parent, child) < 0) {
+    route_node_clean(parent);
+    memory_destroy(parent);
+    return NULL;
+  }
+
+  child->label_len -= prefix_len;
+  memmove(child->label, &(child->label[prefix_len]), child->label_len);
+
+  *child_slot = parent;
+
+  return parent;
+}
+
+static int
+route_tree_bind(struct HTTPRouter *router,
+                const char        *route,
+                struct Container  *container)
+{
+  struct RouteNode *node = &(router->root);
+  struct RouteNode **child_slot = NULL;
+  struct RouteNode *child = NULL;
+  size_t route_len = strlen(route);
+  size_t common = 0;
+
+  while (route_len > 0) {
+    if ((child_slot = route_node_find_child(node, route[0])) == NULL) {
+      if ((child = route_node_new(router->logger, route, route_len)) == NULL)
+        return -1;
+
+      if (route_node_add_child(router->logger, node, child) < 0) {
+        route_node_clean(child);
+        memory_destroy(child);
+        return -1;
+      }
+
+      node = child;
+      break;
+    }
+
+    child = *child_slot;
+    common = 1;
+    while (common < child->label_len && common < route_len && child->label[common] == route[common])
+      common++;
+
+    if (common < child->label_len && (child = route_node_split(router->logger, child_slot, common)) == NULL)
+      return -1;
+
+    node = child;
+    route += common;
+    route_len -= common;
+  }
+
+  if (node->first_container == NULL) {
+    node->first_container = container;
+    node->first_binding = router->bindings_num;
+  }
+  node->last_container = container;
+  router->bindings_num++;
+
+  return 0;
+}
+
+static struct Container *
+route_tree_match(struct HTTPRouter *router,
+                 const char        *url,
+                 size_t             url_len)
+{
+  struct RouteNode *node = &(router->root);
+  struct RouteNode **child_slot = NULL;
+  struct Container *container = NULL;
+  unsigned first_binding = 0;
+  size_t matched = 0;
+
+  while (node != NULL) {
+    if (node->last_container != NULL) {
+      if (router->match_mode == ROUTE_MATCH_LONGEST) {
+        container = node->last_container;
+      }
+      else if (container == NULL || node->first_binding < first_binding) {
+        container = node->first_container;
+        first_binding = node->first_binding;
+      }
+    }
+
+    if (matched == url_len || (child_slot = route_node_find_child(node, url[matched])) == NULL)
+      break;
+
+    node = *child_slot;
+    if (node->label_len > url_len - matched || memcmp(node->label, &(url[matched]), node->label_len) != 0)
+      break;
+
+    matched += node->label_len;
+  }
+
+  return container;
+}
+
+static void
+pattern_binding_destroy(struct PatternBinding *binding)
+{
+  unsigned i = 0;
+
+  for (i = 0; i < binding->params_num; i++)
+    memory_destroy(binding->params_names[i]);
+
+  if (binding->host != NULL)
+    memory_destroy(binding->host);
+
+  memory_destroy(binding);
+}
+
+/* frees everything under the node, not the node itself */
+static void
+pattern_node_clean(struct PatternNode *node)
+{
+  struct PatternBinding *binding = NULL;
+  size_t i = 0;
+
+  for (i = 0; i < node->children_num; i++) {
+    pattern_node_clean(node->children[i]);
+    memory_destroy(node->children[i]);
+  }
+
+  if (node->children != NULL)
+    memory_destroy(node->children);
+
+  if (node->param != NULL) {
+    pattern_node_clean(node->param);
+    memory_destroy(node->param);
+  }
+
+  if (node->wildcard != NULL) {
+    pattern_node_clean(node->wildcard);
+    memory_destroy(node->wildcard);
+  }
+
+  while ((binding = node->bindings) != NULL) {
+    node->bindings = binding->next;
+    pattern_binding_destroy(binding);
+  }
+
+  if (node->segment != NULL)
+    memory_destroy(node->segment);
+}
+
+static char *
+copy_string(struct Logger *logger,
+            const char    *string,
+            size_t         length)
+{
+  char *copy = NULL;
+
+  if ((copy = memory_create(length + 1)) == NULL) {
+    LOGGER_PERROR(logger, "memory_create");
+    return NULL;
+  }
+
+  memcpy(copy, string, length);
+
+  return copy;
+}
+
+static struct PatternNode *
+pattern_node_static_child(struct PatternNode *node,
+                          const char         *segment,
+                          size_t              segment_len)
+{
+  size_t i = 0;
+
+  for (i = 0; i < node->children_num; i++) {
+    if (node->children[i]->segment_len == segment_len && memcmp(node->children[i]->segment, segment, segment_len) == 0)
+      return node->children[i];
+  }
+
+  return NULL;
+}
+
+/* returns the child for the segment, adding it if needed */
+static struct PatternNode *
+pattern_node_get_child(struct Logger      *logger,
+                       struct PatternNode *node,
+                       const char         *segment,
+                       size_t              segment_len)
+{
+  struct PatternNode **slot = NULL;
+  struct PatternNode **children = NULL;
+  struct PatternNode *child = NULL;
+
+  if (segment_len > 0 && segment[0] == ':')
+    slot = &(node->param);
+  else if (segment_len > 0 && segment[0] == '*')
+    slot = &(node->wildcard);
+  else if ((child = pattern_node_static_child(node, segment, segment_len)) != NULL)
+    return child;
+
+  if (slot != NULL && *slot != NULL)
+    return *slot;
+
+  if ((child = memory_create(sizeof(struct PatternNode))) == NULL) {
+    LOGGER_PERROR(logger, "memory_create");
+    return NULL;
+  }
+
+  if (slot != NULL) {
+    *slot = child;
+    return child;
+  }
+
+  if ((child->segment = copy_string(logger, segment, segment_len)) == NULL) {
+    memory_destroy(child);
+    return NULL;
+  }
+  child->segment_len = segment_len;
+
+  if ((children = memory_resize(node->children, (node->children_num + 1) * sizeof(struct PatternNode *))) == NULL) {
+    LOGGER_PERROR(logger, "memory_resize");
+    pattern_node_clean(child);
+    memory_destroy(child);
+    return NULL;
+  }
+
+  children[node->children_num++] = child;
+  node->children = children;
+
+  return child;
+}
+
+/* checks the pattern and collects the names of its params */
+static int
+pattern_parse_params(struct HTTPRouter     *router,
+                     const char            *pattern,
+                     struct PatternBinding *binding)
+{
+  const char *segment = pattern + 1;
+  const char *end = NULL;
+
+  while (1) {
+    if ((end = strchr(segment, '/')) == NULL)
+      end = segment + strlen(segment);
+
+    if (segment[0] == ':' || segment[0] == '*') {
+      if (end - segment < 2) {
+        logger_trace(router->logger, LOG_ERROR, "router", "binding failed: unnamed parameter: %s", pattern);
+        return -1;
+      }
+
+      if (segment[0] == '*' && *end != '\0') {
+        logger_trace(router->logger, LOG_ERROR, "router", "binding failed: wildcard not at the end: %s", pattern);
+        return -1;
+      }
+
+      if (binding->params_num == HTTP_REQUEST_MAX_PARAMS) {
+        logger_trace(router->logger, LOG_ERROR, "router", "binding failed: too many parameters: %s", pattern);
+        return -1;
+      }
+
+      if ((binding->params_names[binding->params_num] = copy_string(router->logger, segment + 1, end - segment - 1)) == NULL)
+        return -1;
+      binding->params_num++;
+    }
+
+    if (*end == '\0')
+      return 0;
+
+    segment = end + 1;
+  }
+}
+
+int
+http_router_bind_pattern(struct HTTPRouter *router,
+                         enum HTTPMethod    method,
+                         const char        *host,
+                         const char        *pattern,
+                         struct Container  *container)
+{
+  struct PatternBinding *binding = NULL;
+  struct PatternBinding **last = NULL;
+  struct PatternNode *node = NULL;
+  const char *segment = NULL;
+  const char *end = NULL;
+
+  assert(router);
+  assert(method <= HTTP_ROUTER_ANY_METHOD);
+  assert(pattern);
+  assert(container);
+
+  if (pattern[0] != '/' || strlen(pattern) > ROUTE_MAX_LEN) {
+    logger_trace(router->logger, LOG_ERROR, "router", "binding failed: invalid pattern: %s", pattern);
+    return -1;
+  }
+
+  if ((binding = memory_create(sizeof(struct PatternBinding))) == NULL) {
+    LOGGER_PERROR(router->logger, "memory_create");
+    return -1;
+  }
+
+  binding->method = method;
+  binding->container = container;
+
+  if (host != NULL) {
+    binding->host_len = strlen(host);
+    if ((binding->host = copy_string(router->logger, host, binding->host_len)) == NULL) {
+      pattern_binding_destroy(binding);
+      return -1;
+    }
+  }
+
+  if (pattern_parse_params(router, pattern, binding) < 0) {
+    pattern_binding_destroy(binding);
+    return -1;
+  }
+
+  node = &(router->patterns);
+  segment = pattern + 1;
+  while (1) {
+    if ((end = strchr(segment, '/')) == NULL)
+      end = segment + strlen(segment);
+
+    if ((node = pattern_node_get_child(router->logger, node, segment, end - segment)) == NULL) {
+      pattern_binding_destroy(binding);
+      return -1;
+    }
+
+    if (*end == '\0')
+      break;
+
+    segment = end + 1;
+  }
+
+  for (last = &(node->bindings); *last != NULL; last = &((*last)->next))
+    ;
+  *last = binding;
+  router->patterns_num++;
+
+  return 0;
+}
+
+/* the Host header, without the port */
 static void
-route_pack_destroy(struct RoutePack *pack)
+pattern_match_lookup_host(struct PatternMatch *match)
 {
-  struct RoutePack *next = NULL;
+  struct MemoryRange range;
+  const char *colon = NULL;
 
-  if (pack == NULL)
+  match->host_looked_up = 1;
+
+  if (http_request_get_known_header_range(match->request, HTTP_HEADER_HOST, &range) < 0)
     return;
 
-  next = pack->next;
-  route_pack_clean(pack);
-  memory_destroy(pack);
-  route_pack_destroy(next);
+  match->host = http_request_get_headers_buffer(match->request) + range.offset;
+  match->host_len = range.length;
+
+  if ((colon = memchr(match->host, ':', match->host_len)) != NULL)
+    match->host_len = colon - match->host;
 }
 
-static struct RoutePack *
-route_pack_bind(struct RoutePack *pack,
-                const char       *route,
-                struct Container *container)
+static struct PatternBinding *
+pattern_node_find_binding(struct PatternNode  *node,
+                          struct PatternMatch *match)
 {
-  struct RoutePack *last = NULL;
+  struct PatternBinding *binding = NULL;
+  struct PatternBinding *found = NULL;
+  int score = 0;
+  int best_score = -1;
+
+  for (binding = node->bindings; binding != NULL; binding = binding->next) {
+    score = 0;
+
+    if (binding->method != HTTP_ROUTER_ANY_METHOD) {
+      if (binding->method != match->method)
+        continue;
+      score += 1;
+    }
+
+    if (binding->host != NULL) {
+      if (!match->host_looked_up)
+        pattern_match_lookup_host(match);
 
-  assert(pack);
+      if (binding->host_len != match->host_len || strncasecmp(binding->host, match->host, match->host_len) != 0)
+        continue;
+      score += 2;
+    }
 
-  if (pack->binding_num == ROUTE_GROUP_LEN) {
-    pack->next = memory_create(sizeof(struct RoutePack));
-    last = route_pack_bind(pack->next, route, container);
-  } else {
-    struct RouteBinding *binding = &(pack->bindings[pack->binding_num]);
-    binding->route_len = strlen(route);
-    if (binding->route_len < ROUTE_BASE_LEN) {
-      strcpy(binding->name, route);
-      binding->route = binding->name;
-    } else {
-      binding->route = memory_strdup(route);
+    if (score > best_score) {
+      found = binding;
+      best_score = score;
     }
-    binding->container = container;
-    pack->binding_num++;
-    last = pack;
   }
-  return last;
+
+  return found;
+}
+
+static struct PatternBinding *pattern_node_match(struct PatternNode *node, struct PatternMatch *match, size_t pos);
+
+/* the segment ending at end matched node */
+static struct PatternBinding *
+pattern_node_enter(struct PatternNode  *node,
+                   struct PatternMatch *match,
+                   size_t               end)
+{
+  if (end == match->path_len)
+    return pattern_node_find_binding(node, match);
+
+  return pattern_node_match(node, match, end + 1);
+}
+
+static void
+pattern_match_capture(struct PatternMatch *match,
+                      size_t               pos,
+                      size_t               length)
+{
+  match->params[match->params_num].offset = match->path_offset + pos;
+  match->params[match->params_num].length = length;
+  match->params_num++;
+}
+
+/* matches the segment starting at pos with the children of node, and on */
+static struct PatternBinding *
+pattern_node_match(struct PatternNode  *node,
+                   struct PatternMatch *match,
+                   size_t               pos)
+{
+  struct PatternBinding *found = NULL;
+  struct PatternNode *child = NULL;
+  const char *slash = NULL;
+  size_t end = match->path_len;
+
+  if ((slash = memchr(match->path + pos, '/', match->path_len - pos)) != NULL)
+    end = slash - match->path;
+
+  if ((child = pattern_node_static_child(node, match->path + pos, end - pos)) != NULL) {
+    if ((found = pattern_node_enter(child, match, end)) != NULL)
+      return found;
+  }
+
+  if (node->param != NULL && end > pos) {
+    pattern_match_capture(match, pos, end - pos);
+    if ((found = pattern_node_enter(node->param, match, end)) != NULL)
+      return found;
+    match->params_num--;
+  }
+
+  if (node->wildcard != NULL) {
+    pattern_match_capture(match, pos, match->path_len - pos);
+    if ((found = pattern_node_find_binding(node->wildcard, match)) != NULL)
+      return found;
+    match->params_num--;
+  }
+
+  return NULL;
+}
+
+static struct Container *
+pattern_tree_match(struct HTTPRouter  *router,
+                   struct HTTPRequest *request)
+{
+  struct PatternMatch match;
+  struct PatternBinding *binding = NULL;
+  struct MemoryRange path_range;
+
+  memset(&match, 0, sizeof(struct PatternMatch));
+
+  /* the fake requests have just the url */
+  if (http_request_get_url_field_range(request, HTTP_URL_FIELD_PATH, &path_range) < 0)
+    http_request_get_url_range(request, &path_range);
+
+  match.request = request;
+  match.path = http_request_get_headers_buffer(request) + path_range.offset;
+  match.path_len = path_range.length;
+  match.path_offset = path_range.offset;
+  match.method = http_request_get_method(request);
+
+  if (match.path_len == 0 || match.path[0] != '/')
+    return NULL;
+
+  if ((binding = pattern_node_match(&(router->patterns), &match, 1)) == NULL)
+    return NULL;
+
+  http_request_set_params(request, binding->params_names, match.params, match.params_num);
+
+  return binding->container;
 }
 
 void
@@ -138,8 +705,8 @@ http_router_destroy(struct HTTPRouter *router)
   assert(router);
 
   container_destroy(router->null);
-  route_pack_clean(&router->pack);
-  route_pack_destroy(router->pack.next);
+  route_node_clean(&(router->root));
+  pattern_node_clean(&(router->patterns));
   memory_destroy(router);
 }
 
@@ -174,39 +741,63 @@ http_router_bind(struct HTTPRouter *router,
     return -1;
   }
 
-  router->last = route_pack_bind(router->last, route, container);
+  return route_tree_bind(router, route, container);
+}
 
-  return 0;
+/* the container serving the request, the null one if none is bound */
+struct Container *
+http_router_route(struct HTTPRouter  *router,
+                  struct HTTPRequest *request)
+{
+  const char *raw_req = NULL;
+  struct Container *container = NULL;
+  struct MemoryRange uri_range;
+
+  /* the patterns first, they are more specific */
+  if (router->patterns_num > 0 && (container = pattern_tree_match(router, request)) != NULL)
+    return container;
+
+  /* nothing bound, the request isn't even looked at */
+  if (router->root.children_num == 0 && router->root.last_container == NULL)
+    return router->null;
+
+  raw_req = http_request_get_headers_buffer(request);
+  http_request_get_url_range(request, &uri_range);
+
+  if ((container = route_tree_match(router, raw_req + uri_range.offset, uri_range.length)) == NULL)
+    container = router->null;
+
+  return container;
 }
 
 /*
- * 0 -> no match; > 0 = len of common string
- * checks at most 'n' chars.
+ * the time spent in the handler goes to the metrics of its route: for the
+ * async ones, only until they return.
  */
 static int
-strmatch(const char *s1,
-         const char *s2,
-         int         n)
+serve_timed(struct Container        *container,
+            struct HTTPRequest      *request,
+            struct HTTPResponse     *response,
+            struct RappAsyncContext *context)
 {
-  int match = 0;
-  while (n-- && s1 && s2 && (*s1++ == *s2++)) {
-    match++;
-  }
-  return match;
-}
+  uint64_t start = 0;
+  int ret = 0;
 
+  if (!metrics_is_enabled())
+    return context != NULL ? container_serve_async(container, request, response, context) : container_serve(container, request, response);
+
+  start = metrics_clock();
+  ret = context != NULL ? container_serve_async(container, request, response, context) : container_serve(container, request, response);
+  metrics_observe_route(container_get_metrics_route(container), start);
+
+  return ret;
+}
 
 int
 http_router_serve(struct HTTPRouter         *router,
                   struct HTTPRequest        *request,
                   struct HTTPResponse       *response)
 {
-  const char *raw_req = NULL;
-  struct Container *container = NULL;
-  struct RoutePack *pack;
-  struct MemoryRange uri_range;
-  int found = 0;
-
   assert(router);
   assert(request);
   assert(response);
@@ -217,28 +808,63 @@ http_router_serve(struct HTTPRouter         *router,
       return ret;
   }
 
-  container = router->null;
-  raw_req = http_request_get_headers_buffer(request);
-  http_request_get_url_range(request, &uri_range);
-  for (pack = &router->pack; !found && pack != NULL; pack = pack->next) {
-    int i = 0;
-    for (i = 0; !found && i < pack->binding_num; i++) {
-      int current = strmatch(raw_req + uri_range.offset, pack->bindings[i].route, uri_range.length);
-      if (current >= pack->bindings[i].route_len) {
-        /* woot! a match! let's update the candidate */
-        container = pack->bindings[i].container;
-        if (router->match_mode == ROUTE_MATCH_FIRST) {
-          found = 1;
-        }
-        /*
-         * else we scan all the routes and automatically update
-         * the container to the longest match we find.
-         */
-      }
-    }
+  return serve_timed(http_router_route(router, request), request, response, NULL);
+}
+
+/* may return RAPP_SERVE_PENDING, and then the context completes the request */
+int
+http_router_serve_async(struct HTTPRouter       *router,
+                        struct HTTPRequest      *request,
+                        struct HTTPResponse     *response,
+                        struct RappAsyncContext *context)
+{
+  assert(router);
+  assert(request);
+
+  return http_router_serve_container_async(router, http_router_route(router, request), request, response, context);
+}
+
+/* as http_router_serve_async, with the container already routed */
+int
+http_router_serve_container_async(struct HTTPRouter       *router,
+                                  struct Container        *container,
+                                  struct HTTPRequest      *request,
+                                  struct HTTPResponse     *response,
+                                  struct RappAsyncContext *context)
+{
+  assert(router);
+  assert(container);
+  assert(request);
+  assert(response);
+  assert(context);
+
+  if (router->starter) {
+    int ret = container_serve(router->starter, request, response);
+    if (ret == 0)
+      return ret;
   }
 
-  return container_serve(container, request, response);
+  return serve_timed(container, request, response, context);
+}
+
+/*
+ * asked once the headers are complete, with the container routed for the
+ * request: the starter may need the body, so it's always buffered when
+ * there's one.
+ */
+int
+http_router_stream_body(struct HTTPRouter  *router,
+                        struct Container   *container,
+                        struct HTTPRequest *request)
+{
+  assert(router);
+  assert(container);
+  assert(request);
+
+  if (router->starter)
+    return 0;
+
+  return container_stream_body(container, request);
 }
 
 /*
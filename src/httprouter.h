@@ -8,13 +8,19 @@
 #ifndef HTTPROUTER_H
 #define HTTPROUTER_H
 
+#include "rapp/rapp_httprequest.h"
+
 struct HTTPRequest;
 struct HTTPResponse;
+struct RappAsyncContext;
 struct Container;
 struct Logger;
 
 struct HTTPRouter;
 
+/* binds a pattern for any method */
+#define HTTP_ROUTER_ANY_METHOD HTTP_METHOD_MAX
+
 enum RouteMatchMode {
   ROUTE_MATCH_FIRST,
   ROUTE_MATCH_LONGEST
@@ -26,8 +32,15 @@ void http_router_destroy(struct HTTPRouter *router);
 int http_router_set_default_container(struct HTTPRouter *router, struct Container *container);
 
 int http_router_bind(struct HTTPRouter *router, const char *route, struct Container *container);
+int http_router_bind_pattern(struct HTTPRouter *router, enum HTTPMethod method, const char *host, const char *pattern, struct Container *container);
+
+struct Container *http_router_route(struct HTTPRouter *router, struct HTTPRequest *request);
 
 int http_router_serve(struct HTTPRouter *router, struct HTTPRequest *request, struct HTTPResponse *response);
+int http_router_serve_async(struct HTTPRouter *router, struct HTTPRequest *request, struct HTTPResponse *response, struct RappAsyncContext *context);
+int http_router_serve_container_async(struct HTTPRouter *router, struct Container *container, struct HTTPRequest *request, struct HTTPResponse *response, struct RappAsyncContext *context);
+
+int http_router_stream_body(struct HTTPRouter *router, struct Container *container, struct HTTPRequest *request);
 
 #endif /* HTTPROUTER_H */
 
@@ -13,10 +13,13 @@
 
 #include "eloop.h"
 #include "httpconnection.h"
+#include "httpdate.h"
+#include "httprequestqueue.h"
 #include "httprouter.h"
 #include "httpserver.h"
 #include "logger.h"
 #include "memory.h"
+#include "tcpconnection.h"
 #include "tcpserver.h"
 
 
@@ -24,7 +27,15 @@ struct HTTPServer {
   struct TcpServer *tcp_server;
   struct ELoop *eloop;
   struct HTTPRouter *router;
+  struct HTTPDate *date;
   struct Logger *logger;
+
+  int edge_triggered;
+  struct HTTPConnectionTimeouts timeouts;
+  size_t max_body_size;
+  struct OffloadPool *offload_pool;
+  struct AccessLog *access_log;
+  struct RequestTracer *tracer;
 };
 
 
@@ -52,11 +63,20 @@ on_accept(struct TcpConnection *tcp_connection,
 
   http_server = (struct HTTPServer *)data;
 
-  if ((http_connection = http_connection_new(http_server->logger, tcp_connection, http_server->router)) == NULL) {
+  tcp_connection_set_edge_triggered(tcp_connection, http_server->edge_triggered);
+
+  if ((http_connection = http_connection_new(http_server->logger, http_server->eloop, tcp_connection, http_server->router)) == NULL) {
     return;
   }
 
   http_connection_set_finish_callback(http_connection, on_request_finish, http_server);
+  http_connection_set_timeouts(http_connection, &(http_server->timeouts));
+  http_connection_set_max_body_size(http_connection, http_server->max_body_size);
+  http_connection_set_offload_pool(http_connection, http_server->offload_pool);
+  http_connection_set_date(http_connection, http_server->date);
+  /* without memory for the entries, the connection just isn't logged or traced */
+  http_connection_set_access_log(http_connection, http_server->access_log);
+  http_connection_set_tracer(http_connection, http_server->tracer);
 }
 
 struct HTTPServer *
@@ -76,12 +96,24 @@ http_server_new(struct Logger     *logger,
     return NULL;
   }
 
+  /* one for all the connections of the loop */
+  if ((http_server->date = http_date_new(logger, eloop)) == NULL) {
+    tcp_server_destroy(http_server->tcp_server);
+    memory_destroy(http_server);
+    return NULL;
+  }
+
   tcp_server_set_accept_callback(http_server->tcp_server, on_accept, http_server);
 
   http_server->logger = logger;
   http_server->eloop = eloop;
   http_server->router = router;
 
+  http_server->timeouts.header = HTTP_CONNECTION_DEFAULT_HEADER_TIMEOUT;
+  http_server->timeouts.body = HTTP_CONNECTION_DEFAULT_BODY_TIMEOUT;
+  http_server->timeouts.keep_alive = HTTP_CONNECTION_DEFAULT_KEEP_ALIVE_TIMEOUT;
+  http_server->max_body_size = HTTP_REQUEST_QUEUE_DEFAULT_MAX_BODY_SIZE;
+
   return http_server;
 }
 
@@ -93,6 +125,9 @@ http_server_destroy(struct HTTPServer *http_server)
   if (http_server->tcp_server != NULL)
     tcp_server_destroy(http_server->tcp_server);
 
+  if (http_server->date != NULL)
+    http_date_destroy(http_server->date);
+
   memory_destroy(http_server);
 }
 
@@ -106,6 +141,66 @@ int http_server_start(struct HTTPServer *http_server,
   return tcp_server_start_listen(http_server->tcp_server, host, port);
 }
 
+void
+http_server_set_edge_triggered(struct HTTPServer *http_server,
+                               int                edge_triggered)
+{
+  assert(http_server != NULL);
+
+  http_server->edge_triggered = edge_triggered;
+}
+
+/* applies to the connections accepted from now on */
+void
+http_server_set_timeouts(struct HTTPServer                   *http_server,
+                         const struct HTTPConnectionTimeouts *timeouts)
+{
+  assert(http_server != NULL);
+  assert(timeouts != NULL);
+
+  http_server->timeouts = *timeouts;
+}
+
+/* applies to the connections accepted from now on, 0 means no limit */
+void
+http_server_set_max_body_size(struct HTTPServer *http_server,
+                              size_t             max_body_size)
+{
+  assert(http_server != NULL);
+
+  http_server->max_body_size = max_body_size;
+}
+
+/* applies to the connections accepted from now on */
+void
+http_server_set_offload_pool(struct HTTPServer  *http_server,
+                             struct OffloadPool *pool)
+{
+  assert(http_server != NULL);
+
+  http_server->offload_pool = pool;
+}
+
+/* applies to the connections accepted from now on */
+void
+http_server_set_access_log(struct HTTPServer *http_server,
+                           struct AccessLog  *log)
+{
+  assert(http_server != NULL);
+
+  http_server->access_log = log;
+}
+
+/* applies to the connections accepted from now on */
+void
+http_server_set_tracer(struct HTTPServer    *http_server,
+                       struct RequestTracer *tracer)
+{
+  assert(http_server != NULL);
+
+  http_server->tracer = tracer;
+}
+
 /*
  * vim: expandtab shiftwidth=2 tabstop=2:
  */
@@ -8,18 +8,30 @@
 #ifndef HTTPSERVER_H
 #define HTTPSERVER_H
 
+#include <stddef.h>
 #include <inttypes.h>
 
 struct Logger;
 struct ELoop;
 struct HTTPRouter;
 struct HTTPServer;
+struct HTTPConnectionTimeouts;
+struct OffloadPool;
+struct AccessLog;
+struct RequestTracer;
 
 struct HTTPServer *http_server_new(struct Logger *logger, struct ELoop *eloop, struct HTTPRouter *router);
 void http_server_destroy(struct HTTPServer *http_server);
 
 int http_server_start(struct HTTPServer *http_server, const char *host, uint16_t port);
 
+void http_server_set_edge_triggered(struct HTTPServer *http_server, int edge_triggered);
+void http_server_set_timeouts(struct HTTPServer *http_server, const struct HTTPConnectionTimeouts *timeouts);
+void http_server_set_max_body_size(struct HTTPServer *http_server, size_t max_body_size);
+void http_server_set_offload_pool(struct HTTPServer *http_server, struct OffloadPool *pool);
+void http_server_set_access_log(struct HTTPServer *http_server, struct AccessLog *log);
+void http_server_set_tracer(struct HTTPServer *http_server, struct RequestTracer *tracer);
+
 #endif /* HTTPSERVER_H */
 
 /*
@@ -12,22 +12,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
 #include <unistd.h>
 
+#include <sys/eventfd.h>
 #include <sys/stat.h>
 
 #include "logger.h"
 #include "memory.h"
 
 
+/* the level first: see logger_is_enabled */
 struct Logger {
-  void *priv;
+  struct LoggerLevel level;
 
-  LogLevel max_level;
+  void *priv;
 
   LogHandlerCallback trace;
   int (*close)(struct Logger *logger);
   int (*flush)(struct Logger *logger);
+  unsigned long (*dropped)(struct Logger *logger);
 };
 
 #define MAX(a, b)   (((a) > (b)) ?(a) :(b))
@@ -51,6 +58,13 @@ struct Logger {
 #define LOG_TEMPLATE_LEN    32
 /* upper bound, really */
 
+/* the async logger: longer lines are truncated */
+#define LOG_LINE_SIZE       4096
+#define LOG_RING_SIZE       (64 * 1024)
+#define LOG_BATCH_SIZE      (64 * 1024)
+/* milliseconds the writer sleeps at most, if a wake up gets lost */
+#define LOG_WRITER_SLEEP    100
+
 
 static const char *
 logger_template(LogLevel level)
@@ -201,6 +215,321 @@ logger_flush_null(struct Logger *logger)
   return 0;
 }
 
+/*
+ * The async logger formats the lines on the calling thread, into a ring of
+ * that thread: only the writer thread takes them out, so the ring needs no
+ * lock. The writer gathers the lines of all the rings and writes them in
+ * batches. A line that doesn't fit in the ring is dropped and counted, the
+ * caller never waits. The lines of a thread keep their order, the ones of
+ * different threads may not.
+ */
+struct LogRing {
+  struct LogRing *next;
+  pthread_t thread;
+
+  /* free running: head is moved by the thread, tail by the writer */
+  size_t head;
+  size_t tail;
+  unsigned long dropped;
+
+  char data[LOG_RING_SIZE];
+};
+
+struct AsyncLog {
+  unsigned long id;
+  int fd;
+  int colored;
+
+  /* pushed by the threads on their first line, never removed */
+  struct LogRing *rings;
+
+  pthread_t writer;
+  int wake_fd;
+  int sleeping;
+  int stopping;
+  unsigned long rounds;
+
+  size_t batch_length;
+  char batch[LOG_BATCH_SIZE];
+};
+
+/* the ring of the calling thread for the async logger with the id */
+static __thread struct LogRing *thread_ring;
+static __thread unsigned long thread_ring_log;
+
+static unsigned long async_log_ids;
+
+static void
+ring_copy_in(struct LogRing *ring,
+             size_t          position,
+             const void     *data,
+             size_t          length)
+{
+  size_t offset = position % LOG_RING_SIZE;
+  size_t first = MIN(length, LOG_RING_SIZE - offset);
+
+  memcpy(&(ring->data[offset]), data, first);
+  memcpy(ring->data, (const char *)data + first, length - first);
+}
+
+static void
+ring_copy_out(struct LogRing *ring,
+              size_t          position,
+              void           *data,
+              size_t          length)
+{
+  size_t offset = position % LOG_RING_SIZE;
+  size_t first = MIN(length, LOG_RING_SIZE - offset);
+
+  memcpy(data, &(ring->data[offset]), first);
+  memcpy((char *)data + first, ring->data, length - first);
+}
+
+static struct LogRing *
+async_log_thread_ring(struct AsyncLog *log)
+{
+  struct LogRing *ring = NULL;
+
+  if (thread_ring != NULL && thread_ring_log == log->id)
+    return thread_ring;
+
+  for (ring = __atomic_load_n(&(log->rings), __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next) {
+    if (pthread_equal(ring->thread, pthread_self()))
+      break;
+  }
+
+  if (ring == NULL) {
+    if ((ring = memory_create(sizeof(struct LogRing))) == NULL)
+      return NULL;
+
+    ring->thread = pthread_self();
+    ring->next = __atomic_load_n(&(log->rings), __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&(log->rings), &(ring->next), ring, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+      ;
+  }
+
+  thread_ring = ring;
+  thread_ring_log = log->id;
+
+  return ring;
+}
+
+static void
+async_log_wake(struct AsyncLog *log)
+{
+  eventfd_write(log->wake_fd, 1);
+}
+
+static int
+logger_trace_async(void       *user_data,
+                   LogLevel    level,
+                   const char *tag,
+                   const char *fmt,
+                   va_list     ap)
+{
+  struct AsyncLog *log = user_data;
+  struct LogRing *ring = NULL;
+  char format[LOG_LINE_SIZE];
+  char line[LOG_LINE_SIZE];
+  uint32_t length = 0;
+  int ret = 0;
+  size_t head = 0;
+
+  assert(log != NULL);
+
+  /* the file logger writes the messages as they are */
+  if (!log->colored)
+    level = LOG_MARK;
+  tag = (level != LOG_MARK) ?tag :"";
+
+  snprintf(format, sizeof(format), logger_template(level), tag, fmt);
+  if ((ret = vsnprintf(line, sizeof(line), format, ap)) < 0)
+    return 1;
+  length = MIN((size_t)ret, sizeof(line) - 1);
+
+  if ((ring = async_log_thread_ring(log)) == NULL)
+    return 1;
+
+  head = ring->head;
+  if (LOG_RING_SIZE - (head - __atomic_load_n(&(ring->tail), __ATOMIC_ACQUIRE)) < sizeof(length) + length) {
+    __atomic_add_fetch(&(ring->dropped), 1, __ATOMIC_RELAXED);
+    return 0;
+  }
+
+  ring_copy_in(ring, head, &length, sizeof(length));
+  ring_copy_in(ring, head + sizeof(length), line, length);
+  __atomic_store_n(&(ring->head), head + sizeof(length) + length, __ATOMIC_SEQ_CST);
+
+  /* the writer is woken only if it went to sleep */
+  if (__atomic_load_n(&(log->sleeping), __ATOMIC_SEQ_CST) && __atomic_exchange_n(&(log->sleeping), 0, __ATOMIC_SEQ_CST))
+    async_log_wake(log);
+
+  return 0;
+}
+
+static void
+async_log_write_batch(struct AsyncLog *log)
+{
+  size_t written = 0;
+  ssize_t ret = 0;
+
+  while (written < log->batch_length) {
+    if ((ret = write(log->fd, &(log->batch[written]), log->batch_length - written)) < 0) {
+      if (errno == EINTR)
+        continue;
+      /* nobody to tell: the lines are lost */
+      break;
+    }
+    written += ret;
+  }
+
+  log->batch_length = 0;
+}
+
+/* returns the number of lines taken from the rings */
+static unsigned
+async_log_drain(struct AsyncLog *log)
+{
+  struct LogRing *ring = NULL;
+  size_t tail = 0;
+  size_t head = 0;
+  uint32_t length = 0;
+  unsigned lines = 0;
+
+  for (ring = __atomic_load_n(&(log->rings), __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next) {
+    tail = ring->tail;
+    head = __atomic_load_n(&(ring->head), __ATOMIC_ACQUIRE);
+
+    while (tail != head) {
+      ring_copy_out(ring, tail, &length, sizeof(length));
+
+      if (log->batch_length + length > LOG_BATCH_SIZE)
+        async_log_write_batch(log);
+
+      ring_copy_out(ring, tail + sizeof(length), &(log->batch[log->batch_length]), length);
+      log->batch_length += length;
+      tail += sizeof(length) + length;
+      lines++;
+    }
+
+    __atomic_store_n(&(ring->tail), tail, __ATOMIC_RELEASE);
+  }
+
+  if (log->batch_length > 0)
+    async_log_write_batch(log);
+
+  return lines;
+}
+
+static int
+async_log_pending(struct AsyncLog *log)
+{
+  struct LogRing *ring = NULL;
+
+  for (ring = __atomic_load_n(&(log->rings), __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next) {
+    if (__atomic_load_n(&(ring->head), __ATOMIC_SEQ_CST) != ring->tail)
+      return 1;
+  }
+
+  return 0;
+}
+
+static void *
+async_log_run(void *data)
+{
+  struct AsyncLog *log = data;
+  struct pollfd pfd;
+  eventfd_t value;
+  int stopping = 0;
+
+  pfd.fd = log->wake_fd;
+  pfd.events = POLLIN;
+
+  for (;;) {
+    stopping = __atomic_load_n(&(log->stopping), __ATOMIC_ACQUIRE);
+
+    if (async_log_drain(log) > 0) {
+      __atomic_add_fetch(&(log->rounds), 1, __ATOMIC_RELEASE);
+      continue;
+    }
+    __atomic_add_fetch(&(log->rounds), 1, __ATOMIC_RELEASE);
+
+    if (stopping)
+      break;
+
+    /* a line committed after the drain is seen here, or its thread wakes us */
+    __atomic_store_n(&(log->sleeping), 1, __ATOMIC_SEQ_CST);
+    if (!async_log_pending(log) && poll(&pfd, 1, LOG_WRITER_SLEEP) > 0)
+      eventfd_read(log->wake_fd, &value);
+    __atomic_store_n(&(log->sleeping), 0, __ATOMIC_SEQ_CST);
+  }
+
+  return NULL;
+}
+
+/* waits for the writer to go through all the rings at least once */
+static int
+logger_flush_async(struct Logger *logger)
+{
+  struct AsyncLog *log = NULL;
+  struct timespec pause = {0, 1000000};
+  unsigned long rounds = 0;
+
+  assert(logger != NULL);
+
+  log = logger->priv;
+  rounds = __atomic_load_n(&(log->rounds), __ATOMIC_ACQUIRE);
+
+  while (__atomic_load_n(&(log->rounds), __ATOMIC_ACQUIRE) < rounds + 2) {
+    async_log_wake(log);
+    nanosleep(&pause, NULL);
+  }
+
+  return 0;
+}
+
+static int
+logger_destroy_async(struct Logger *logger)
+{
+  struct AsyncLog *log = NULL;
+  struct LogRing *ring = NULL;
+
+  assert(logger != NULL);
+
+  log = logger->priv;
+
+  __atomic_store_n(&(log->stopping), 1, __ATOMIC_RELEASE);
+  async_log_wake(log);
+  pthread_join(log->writer, NULL);
+
+  while ((ring = log->rings) != NULL) {
+    log->rings = ring->next;
+    memory_destroy(ring);
+  }
+
+  close(log->wake_fd);
+  memory_destroy(log);
+
+  return 0;
+}
+
+static unsigned long
+logger_dropped_async(struct Logger *logger)
+{
+  struct AsyncLog *log = NULL;
+  struct LogRing *ring = NULL;
+  unsigned long dropped = 0;
+
+  assert(logger != NULL);
+
+  log = logger->priv;
+
+  for (ring = __atomic_load_n(&(log->rings), __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+    dropped += __atomic_load_n(&(ring->dropped), __ATOMIC_RELAXED);
+
+  return dropped;
+}
+
 static struct Logger *
 logger_new_fp(LogLevel max_level,
               FILE    *sink,
@@ -217,7 +546,7 @@ logger_new_fp(LogLevel max_level,
   }
 
   logger->priv = sink;
-  logger->max_level = lev;
+  logger->level.max_level = lev;
   logger->trace = (colored) ?logger_trace_console :logger_trace_file;
   logger->close = logger_destroy_file;
   logger->flush = logger_flush_file;
@@ -241,6 +570,65 @@ logger_new_console(LogLevel max_level,
   return logger_new_fp(max_level, sink, 1);
 }
 
+/*
+ * like the console logger if colored, like the file one otherwise: the
+ * lines are written to the file descriptor of sink, which is not owned.
+ */
+struct Logger *
+logger_new_async(LogLevel max_level,
+                 FILE    *sink,
+                 int      colored)
+{
+  LogLevel lev = CLAMP(max_level, LOG_ERROR, LOG_MARK); /* TODO */
+  struct Logger *logger = NULL;
+  struct AsyncLog *log = NULL;
+  int err = 0;
+
+  assert(sink != NULL);
+
+  if ((logger = memory_create(sizeof(struct Logger))) == NULL) {
+    logger_panic("memory_create: %s", strerror(errno));
+    return NULL;
+  }
+
+  if ((log = memory_create(sizeof(struct AsyncLog))) == NULL) {
+    logger_panic("memory_create: %s", strerror(errno));
+    memory_destroy(logger);
+    return NULL;
+  }
+
+  /* what was written to sink so far comes first */
+  fflush(sink);
+
+  log->id = __atomic_add_fetch(&async_log_ids, 1, __ATOMIC_RELAXED);
+  log->fd = fileno(sink);
+  log->colored = colored;
+
+  if ((log->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+    logger_panic("eventfd: %s", strerror(errno));
+    memory_destroy(log);
+    memory_destroy(logger);
+    return NULL;
+  }
+
+  if ((err = pthread_create(&(log->writer), NULL, async_log_run, log)) != 0) {
+    logger_panic("pthread_create: %s", strerror(err));
+    close(log->wake_fd);
+    memory_destroy(log);
+    memory_destroy(logger);
+    return NULL;
+  }
+
+  logger->priv = log;
+  logger->level.max_level = lev;
+  logger->trace = logger_trace_async;
+  logger->close = logger_destroy_async;
+  logger->flush = logger_flush_async;
+  logger->dropped = logger_dropped_async;
+
+  return logger;
+}
+
 static struct Logger *
 logger_make(LogLevel           lev,
             LogHandlerCallback logger_handler,
@@ -257,7 +645,7 @@ logger_make(LogLevel           lev,
   }
 
   logger->priv = user_data;
-  logger->max_level = lev;
+  logger->level.max_level = lev;
   logger->trace = logger_handler;
   logger->close = logger_destroy_null;
   logger->flush = logger_flush_null;
@@ -316,7 +704,7 @@ logger_trace_va(struct Logger *logger,
 
   level = CLAMP(level, LOG_ERROR, LOG_MARK); /* TODO */
 
-  if (logger->max_level >= level) {
+  if (logger_is_enabled(logger, level)) {
     err = logger->trace(logger->priv, level, tag, fmt, args);
   }
   return err;
@@ -330,6 +718,18 @@ logger_flush(struct Logger *logger)
   return logger->flush(logger);
 }
 
+/* the lines dropped because the logger couldn't keep up */
+unsigned long
+logger_get_dropped(struct Logger *logger)
+{
+  assert(logger != NULL);
+
+  if (logger->dropped == NULL)
+    return 0;
+
+  return logger->dropped(logger);
+}
+
 void
 logger_destroy(struct Logger *logger)
 {
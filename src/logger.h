@@ -14,11 +14,50 @@
 
 typedef int (*LogHandlerCallback)(void *data, LogLevel level, const char *tag, const char *fmt, va_list args);
 
+/* the most verbose level compiled in, set by the build */
+#ifndef LOGGER_MAX_LEVEL
+#define LOGGER_MAX_LEVEL LOG_DEBUG
+#endif
+
+/*
+ * the start of every logger: the level is checked right at the call site,
+ * before the arguments are evaluated.
+ */
+struct LoggerLevel {
+  int max_level; /* -1 lets nothing through */
+};
+
+static inline int
+logger_is_enabled(const struct Logger *logger,
+                  LogLevel             level)
+{
+  return ((const struct LoggerLevel *)logger)->max_level >= (int)level;
+}
+
+#define LOGGER_ENABLED(LOGGER, LEVEL) \
+  ((LEVEL) <= LOGGER_MAX_LEVEL && logger_is_enabled((LOGGER), (LEVEL)))
+
+/* like logger_trace, but nothing is done for the levels filtered out */
+#define LOGGER_TRACE(LOGGER, LEVEL, TAG, ...)                     \
+  do {                                                            \
+    if (LOGGER_ENABLED((LOGGER), (LEVEL)))                        \
+      logger_trace((LOGGER), (LEVEL), (TAG), __VA_ARGS__);        \
+  } while (0)
+
+#define LOGGER_ERROR(LOGGER, TAG, ...) LOGGER_TRACE(LOGGER, LOG_ERROR, TAG, __VA_ARGS__)
+#define LOGGER_WARNING(LOGGER, TAG, ...) LOGGER_TRACE(LOGGER, LOG_WARNING, TAG, __VA_ARGS__)
+#define LOGGER_INFO(LOGGER, TAG, ...) LOGGER_TRACE(LOGGER, LOG_INFO, TAG, __VA_ARGS__)
+#define LOGGER_DEBUG(LOGGER, TAG, ...) LOGGER_TRACE(LOGGER, LOG_DEBUG, TAG, __VA_ARGS__)
+
 
 struct Logger *logger_new_null(void);
 struct Logger *logger_new_file(LogLevel max_level, FILE *sink);
 struct Logger *logger_new_console(LogLevel max_level, FILE *sink);
 struct Logger *logger_new_custom(LogLevel max_level, LogHandlerCallback log_handler, void *user_data);
+/* writes from a thread of its own, never blocking the callers */
+struct Logger *logger_new_async(LogLevel max_level, FILE *sink, int colored);
+
+unsigned long logger_get_dropped(struct Logger *logger);
 
 void logger_destroy(struct Logger *logger);
 
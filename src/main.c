@@ -7,19 +7,32 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <signal.h>
+#include <limits.h>
 #include <assert.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <config.h>
+
 #include "logger.h"
+#include "accesslog.h"
 #include "eloop.h"
+#include "httprequestqueue.h"
 #include "httprouter.h"
-#include "httpserver.h"
 #include "signalhandler.h"
 #include "container.h"
+#include "memory.h"
+#include "metrics.h"
+#include "offloadpool.h"
+#include "worker.h"
 #include "config/common.h"
 
+#define MAX_WORKERS 1024
+#define MAX_TIMEOUT 86400
+
 static void
 on_signal(struct SignalHandler *signal_handler,
           void                 *data)
@@ -33,21 +46,115 @@ on_signal(struct SignalHandler *signal_handler,
   event_loop_stop(eloop);
 }
 
+static int
+parse_config_files(struct RappConfig *config)
+{
+  char *confpath;
+  int num, i, res;
+
+  // Scan configuration directories
+  rapp_config_get_num_values(config, "core", "confd", &num);
+  for (i = 0; i < num; i++) {
+    if (rapp_config_get_nth_string(config, "core", "confd", i, &confpath) != 0)
+        return -1;
+    res = config_scan_directory(config, confpath, ".yaml");
+    free(confpath);
+    if (res != 0)
+        return -1;
+  }
+
+  // Parsing individual configs
+  rapp_config_get_num_values(config, "core", "config", &num);
+  for (i = 0; i < num; i++) {
+    if (rapp_config_get_nth_string(config, "core", "config", i, &confpath) != 0)
+        return -1;
+    res = config_parse(config, confpath);
+    free(confpath);
+    if (res != 0)
+        return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * loads the plugins of the routes section, once per file: the routes
+ * sharing a plugin share its container.
+ */
+static struct Container **
+mount_routes(struct Logger     *logger,
+             struct RappConfig *config)
+{
+  struct Container **mounts = NULL;
+  const char *prefix, *plugin, *other_prefix, *other_plugin;
+  int num_routes, i, j;
+
+  num_routes = config_get_num_routes(config);
+
+  if ((mounts = memory_create(sizeof(struct Container *) * (num_routes + 1))) == NULL) {
+    LOGGER_PERROR(logger, "memory_create");
+    return NULL;
+  }
+
+  for (i = 0; i < num_routes; i++) {
+    config_get_nth_route(config, i, &prefix, &plugin);
+
+    for (j = 0; j < i; j++) {
+      config_get_nth_route(config, j, &other_prefix, &other_plugin);
+      if (strcmp(plugin, other_plugin) == 0) {
+        mounts[i] = mounts[j];
+        break;
+      }
+    }
+
+    if (mounts[i] == NULL && (mounts[i] = container_new(logger, plugin, config)) == NULL)
+      return NULL;
+  }
+
+  return mounts;
+}
+
+/* the first route of a plugin owns its container */
+static int
+is_first_mount(struct Container **mounts,
+               int                n)
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    if (mounts[i] == mounts[n])
+      return 0;
+  }
+
+  return 1;
+}
+
 int
 main(int argc, char *argv[])
 {
   struct Logger *logger = NULL;
   struct ELoop *eloop = NULL;
   struct HTTPRouter *http_router = NULL;
-  struct HTTPServer *http_server = NULL;
+  struct Worker **workers = NULL;
+  struct OffloadPool *offload_pool = NULL;
+  struct AccessLog **access_logs = NULL;
+  char *access_log_path = NULL;
+  char worker_access_log_path[PATH_MAX];
+  long access_log_size = ACCESS_LOG_DEFAULT_SEGMENT_SIZE;
+  struct Metrics *metrics = NULL;
+  struct Container *metrics_container = NULL;
+  char *metrics_path = NULL;
   struct SignalHandler *signal_handler = NULL;
   struct Container *container = NULL;
+  struct Container **mounts = NULL;
   struct RappConfig *config = NULL;
   enum RouteMatchMode match_mode = ROUTE_MATCH_FIRST;
   char *address;
   long port;
-  int num, i, res;
-  char *confpath;
+  long num_workers = 1;
+  long num_offload_threads = 0;
+  int num_routes, i, res;
+  const char *prefix, *plugin;
   struct RappArguments arguments;
 
   config_parse_early_commandline(&arguments, argc, argv);
@@ -55,7 +162,9 @@ main(int argc, char *argv[])
   if (!arguments.logoutput) {
     exit(1);
   }
-  if (arguments.logoutput_is_console == 1)
+  if (arguments.logasync == 1)
+    logger = logger_new_async(arguments.loglevel, arguments.logoutput, arguments.logoutput_is_console);
+  else if (arguments.logoutput_is_console == 1)
     logger = logger_new_console(arguments.loglevel, arguments.logoutput);
   else
     logger = logger_new_file(arguments.loglevel, arguments.logoutput);
@@ -80,14 +189,43 @@ main(int argc, char *argv[])
     }
   }
 
+  if ((num_workers = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+    num_workers = 1;
+
   rapp_config_opt_add(config, "core", "address", PARAM_STRING, "Address to listen to", NULL);
   rapp_config_opt_add(config, "core", "port", PARAM_INT, "Port", NULL);
   rapp_config_opt_add(config, "core", "config", PARAM_STRING, "Path to yaml config", "FILE");
   rapp_config_opt_add(config, "core", "confd", PARAM_STRING, "Path to directory to scan for config", "DIR");
+  rapp_config_opt_add(config, "core", "workers", PARAM_INT, "Number of worker threads (default: one per CPU)", "NUM");
+  rapp_config_opt_add(config, "core", "offload_threads", PARAM_INT, "Number of threads for the blocking work of the plugins (default: one per CPU, 0 disables)", "NUM");
+  rapp_config_opt_add(config, "core", "edge_triggered", PARAM_BOOL, "Use edge triggered notifications for connections", NULL);
+  rapp_config_opt_add(config, "core", "header_timeout", PARAM_INT, "Seconds to receive the request headers (0 disables)", "SECS");
+  rapp_config_opt_add(config, "core", "body_timeout", PARAM_INT, "Seconds to receive the request body (0 disables)", "SECS");
+  rapp_config_opt_add(config, "core", "keepalive_timeout", PARAM_INT, "Seconds a connection can stay idle (0 disables)", "SECS");
+  rapp_config_opt_add(config, "core", "max_body_size", PARAM_INT, "Bytes of a request body buffered, unless streamed (0 disables the limit)", "BYTES");
+  rapp_config_opt_add(config, "core", "access_log", PARAM_STRING, "Path of the binary access log, suffixed by the worker number", "FILE");
+  rapp_config_opt_add(config, "core", "access_log_size", PARAM_INT, "Bytes of an access log file before it's rotated", "BYTES");
+  rapp_config_opt_add(config, "core", "slow_request", PARAM_INT, "Milliseconds after which a request is logged with the time of each of its phases (0 disables)", "MSECS");
+  rapp_config_opt_add(config, "core", "trace_sample", PARAM_INT, "Trace one request out of NUM for --slow-request (default: 1)", "NUM");
+  rapp_config_opt_add(config, "core", "metrics", PARAM_STRING, "Route serving the metrics, in the Prometheus text format (unset disables them)", "ROUTE");
 
   rapp_config_opt_set_range_int(config, "core", "port", 0, 65535);
+  rapp_config_opt_set_range_int(config, "core", "workers", 1, MAX_WORKERS);
+  rapp_config_opt_set_range_int(config, "core", "offload_threads", 0, MAX_WORKERS);
+  rapp_config_opt_set_range_int(config, "core", "header_timeout", 0, MAX_TIMEOUT);
+  rapp_config_opt_set_range_int(config, "core", "body_timeout", 0, MAX_TIMEOUT);
+  rapp_config_opt_set_range_int(config, "core", "keepalive_timeout", 0, MAX_TIMEOUT);
+  rapp_config_opt_set_range_int(config, "core", "max_body_size", 0, LONG_MAX);
+  rapp_config_opt_set_range_int(config, "core", "access_log_size", 4096, LONG_MAX);
+  rapp_config_opt_set_range_int(config, "core", "slow_request", 0, MAX_TIMEOUT * 1000);
+  rapp_config_opt_set_range_int(config, "core", "trace_sample", 1, INT_MAX);
   rapp_config_opt_set_default_string(config, "core", "address", "127.0.0.1");
   rapp_config_opt_set_default_int(config, "core", "port", 8080);
+  rapp_config_opt_set_default_int(config, "core", "workers", num_workers);
+  rapp_config_opt_set_default_int(config, "core", "offload_threads", num_workers);
+  rapp_config_opt_set_default_int(config, "core", "max_body_size", HTTP_REQUEST_QUEUE_DEFAULT_MAX_BODY_SIZE);
+  rapp_config_opt_set_default_int(config, "core", "access_log_size", ACCESS_LOG_DEFAULT_SEGMENT_SIZE);
+  rapp_config_opt_set_default_int(config, "core", "trace_sample", 1);
   rapp_config_opt_set_multivalued(config, "core", "config", 1);
   rapp_config_opt_set_multivalued(config, "core", "confd", 1);
 
@@ -100,75 +238,176 @@ main(int argc, char *argv[])
     exit(1);
   }
 
-  // Scan configuration directories
-  rapp_config_get_num_values(config, "core", "confd", &num);
-  for (i = 0; i < num; i++) {
-    if (rapp_config_get_nth_string(config, "core", "confd", i, &confpath) != 0)
-        exit(1);
-    res = config_scan_directory(config, confpath, ".yaml");
-    free(confpath);
-    if (res != 0)
-        exit(1);
-  }
+  if (parse_config_files(config) != 0)
+    exit(1);
 
-  // Parsing individual configs
-  rapp_config_get_num_values(config, "core", "config", &num);
-  for (i = 0; i < num; i++) {
-    if (rapp_config_get_nth_string(config, "core", "config", i, &confpath) != 0)
-        exit(1);
-    res = config_parse(config, confpath);
-    free(confpath);
-    if (res != 0)
-        exit(1);
-  }
+  num_routes = config_get_num_routes(config);
 
-  if (!arguments.container) {
+  if (!arguments.container && num_routes == 0) {
     logger_trace(logger, LOG_CRITICAL, "rapp", "No container provided.");
     exit(1);
   }
 
-  container_init(container, config);
+  if ((mounts = mount_routes(logger, config)) == NULL)
+    exit(1);
+
+  /* the mounted plugins have just added their options: read them too */
+  if (num_routes > 0 && parse_config_files(config) != 0)
+    exit(1);
+
+  if (container)
+    container_init(container, config);
+  for (i = 0; i < num_routes; i++) {
+    if (is_first_mount(mounts, i))
+      container_init(mounts[i], config);
+  }
   rapp_config_get_string(config, "core", "address", &address);
   rapp_config_get_int(config, "core", "port", &port);
+  rapp_config_get_int(config, "core", "workers", &num_workers);
+  rapp_config_get_int(config, "core", "offload_threads", &num_offload_threads);
+  rapp_config_get_string(config, "core", "access_log", &access_log_path);
+  rapp_config_get_int(config, "core", "access_log_size", &access_log_size);
+  rapp_config_get_string(config, "core", "metrics", &metrics_path);
+
+#ifndef SO_REUSEPORT_FOUND
+  if (num_workers > 1) {
+    logger_trace(logger, LOG_WARNING, "rapp", "SO_REUSEPORT not available, running a single worker");
+    num_workers = 1;
+  }
+#endif
 
   logger_trace(logger, LOG_INFO, "rapp", "listening on %s", address);
   logger_trace(logger, LOG_INFO, "rapp", "listening on %d", port);
 
   logger_trace(logger, LOG_INFO, "rapp",
-               "rapp %s (rev %s) starting... (PID=%d)",
-               rapp_get_version(), rapp_get_version_sha1(), getpid());
+               "rapp %s (rev %s) starting... (PID=%d, workers=%ld)",
+               rapp_get_version(), rapp_get_version_sha1(), getpid(), num_workers);
 
   eloop = event_loop_new(logger);
 
+  /* signals must be blocked before spawning the workers: they inherit the mask */
   signal_handler = signal_handler_new(logger, eloop);
   signal_handler_add_signal_callback(signal_handler, SIGINT, on_signal, eloop);
   signal_handler_add_signal_callback(signal_handler, SIGTERM, on_signal, eloop);
 
+  /* the mounts nest: the most specific prefix wins */
+  if (num_routes > 0)
+    match_mode = ROUTE_MATCH_LONGEST;
+
   http_router = http_router_new(logger, match_mode);
-  http_router_bind(http_router, "/", container);
 
-  http_server = http_server_new(logger, eloop, http_router);
+  /* bound first: a single container on "/" would take its requests too */
+  if (metrics_path != NULL) {
+    if ((metrics = metrics_new(logger)) == NULL || (metrics_container = metrics_new_container(metrics)) == NULL)
+      exit(1);
+
+    container_set_metrics_route(metrics_container, metrics_add_route(metrics, metrics_path));
+    logger_trace(logger, LOG_INFO, "rapp", "serving the metrics on %s", metrics_path);
+    if (http_router_bind(http_router, metrics_path, metrics_container) != 0)
+      exit(1);
+  }
+
+  for (i = 0; i < num_routes; i++) {
+    config_get_nth_route(config, i, &prefix, &plugin);
+    logger_trace(logger, LOG_INFO, "rapp", "mounting %s on %s", plugin, prefix);
+    if (http_router_bind(http_router, prefix, mounts[i]) != 0)
+      exit(1);
+
+    /* a shared container is timed under its first prefix */
+    if (metrics != NULL && is_first_mount(mounts, i))
+      container_set_metrics_route(mounts[i], metrics_add_route(metrics, prefix));
+  }
+  if (container) {
+    http_router_bind(http_router, "/", container);
+    if (metrics != NULL)
+      container_set_metrics_route(container, metrics_add_route(metrics, "/"));
+  }
+
+  if (num_offload_threads > 0 && (offload_pool = offload_pool_new(logger, num_offload_threads)) == NULL)
+    exit(1);
+
+  if ((workers = memory_create(sizeof(struct Worker *) * num_workers)) == NULL) {
+    LOGGER_PERROR(logger, "memory_create");
+    exit(1);
+  }
+
+  if ((access_logs = memory_create(sizeof(struct AccessLog *) * num_workers)) == NULL) {
+    LOGGER_PERROR(logger, "memory_create");
+    exit(1);
+  }
+
+  for (i = 0; i < num_workers; i++) {
+    if ((workers[i] = worker_new(logger, http_router, config)) == NULL)
+      exit(1);
+
+    worker_set_offload_pool(workers[i], offload_pool);
+    worker_set_metrics(workers[i], metrics);
 
-  http_server_start(http_server, address, port);
+    /* one file each: the workers never wait for each other */
+    if (access_log_path != NULL) {
+      snprintf(worker_access_log_path, sizeof(worker_access_log_path), "%s.%d", access_log_path, i);
+      if ((access_logs[i] = access_log_new(logger, worker_access_log_path, access_log_size)) == NULL)
+        exit(1);
+      worker_set_access_log(workers[i], access_logs[i]);
+    }
+
+    if (worker_start(workers[i], address, port) < 0)
+      exit(1);
+  }
   free(address);
+  free(access_log_path);
+  free(metrics_path);
   free(arguments.container);
 
   event_loop_run(eloop);
 
-  http_server_destroy(http_server);
+  for (i = 0; i < num_workers; i++)
+    worker_stop(workers[i]);
+  for (i = 0; i < num_workers; i++)
+    worker_join(workers[i]);
+
+  /* the loops are gone: the completions of the last jobs are just dropped */
+  if (offload_pool)
+    offload_pool_destroy(offload_pool);
+
+  for (i = 0; i < num_workers; i++) {
+    worker_destroy(workers[i]);
+    if (access_logs[i] != NULL)
+      access_log_destroy(access_logs[i]);
+  }
+  memory_destroy(workers);
+  memory_destroy(access_logs);
+
   http_router_destroy(http_router);
   signal_handler_destroy(signal_handler);
   event_loop_destroy(eloop);
 
-  container_destroy(container);
+  if (container)
+    container_destroy(container);
+  for (i = 0; i < num_routes; i++) {
+    if (is_first_mount(mounts, i))
+      container_destroy(mounts[i]);
+  }
+  memory_destroy(mounts);
+
+  if (metrics != NULL) {
+    container_destroy(metrics_container);
+    metrics_destroy(metrics);
+  }
 
   config_destroy(config);
 
+  if (logger_get_dropped(logger) > 0)
+    logger_trace(logger, LOG_WARNING, "rapp",
+                 "%lu log lines dropped", logger_get_dropped(logger));
+
   logger_trace(logger, LOG_INFO, "rapp",
                "%s", "rapp finished!");
 
   logger_destroy(logger);
 
+  memory_pool_cleanup();
+
   return 0;
 }
 
@@ -10,9 +10,41 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <assert.h>
+
+#include <pthread.h>
 
 #include "memory.h"
 
+#define SLAB_SIZE (64 * 1024)
+#define POOL_ALIGNMENT 16
+
+/*
+ * The pools objects are carved out of slabs. Every thread keeps its own
+ * lists of free objects, so that creating and destroying them takes no
+ * lock, and the last object destroyed is the first reused, still in cache.
+ * The slabs are only freed by memory_pool_cleanup, when no thread uses them
+ * anymore: an object can then be destroyed by a thread other than the one
+ * which created it, and is just reused by the former.
+ */
+struct MemoryPoolObject {
+  struct MemoryPoolObject *next;
+};
+
+struct MemorySlab {
+  struct MemorySlab *next;
+};
+
+struct MemoryPoolCache {
+  size_t object_size;
+  struct MemoryPoolObject *free_objects;
+};
+
+static __thread struct MemoryPoolCache pool_caches[MEMORY_POOL_MAX];
+
+static pthread_mutex_t slabs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct MemorySlab *slabs = NULL;
+
 
 char *
 memory_strdup(const char *s)
@@ -50,6 +82,94 @@ memory_destroy(void *mem)
   free(mem);
 }
 
+/* the slab header takes the first POOL_ALIGNMENT bytes, the objects the rest */
+static int
+grow_pool(struct MemoryPoolCache *cache)
+{
+  struct MemorySlab *slab = NULL;
+  struct MemoryPoolObject *object = NULL;
+  size_t slab_size = SLAB_SIZE;
+  size_t offset = 0;
+
+  if (cache->object_size > SLAB_SIZE - POOL_ALIGNMENT)
+    slab_size = POOL_ALIGNMENT + cache->object_size;
+
+  if ((slab = malloc(slab_size)) == NULL)
+    return -1;
+
+  pthread_mutex_lock(&slabs_mutex);
+  slab->next = slabs;
+  slabs = slab;
+  pthread_mutex_unlock(&slabs_mutex);
+
+  for (offset = POOL_ALIGNMENT; offset + cache->object_size <= slab_size; offset += cache->object_size) {
+    object = (struct MemoryPoolObject *)((char *)slab + offset);
+    object->next = cache->free_objects;
+    cache->free_objects = object;
+  }
+
+  return 0;
+}
+
+void *
+memory_pool_create(enum MemoryPoolType type,
+                   size_t              size)
+{
+  struct MemoryPoolCache *cache = NULL;
+  struct MemoryPoolObject *object = NULL;
+
+  assert(type < MEMORY_POOL_MAX);
+  assert(size > 0);
+
+  cache = &(pool_caches[type]);
+
+  if (cache->object_size == 0)
+    cache->object_size = (size + POOL_ALIGNMENT - 1) & ~(size_t)(POOL_ALIGNMENT - 1);
+  assert(size <= cache->object_size);
+
+  if (cache->free_objects == NULL && grow_pool(cache) < 0)
+    return NULL;
+
+  object = cache->free_objects;
+  cache->free_objects = object->next;
+
+  memset(object, 0, size);
+
+  return object;
+}
+
+void
+memory_pool_destroy(enum MemoryPoolType type,
+                    void               *mem)
+{
+  struct MemoryPoolObject *object = NULL;
+
+  assert(type < MEMORY_POOL_MAX);
+
+  if (mem == NULL)
+    return;
+
+  object = (struct MemoryPoolObject *)mem;
+  object->next = pool_caches[type].free_objects;
+  pool_caches[type].free_objects = object;
+}
+
+/* frees all the slabs: the objects of every thread are gone */
+void
+memory_pool_cleanup(void)
+{
+  struct MemorySlab *slab = NULL;
+
+  pthread_mutex_lock(&slabs_mutex);
+  while ((slab = slabs) != NULL) {
+    slabs = slab->next;
+    free(slab);
+  }
+  pthread_mutex_unlock(&slabs_mutex);
+
+  memset(pool_caches, 0, sizeof(pool_caches));
+}
+
 /*
  * vim: expandtab shiftwidth=2 tabstop=2:
  */
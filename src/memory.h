@@ -19,6 +19,29 @@ void *memory_resize(void *ptr, size_t size);
 
 void memory_destroy(void *mem);
 
+/*
+ * pools of fixed size objects, for the ones created and destroyed on every
+ * connection or request. A pool always hands out objects of the same size,
+ * zeroed like memory_create does.
+ */
+enum MemoryPoolType {
+  MEMORY_POOL_TCP_CONNECTION = 0,
+  MEMORY_POOL_HTTP_CONNECTION,
+  MEMORY_POOL_HTTP_REQUEST_QUEUE,
+  MEMORY_POOL_HTTP_REQUEST,
+  MEMORY_POOL_HTTP_REQUEST_ARENA,
+  MEMORY_POOL_HTTP_RESPONSE,
+  MEMORY_POOL_HTTP_RESPONSE_CHUNK,
+  MEMORY_POOL_ASYNC_CONTEXT,
+  MEMORY_POOL_MAX,
+};
+
+void *memory_pool_create(enum MemoryPoolType type, size_t size);
+
+void memory_pool_destroy(enum MemoryPoolType type, void *mem);
+
+void memory_pool_cleanup(void);
+
 #endif  /* MEMORY_H */
 
 /*
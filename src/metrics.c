@@ -0,0 +1,489 @@
+/*
+ * metrics.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "rapp/rapp_httprequest.h"
+#include "rapp/rapp_httpresponse.h"
+
+#include "container.h"
+#include "logger.h"
+#include "memory.h"
+#include "metrics.h"
+
+#define CACHE_LINE_SIZE 64
+
+#define TEXT_CHUNK_SIZE 4096
+
+/*
+ * Every thread attached has a shard of its own, where it counts without
+ * locks or atomic read-modify-writes: the shards are only merged when the
+ * metrics are read. The padding keeps the shards of different threads
+ * off each other's cache lines.
+ * The latencies go into log-linear histograms: exact up to 4us, then 4
+ * buckets for every power of 2, so the error is within 25%.
+ */
+struct MetricsHistogram {
+  uint64_t buckets[METRICS_BUCKETS];
+  uint64_t sum;
+};
+
+struct MetricsShard {
+  char padding[CACHE_LINE_SIZE];
+
+  uint64_t counters[METRICS_COUNTER_MAX];
+  struct MetricsHistogram routes[METRICS_MAX_ROUTES];
+
+  struct Metrics *metrics;
+  struct MetricsShard *next;
+
+  char padding_end[CACHE_LINE_SIZE];
+};
+
+/* the shards and the routes are added under the lock */
+struct Metrics {
+  pthread_mutex_t lock;
+
+  struct MetricsShard *shards;
+
+  char *routes[METRICS_MAX_ROUTES];
+  unsigned routes_num;
+
+  struct Logger *logger;
+};
+
+static __thread struct MetricsShard *thread_shard;
+
+static const struct {
+  const char *name;
+  const char *type;
+  const char *help;
+} counters_info[METRICS_COUNTER_MAX] = {
+  [METRICS_ACCEPTS] = {"rapp_accepts_total", "counter", "Connections accepted."},
+  [METRICS_CONNECTIONS] = {"rapp_connections", "gauge", "Connections open."},
+  [METRICS_REQUESTS] = {"rapp_requests_total", "counter", "Requests received."},
+  [METRICS_PARSE_ERRORS] = {"rapp_parse_errors_total", "counter", "Requests that couldn't be parsed."},
+  [METRICS_BYTES_IN] = {"rapp_received_bytes_total", "counter", "Bytes received."},
+  [METRICS_BYTES_OUT] = {"rapp_sent_bytes_total", "counter", "Bytes sent."},
+};
+
+
+struct Metrics *
+metrics_new(struct Logger *logger)
+{
+  struct Metrics *metrics = NULL;
+  int err = 0;
+
+  assert(logger != NULL);
+
+  if ((metrics = memory_create(sizeof(struct Metrics))) == NULL) {
+    LOGGER_PERROR(logger, "memory_create");
+    return NULL;
+  }
+
+  if ((err = pthread_mutex_init(&(metrics->lock), NULL)) != 0) {
+    logger_trace(logger, LOG_ERROR, "metrics", "pthread_mutex_init: %s", strerror(err));
+    memory_destroy(metrics);
+    return NULL;
+  }
+
+  if ((metrics->routes[0] = memory_strdup("default")) == NULL) {
+    LOGGER_PERROR(logger, "memory_strdup");
+    pthread_mutex_destroy(&(metrics->lock));
+    memory_destroy(metrics);
+    return NULL;
+  }
+
+  metrics->routes_num = 1;
+  metrics->logger = logger;
+
+  return metrics;
+}
+
+/* the threads attached must be done with it */
+void
+metrics_destroy(struct Metrics *metrics)
+{
+  struct MetricsShard *shard = NULL;
+  unsigned i = 0;
+
+  assert(metrics != NULL);
+
+  if (thread_shard != NULL && thread_shard->metrics == metrics)
+    thread_shard = NULL;
+
+  while ((shard = metrics->shards) != NULL) {
+    metrics->shards = shard->next;
+    memory_destroy(shard);
+  }
+
+  for (i = 0; i < metrics->routes_num; i++)
+    memory_destroy(metrics->routes[i]);
+
+  pthread_mutex_destroy(&(metrics->lock));
+  memory_destroy(metrics);
+}
+
+/* returns the route to observe, 0 when there's no room left */
+unsigned
+metrics_add_route(struct Metrics *metrics,
+                  const char     *label)
+{
+  unsigned route = 0;
+
+  assert(metrics != NULL);
+  assert(label != NULL);
+
+  pthread_mutex_lock(&(metrics->lock));
+
+  if (metrics->routes_num == METRICS_MAX_ROUTES) {
+    logger_trace(metrics->logger, LOG_WARNING, "metrics", "too many routes, %s is counted as default", label);
+  }
+  else if ((metrics->routes[metrics->routes_num] = memory_strdup(label)) == NULL) {
+    LOGGER_PERROR(metrics->logger, "memory_strdup");
+  }
+  else {
+    route = metrics->routes_num++;
+  }
+
+  pthread_mutex_unlock(&(metrics->lock));
+
+  return route;
+}
+
+/* gives the calling thread a shard of its own */
+int
+metrics_attach_thread(struct Metrics *metrics)
+{
+  struct MetricsShard *shard = NULL;
+
+  assert(metrics != NULL);
+
+  if ((shard = memory_create(sizeof(struct MetricsShard))) == NULL) {
+    LOGGER_PERROR(metrics->logger, "memory_create");
+    return -1;
+  }
+
+  shard->metrics = metrics;
+
+  pthread_mutex_lock(&(metrics->lock));
+  shard->next = metrics->shards;
+  metrics->shards = shard;
+  pthread_mutex_unlock(&(metrics->lock));
+
+  thread_shard = shard;
+
+  return 0;
+}
+
+/* what the thread counted stays in the metrics */
+void
+metrics_detach_thread(void)
+{
+  thread_shard = NULL;
+}
+
+int
+metrics_is_enabled(void)
+{
+  return thread_shard != NULL;
+}
+
+/* the shard is written by its thread alone, and read by anyone */
+static inline void
+shard_add(uint64_t *value,
+          uint64_t  n)
+{
+  __atomic_store_n(value, *value + n, __ATOMIC_RELAXED);
+}
+
+void
+metrics_count(enum MetricsCounter counter,
+              int64_t             n)
+{
+  assert(counter < METRICS_COUNTER_MAX);
+
+  if (thread_shard != NULL)
+    shard_add(&(thread_shard->counters[counter]), n);
+}
+
+/* microseconds, for metrics_observe_route */
+uint64_t
+metrics_clock(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/* start is taken from metrics_clock */
+void
+metrics_observe_route(unsigned route,
+                      uint64_t start)
+{
+  struct MetricsHistogram *histogram = NULL;
+  uint64_t usec = 0;
+
+  if (thread_shard == NULL)
+    return;
+
+  usec = metrics_clock() - start;
+  histogram = &(thread_shard->routes[route < METRICS_MAX_ROUTES ? route : 0]);
+
+  shard_add(&(histogram->buckets[metrics_bucket(usec)]), 1);
+  shard_add(&(histogram->sum), usec);
+}
+
+unsigned
+metrics_bucket(uint64_t usec)
+{
+  unsigned msb = 0;
+
+  if (usec < 4)
+    return usec;
+
+  msb = 63 - __builtin_clzll(usec);
+  if (msb > 31)
+    return METRICS_BUCKETS - 1;
+
+  return 4 + (msb - 2) * 4 + ((usec >> (msb - 2)) & 3);
+}
+
+/* the largest value in the bucket */
+uint64_t
+metrics_bucket_bound(unsigned bucket)
+{
+  unsigned msb = 0;
+
+  assert(bucket < METRICS_BUCKETS);
+
+  if (bucket < 4)
+    return bucket;
+
+  msb = (bucket - 4) / 4 + 2;
+
+  return ((uint64_t)(4 + (bucket - 4) % 4 + 1) << (msb - 2)) - 1;
+}
+
+struct MetricsText {
+  char *data;
+  size_t length;
+  size_t size;
+  int failed;
+};
+
+static void
+text_printf(struct MetricsText *text,
+            const char         *fmt,
+            ...)
+{
+  va_list args;
+  char *data = NULL;
+  int ret = 0;
+
+  if (text->failed)
+    return;
+
+  for (;;) {
+    va_start(args, fmt);
+    ret = vsnprintf(text->data + text->length, text->size - text->length, fmt, args);
+    va_end(args);
+
+    if (ret < 0) {
+      text->failed = 1;
+      return;
+    }
+
+    if (text->length + ret < text->size)
+      break;
+
+    if ((data = memory_resize(text->data, text->size + ret + TEXT_CHUNK_SIZE)) == NULL) {
+      text->failed = 1;
+      return;
+    }
+    text->data = data;
+    text->size += ret + TEXT_CHUNK_SIZE;
+  }
+
+  text->length += ret;
+}
+
+/* the label between quotes, escaped */
+static void
+text_label(struct MetricsText *text,
+           const char         *label)
+{
+  for (; *label != '\0'; label++) {
+    if (*label == '"' || *label == '\\')
+      text_printf(text, "\\%c", *label);
+    else if (*label == '\n')
+      text_printf(text, "\\n");
+    else
+      text_printf(text, "%c", *label);
+  }
+}
+
+static void
+format_histogram(struct MetricsText            *text,
+                 const char                    *route,
+                 const struct MetricsHistogram *histogram)
+{
+  uint64_t count = 0;
+  unsigned i = 0;
+
+  /* the empty buckets add nothing */
+  for (i = 0; i < METRICS_BUCKETS; i++) {
+    if (histogram->buckets[i] == 0)
+      continue;
+
+    count += histogram->buckets[i];
+    text_printf(text, "rapp_handler_duration_seconds_bucket{route=\"");
+    text_label(text, route);
+    text_printf(text, "\",le=\"%.6f\"} %llu\n", metrics_bucket_bound(i) / 1e6, (unsigned long long)count);
+  }
+
+  text_printf(text, "rapp_handler_duration_seconds_bucket{route=\"");
+  text_label(text, route);
+  text_printf(text, "\",le=\"+Inf\"} %llu\n", (unsigned long long)count);
+
+  text_printf(text, "rapp_handler_duration_seconds_sum{route=\"");
+  text_label(text, route);
+  text_printf(text, "\"} %.6f\n", histogram->sum / 1e6);
+
+  text_printf(text, "rapp_handler_duration_seconds_count{route=\"");
+  text_label(text, route);
+  text_printf(text, "\"} %llu\n", (unsigned long long)count);
+}
+
+/*
+ * the shards merged, in the Prometheus text format. The text is allocated
+ * with memory_create, NULL on errors.
+ */
+char *
+metrics_format(struct Metrics *metrics,
+               size_t         *length)
+{
+  struct MetricsText text = {NULL, 0, 0, 0};
+  uint64_t counters[METRICS_COUNTER_MAX];
+  struct MetricsHistogram *routes = NULL;
+  struct MetricsShard *shard = NULL;
+  unsigned i = 0;
+  unsigned j = 0;
+
+  assert(metrics != NULL);
+  assert(length != NULL);
+
+  if ((routes = memory_create(sizeof(struct MetricsHistogram) * METRICS_MAX_ROUTES)) == NULL) {
+    LOGGER_PERROR(metrics->logger, "memory_create");
+    return NULL;
+  }
+
+  memset(counters, 0, sizeof(counters));
+
+  pthread_mutex_lock(&(metrics->lock));
+
+  for (shard = metrics->shards; shard != NULL; shard = shard->next) {
+    for (i = 0; i < METRICS_COUNTER_MAX; i++)
+      counters[i] += __atomic_load_n(&(shard->counters[i]), __ATOMIC_RELAXED);
+
+    for (i = 0; i < metrics->routes_num; i++) {
+      for (j = 0; j < METRICS_BUCKETS; j++)
+        routes[i].buckets[j] += __atomic_load_n(&(shard->routes[i].buckets[j]), __ATOMIC_RELAXED);
+      routes[i].sum += __atomic_load_n(&(shard->routes[i].sum), __ATOMIC_RELAXED);
+    }
+  }
+
+  for (i = 0; i < METRICS_COUNTER_MAX; i++) {
+    text_printf(&text, "# HELP %s %s\n", counters_info[i].name, counters_info[i].help);
+    text_printf(&text, "# TYPE %s %s\n", counters_info[i].name, counters_info[i].type);
+    /* the gauges go down too: their sum is signed */
+    text_printf(&text, "%s %lld\n", counters_info[i].name, (long long)counters[i]);
+  }
+
+  text_printf(&text, "# HELP rapp_handler_duration_seconds Time spent in the handlers of a route, until they return.\n");
+  text_printf(&text, "# TYPE rapp_handler_duration_seconds histogram\n");
+  for (i = 0; i < metrics->routes_num; i++)
+    format_histogram(&text, metrics->routes[i], &(routes[i]));
+
+  pthread_mutex_unlock(&(metrics->lock));
+
+  memory_destroy(routes);
+
+  if (text.failed) {
+    LOGGER_PERROR(metrics->logger, "memory_resize");
+    if (text.data != NULL)
+      memory_destroy(text.data);
+    return NULL;
+  }
+
+  *length = text.length;
+
+  return text.data;
+}
+
+static int
+metrics_serve(struct RappContainer *handle,
+              struct HTTPRequest   *request,
+              struct HTTPResponse  *response)
+{
+  struct Metrics *metrics = (struct Metrics *)handle;
+  char *text = NULL;
+  size_t length = 0;
+  int ret = -1;
+
+  assert(handle != NULL);
+
+  if ((text = metrics_format(metrics, &length)) == NULL)
+    return -1;
+
+  if (http_response_write_status_line_by_code(response, 200) >= 0 &&
+      http_response_write_header(response, "Content-Type", "text/plain; version=0.0.4") >= 0 &&
+      http_response_write_header(response, "Content-Length", rapp_request_sprintf(request, "%zu", length)) >= 0 &&
+      http_response_end_headers(response) >= 0 &&
+      http_response_append_data(response, text, length) >= 0)
+    ret = 0;
+
+  memory_destroy(text);
+
+  return ret;
+}
+
+static int
+metrics_init(struct RappContainer *handle,
+             struct RappConfig    *config)
+{
+  return 0;
+}
+
+/* the metrics are owned by the caller */
+static int
+metrics_container_destroy(struct RappContainer *handle)
+{
+  return 0;
+}
+
+/* serves the metrics wherever it's bound */
+struct Container *
+metrics_new_container(struct Metrics *metrics)
+{
+  assert(metrics != NULL);
+
+  return container_new_custom(metrics->logger, "metrics", metrics_init, metrics_serve, metrics_container_destroy, metrics);
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
@@ -0,0 +1,57 @@
+/*
+ * metrics.h - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+enum MetricsCounter {
+  METRICS_ACCEPTS,
+  METRICS_CONNECTIONS,    /* the open ones: added and taken away */
+  METRICS_REQUESTS,
+  METRICS_PARSE_ERRORS,
+  METRICS_BYTES_IN,
+  METRICS_BYTES_OUT,
+  METRICS_COUNTER_MAX
+};
+
+/* route 0 takes the requests of the routes not added */
+#define METRICS_MAX_ROUTES 32
+
+/* 4 buckets for every power of 2 of microseconds, up to ~71 minutes */
+#define METRICS_BUCKETS 124
+
+struct Logger;
+struct Container;
+struct Metrics;
+
+struct Metrics *metrics_new(struct Logger *logger);
+void metrics_destroy(struct Metrics *metrics);
+
+unsigned metrics_add_route(struct Metrics *metrics, const char *label);
+
+int metrics_attach_thread(struct Metrics *metrics);
+void metrics_detach_thread(void);
+
+/* for the calling thread: nothing is counted if it isn't attached */
+int metrics_is_enabled(void);
+void metrics_count(enum MetricsCounter counter, int64_t n);
+uint64_t metrics_clock(void);
+void metrics_observe_route(unsigned route, uint64_t start);
+
+unsigned metrics_bucket(uint64_t usec);
+uint64_t metrics_bucket_bound(unsigned bucket);
+
+char *metrics_format(struct Metrics *metrics, size_t *length);
+
+struct Container *metrics_new_container(struct Metrics *metrics);
+
+#endif /* METRICS_H */
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
@@ -0,0 +1,164 @@
+/*
+ * offloadpool.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include <pthread.h>
+
+#include "logger.h"
+#include "memory.h"
+#include "offloadpool.h"
+
+STAILQ_HEAD(OffloadJobQueue, OffloadJob);
+
+/*
+ * The threads share one queue of jobs, fed by all the workers: what
+ * the jobs do may block, so this is not on any path of the event loops.
+ * Only the completions go back to the loops, through their posts.
+ */
+struct OffloadPool {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  struct OffloadJobQueue jobs;
+  int stopping;
+
+  pthread_t *threads;
+  unsigned threads_num;
+
+  struct Logger *logger;
+};
+
+static void *
+offload_pool_run(void *data)
+{
+  struct OffloadPool *pool = NULL;
+  struct OffloadJob *job = NULL;
+
+  pool = (struct OffloadPool *)data;
+
+  pthread_mutex_lock(&(pool->lock));
+  for (;;) {
+    while (STAILQ_EMPTY(&(pool->jobs)) && !pool->stopping)
+      pthread_cond_wait(&(pool->cond), &(pool->lock));
+
+    /* the queued jobs are done before stopping */
+    if ((job = STAILQ_FIRST(&(pool->jobs))) == NULL)
+      break;
+
+    STAILQ_REMOVE_HEAD(&(pool->jobs), entries);
+    pthread_mutex_unlock(&(pool->lock));
+
+    job->work(job);
+    event_loop_post(job->eloop, &(job->done));
+
+    pthread_mutex_lock(&(pool->lock));
+  }
+  pthread_mutex_unlock(&(pool->lock));
+
+  return NULL;
+}
+
+static void
+offload_pool_stop(struct OffloadPool *pool)
+{
+  unsigned i = 0;
+
+  pthread_mutex_lock(&(pool->lock));
+  pool->stopping = 1;
+  pthread_cond_broadcast(&(pool->cond));
+  pthread_mutex_unlock(&(pool->lock));
+
+  for (i = 0; i < pool->threads_num; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  pool->threads_num = 0;
+}
+
+struct OffloadPool *
+offload_pool_new(struct Logger *logger,
+                 unsigned       threads)
+{
+  struct OffloadPool *pool = NULL;
+  int err = 0;
+
+  assert(threads > 0);
+
+  if ((pool = memory_create(sizeof(struct OffloadPool))) == NULL) {
+    LOGGER_PERROR(logger, "memory_create");
+    return NULL;
+  }
+
+  if ((pool->threads = memory_create(threads * sizeof(pthread_t))) == NULL) {
+    LOGGER_PERROR(logger, "memory_create");
+    memory_destroy(pool);
+    return NULL;
+  }
+
+  pthread_mutex_init(&(pool->lock), NULL);
+  pthread_cond_init(&(pool->cond), NULL);
+  STAILQ_INIT(&(pool->jobs));
+  pool->logger = logger;
+
+  for (pool->threads_num = 0; pool->threads_num < threads; pool->threads_num++) {
+    if ((err = pthread_create(&(pool->threads[pool->threads_num]), NULL, offload_pool_run, pool)) != 0) {
+      logger_trace(logger, LOG_ERROR, "offload", "pthread_create: %s", strerror(err));
+      offload_pool_destroy(pool);
+      return NULL;
+    }
+  }
+
+  return pool;
+}
+
+/* the jobs already submitted are run first, and their posts sent */
+void
+offload_pool_destroy(struct OffloadPool *pool)
+{
+  assert(pool != NULL);
+
+  offload_pool_stop(pool);
+
+  pthread_cond_destroy(&(pool->cond));
+  pthread_mutex_destroy(&(pool->lock));
+
+  memory_destroy(pool->threads);
+  memory_destroy(pool);
+}
+
+/* safe to call from any thread */
+int
+offload_pool_submit(struct OffloadPool *pool,
+                    struct OffloadJob  *job)
+{
+  assert(pool != NULL);
+  assert(job != NULL);
+  assert(job->work != NULL);
+  assert(job->eloop != NULL);
+  assert(job->done.callback != NULL);
+
+  pthread_mutex_lock(&(pool->lock));
+
+  if (pool->stopping) {
+    pthread_mutex_unlock(&(pool->lock));
+    logger_trace(pool->logger, LOG_ERROR, "offload", "submit to a pool stopping");
+    return -1;
+  }
+
+  STAILQ_INSERT_TAIL(&(pool->jobs), job, entries);
+  pthread_cond_signal(&(pool->cond));
+
+  pthread_mutex_unlock(&(pool->lock));
+
+  return 0;
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
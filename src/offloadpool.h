@@ -0,0 +1,43 @@
+/*
+ * offloadpool.h - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#ifndef OFFLOADPOOL_H
+#define OFFLOADPOOL_H
+
+#include <sys/queue.h>
+
+#include "eloop.h"
+
+struct Logger;
+struct OffloadPool;
+struct OffloadJob;
+
+typedef void (*OffloadWorkCallback)(struct OffloadJob *job);
+
+/*
+ * the job is run by one of the threads of the pool, then its done post is
+ * posted on its event loop. The job belongs to the caller: it must stay
+ * valid until done runs.
+ */
+struct OffloadJob {
+  OffloadWorkCallback work;
+  struct ELoop *eloop;
+  struct ELoopPost done;
+
+  STAILQ_ENTRY(OffloadJob) entries;
+};
+
+struct OffloadPool *offload_pool_new(struct Logger *logger, unsigned threads);
+void offload_pool_destroy(struct OffloadPool *pool);
+
+int offload_pool_submit(struct OffloadPool *pool, struct OffloadJob *job);
+
+#endif /* OFFLOADPOOL_H */
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
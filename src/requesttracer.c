@@ -0,0 +1,162 @@
+/*
+ * requesttracer.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <assert.h>
+
+#include <http_parser.h>
+
+#include "httprequest.h"
+#include "logger.h"
+#include "memory.h"
+#include "requesttracer.h"
+
+
+/*
+ * One request out of sample gets the time of its phases taken, and it's
+ * logged with them if it took longer than the threshold. The others cost
+ * a counter. A tracer belongs to a single thread.
+ */
+struct RequestTracer {
+  uint64_t threshold;
+  unsigned sample;
+  unsigned until_sample;
+
+  struct Logger *logger;
+};
+
+static const char *phase_names[REQUEST_PHASE_MAX] = {
+  [REQUEST_PHASE_PARSED] = "parse",
+  [REQUEST_PHASE_ROUTED] = "route",
+  [REQUEST_PHASE_SERVED] = "serve",
+  [REQUEST_PHASE_WRITTEN] = "write",
+};
+
+
+/* threshold is in milliseconds, sample is at least 1 */
+struct RequestTracer *
+request_tracer_new(struct Logger *logger,
+                   unsigned       threshold,
+                   unsigned       sample)
+{
+  struct RequestTracer *tracer = NULL;
+
+  assert(logger != NULL);
+  assert(sample > 0);
+
+  if ((tracer = memory_create(sizeof(struct RequestTracer))) == NULL) {
+    LOGGER_PERROR(logger, "memory_create");
+    return NULL;
+  }
+
+  tracer->threshold = (uint64_t)threshold * 1000000;
+  tracer->sample = sample;
+  tracer->until_sample = 1;
+  tracer->logger = logger;
+
+  return tracer;
+}
+
+void
+request_tracer_destroy(struct RequestTracer *tracer)
+{
+  assert(tracer != NULL);
+
+  memory_destroy(tracer);
+}
+
+uint64_t
+request_tracer_clock(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*
+ * read_at is when the first bytes of the request were read, 0 if not
+ * known. A NULL request is one that couldn't be parsed: it isn't traced.
+ */
+void
+request_tracer_begin(struct RequestTracer *tracer,
+                     struct RequestTrace  *trace,
+                     struct HTTPRequest   *request,
+                     uint64_t              read_at)
+{
+  struct MemoryRange range;
+  size_t length = 0;
+
+  assert(tracer != NULL);
+  assert(trace != NULL);
+
+  trace->sampled = 0;
+
+  if (request == NULL || --tracer->until_sample > 0)
+    return;
+
+  tracer->until_sample = tracer->sample;
+
+  memset(trace->at, 0, sizeof(trace->at));
+  trace->sampled = 1;
+  trace->at[REQUEST_PHASE_PARSED] = request_tracer_clock();
+  trace->at[REQUEST_PHASE_READ] = read_at != 0 ? read_at : trace->at[REQUEST_PHASE_PARSED];
+  trace->method = http_request_get_method(request);
+
+  http_request_get_url_range(request, &range);
+  length = range.length < sizeof(trace->url) - 1 ? range.length : sizeof(trace->url) - 1;
+  memcpy(trace->url, &(http_request_get_headers_buffer(request)[range.offset]), length);
+  trace->url[length] = '\0';
+  trace->url_length = range.length;
+}
+
+/* the phases not reached take no time */
+void
+request_tracer_end(struct RequestTracer *tracer,
+                   struct RequestTrace  *trace)
+{
+  char phases[128];
+  size_t length = 0;
+  uint64_t last = 0;
+  unsigned i = 0;
+
+  assert(tracer != NULL);
+  assert(trace != NULL);
+
+  if (!trace->sampled)
+    return;
+
+  trace->sampled = 0;
+  trace->at[REQUEST_PHASE_WRITTEN] = request_tracer_clock();
+
+  if (trace->at[REQUEST_PHASE_WRITTEN] - trace->at[REQUEST_PHASE_READ] < tracer->threshold)
+    return;
+
+  last = trace->at[REQUEST_PHASE_READ];
+  for (i = REQUEST_PHASE_READ + 1; i < REQUEST_PHASE_MAX; i++) {
+    if (trace->at[i] == 0)
+      trace->at[i] = last;
+
+    length += snprintf(&(phases[length]), sizeof(phases) - length, " %s=%.3fms",
+                       phase_names[i], (trace->at[i] - last) / 1e6);
+    last = trace->at[i];
+  }
+
+  logger_trace(tracer->logger, LOG_WARNING, "slowrequest", "%s %s%s took %.3fms:%s",
+               http_method_str(trace->method), trace->url,
+               trace->url_length >= sizeof(trace->url) ? "..." : "",
+               (trace->at[REQUEST_PHASE_WRITTEN] - trace->at[REQUEST_PHASE_READ]) / 1e6, phases);
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
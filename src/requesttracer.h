@@ -0,0 +1,59 @@
+/*
+ * requesttracer.h - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#ifndef REQUESTTRACER_H
+#define REQUESTTRACER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* the phases a request goes through, each ends when the next begins */
+enum RequestPhase {
+  REQUEST_PHASE_READ,     /* its first bytes are read */
+  REQUEST_PHASE_PARSED,   /* it's parsed, after the requests before it */
+  REQUEST_PHASE_ROUTED,   /* its container is found */
+  REQUEST_PHASE_SERVED,   /* the handler returns, or completes it if async */
+  REQUEST_PHASE_WRITTEN,  /* its response is all sent */
+  REQUEST_PHASE_MAX
+};
+
+#define REQUEST_TRACE_URL_LEN 64
+
+/* nanoseconds on the monotonic clock, only for the sampled requests */
+struct RequestTrace {
+  int sampled;
+  uint64_t at[REQUEST_PHASE_MAX];
+
+  int method;
+  size_t url_length;    /* of the whole url, only the beginning is kept */
+  char url[REQUEST_TRACE_URL_LEN];
+};
+
+struct Logger;
+struct HTTPRequest;
+struct RequestTracer;
+
+struct RequestTracer *request_tracer_new(struct Logger *logger, unsigned threshold, unsigned sample);
+void request_tracer_destroy(struct RequestTracer *tracer);
+
+uint64_t request_tracer_clock(void);
+
+void request_tracer_begin(struct RequestTracer *tracer, struct RequestTrace *trace, struct HTTPRequest *request, uint64_t read_at);
+void request_tracer_end(struct RequestTracer *tracer, struct RequestTrace *trace);
+
+static inline void
+request_trace_mark(struct RequestTrace *trace,
+                   enum RequestPhase    phase)
+{
+  if (trace->sampled)
+    trace->at[phase] = request_tracer_clock();
+}
+
+#endif /* REQUESTTRACER_H */
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
@@ -14,6 +14,7 @@
 
 #include <sys/socket.h>
 #include <sys/sendfile.h>
+#include <sys/uio.h>
 
 #include "eloop.h"
 #include "logger.h"
@@ -30,6 +31,16 @@ struct TcpConnection
   TcpConnectionWriteCallback write_callback;
   TcpConnectionCloseCallback close_callback;
   const void *data;
+
+  int read_paused;
+  int write_watched;
+
+  /* edge triggered mode: callbacks are repeated until the socket is drained */
+  int edge_triggered;
+  int can_read;
+  int can_write;
+  unsigned long reads;
+  unsigned long writes;
 };
 
 struct TcpConnection *
@@ -43,8 +54,8 @@ tcp_connection_with_fd(int            fd,
   assert(logger != NULL);
   assert(eloop != NULL);
 
-  if ((connection = memory_create(sizeof(struct TcpConnection))) == NULL) {
-    LOGGER_PERROR(logger, "memory_create");
+  if ((connection = memory_pool_create(MEMORY_POOL_TCP_CONNECTION, sizeof(struct TcpConnection))) == NULL) {
+    LOGGER_PERROR(logger, "memory_pool_create");
     return NULL;
   }
 
@@ -62,7 +73,7 @@ tcp_connection_destroy(struct TcpConnection *connection)
 
   if (connection->fd != -1)
     tcp_connection_close(connection);
-  memory_destroy(connection);
+  memory_pool_destroy(MEMORY_POOL_TCP_CONNECTION, connection);
 }
 
 void
@@ -84,17 +95,57 @@ on_ready_read(int         fd,
               const void *data)
 {
   struct TcpConnection *connection = NULL;
+  unsigned long reads = 0;
 
   assert(data != NULL);
 
   connection = (struct TcpConnection *)data;
 
-  if (connection->read_callback)
+  if (connection->read_paused)
+    return 0;
+
+  if (!connection->edge_triggered) {
+    if (connection->read_callback)
+      connection->read_callback(connection, connection->data);
+    return 0;
+  }
+
+  /*
+   * call back until a read hits EAGAIN, the connection is closed
+   * or the callback stops reading.
+   */
+  connection->can_read = 1;
+  while (connection->can_read && !connection->read_paused && connection->fd >= 0 && connection->read_callback) {
+    reads = connection->reads;
     connection->read_callback(connection, connection->data);
+    if (connection->reads == reads)
+      break;
+  }
 
   return 0;
 }
 
+static void
+dispatch_write(struct TcpConnection *connection)
+{
+  unsigned long writes = 0;
+
+  if (!connection->edge_triggered) {
+    if (connection->write_callback)
+      connection->write_callback(connection, connection->data);
+    return;
+  }
+
+  /* same as reads: until EAGAIN, close or nothing left to write */
+  connection->can_write = 1;
+  while (connection->can_write && connection->fd >= 0 && connection->write_callback) {
+    writes = connection->writes;
+    connection->write_callback(connection, connection->data);
+    if (connection->writes == writes)
+      break;
+  }
+}
+
 static int
 on_ready_write(int         fd,
                const void *data)
@@ -105,8 +156,7 @@ on_ready_write(int         fd,
 
   connection = (struct TcpConnection *)data;
 
-  if (connection->write_callback)
-    connection->write_callback(connection, connection->data);
+  dispatch_write(connection);
 
   return 0;
 }
@@ -146,6 +196,7 @@ tcp_connection_set_callbacks(struct TcpConnection      *connection,
     if (event_loop_add_fd_watch(connection->eloop, connection->fd, ELOOP_CALLBACK_WRITE, on_ready_write, connection) < 0)
       return -1;
     connection->write_callback = write_callback;
+    connection->write_watched = 1;
   }
 
   if (close_callback != NULL) {
@@ -156,17 +207,98 @@ tcp_connection_set_callbacks(struct TcpConnection      *connection,
 
   connection->data = data;
 
+  if (connection->edge_triggered && event_loop_set_fd_edge_triggered(connection->eloop, connection->fd, 1) < 0)
+    return -1;
+
   return 0;
 }
 
+/* must be called before tcp_connection_set_callbacks */
+void
+tcp_connection_set_edge_triggered(struct TcpConnection *connection,
+                                  int                   edge_triggered)
+{
+  assert(connection != NULL);
+
+  connection->edge_triggered = edge_triggered;
+}
+
+/*
+ * stops watching for incoming data until resumed: the data keeps waiting
+ * in the socket, reported again as soon as reading is resumed.
+ */
+int
+tcp_connection_set_read_paused(struct TcpConnection *connection,
+                               int                   paused)
+{
+  assert(connection != NULL);
+
+  if (connection->fd < 0 || connection->read_callback == NULL || connection->read_paused == paused)
+    return 0;
+
+  connection->read_paused = paused;
+
+  if (paused)
+    return event_loop_remove_fd_watch(connection->eloop, connection->fd, ELOOP_CALLBACK_READ);
+
+  return event_loop_add_fd_watch(connection->eloop, connection->fd, ELOOP_CALLBACK_READ, on_ready_read, connection);
+}
+
+/*
+ * in level triggered mode a writable socket is reported on every loop
+ * iteration: the write watch is kept only while there's data waiting for
+ * room in the socket. In edge triggered mode it's always kept.
+ */
+int
+tcp_connection_set_write_pending(struct TcpConnection *connection,
+                                 int                   pending)
+{
+  assert(connection != NULL);
+
+  if (connection->edge_triggered || connection->fd < 0 || connection->write_callback == NULL)
+    return 0;
+
+  if (connection->write_watched == pending)
+    return 0;
+
+  connection->write_watched = pending;
+
+  if (!pending)
+    return event_loop_remove_fd_watch(connection->eloop, connection->fd, ELOOP_CALLBACK_WRITE);
+
+  return event_loop_add_fd_watch(connection->eloop, connection->fd, ELOOP_CALLBACK_WRITE, on_ready_write, connection);
+}
+
+/*
+ * invokes the write callback right away, as if the socket became writable:
+ * in edge triggered mode there won't be another notification for data
+ * queued after the socket became writable.
+ */
+void
+tcp_connection_try_write(struct TcpConnection *connection)
+{
+  assert(connection != NULL);
+
+  if (connection->fd >= 0)
+    dispatch_write(connection);
+}
+
 ssize_t
 tcp_connection_read_data(struct TcpConnection *connection,
                          void                 *data,
                          size_t                length)
 {
+  ssize_t ret = -1;
+
   assert(connection != NULL);
 
-  return recv(connection->fd, data, length, 0);
+  connection->reads++;
+
+  /* EAGAIN, EOF or an error: either way nothing more to read */
+  if ((ret = recv(connection->fd, data, length, 0)) <= 0)
+    connection->can_read = 0;
+
+  return ret;
 }
 
 ssize_t
@@ -174,20 +306,59 @@ tcp_connection_write_data(struct TcpConnection *connection,
                           const void           *data,
                           size_t                length)
 {
+  ssize_t ret = -1;
+
+  assert(connection != NULL);
+
+  connection->writes++;
+
+  if ((ret = send(connection->fd, data, length, MSG_NOSIGNAL)) < 0)
+    connection->can_write = 0;
+
+  return ret;
+}
+
+/* same as writev(2), without raising SIGPIPE */
+ssize_t
+tcp_connection_writev(struct TcpConnection *connection,
+                      const struct iovec   *iov,
+                      int                   iovcnt)
+{
+  struct msghdr msg;
+  ssize_t ret = -1;
+
   assert(connection != NULL);
+  assert(iov != NULL);
+
+  memset(&msg, 0, sizeof(struct msghdr));
+  msg.msg_iov = (struct iovec *)iov;
+  msg.msg_iovlen = iovcnt;
+
+  connection->writes++;
 
-  return send(connection->fd, data, length, MSG_NOSIGNAL);
+  if ((ret = sendmsg(connection->fd, &msg, MSG_NOSIGNAL)) < 0)
+    connection->can_write = 0;
+
+  return ret;
 }
 
 ssize_t
 tcp_connection_sendfile(struct TcpConnection *connection,
                         int                   file_fd,
+                        off_t                *offset,
                         size_t                length)
 {
+  ssize_t ret = -1;
+
   assert(connection != NULL);
   assert(file_fd >= 0);
 
-  return sendfile(connection->fd, file_fd, NULL, length);
+  connection->writes++;
+
+  if ((ret = sendfile(connection->fd, file_fd, offset, length)) < 0)
+    connection->can_write = 0;
+
+  return ret;
 }
 /*
  * vim: expandtab shiftwidth=2 tabstop=2:
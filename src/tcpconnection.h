@@ -11,6 +11,7 @@
 struct Logger;
 struct ELoop;
 struct TcpConnection;
+struct iovec;
 
 typedef void (*TcpConnectionReadCallback)(struct TcpConnection *connection, const void *data);
 typedef void (*TcpConnectionWriteCallback)(struct TcpConnection *connection, const void *data);
@@ -23,10 +24,17 @@ void tcp_connection_close(struct TcpConnection *connection);
 
 int tcp_connection_set_callbacks(struct TcpConnection *connection, TcpConnectionReadCallback read_callback, TcpConnectionWriteCallback write_callback, TcpConnectionCloseCallback close_callback, const void *data);
 
+void tcp_connection_set_edge_triggered(struct TcpConnection *connection, int edge_triggered);
+void tcp_connection_try_write(struct TcpConnection *connection);
+
+int tcp_connection_set_read_paused(struct TcpConnection *connection, int paused);
+int tcp_connection_set_write_pending(struct TcpConnection *connection, int pending);
+
 ssize_t tcp_connection_read_data(struct TcpConnection *connection, void *data, size_t length);
 ssize_t tcp_connection_write_data(struct TcpConnection *connection, const void *data, size_t length);
+ssize_t tcp_connection_writev(struct TcpConnection *connection, const struct iovec *iov, int iovcnt);
 
-ssize_t tcp_connection_sendfile(struct TcpConnection *connection, int file_fd, size_t length);
+ssize_t tcp_connection_sendfile(struct TcpConnection *connection, int file_fd, off_t *offset, size_t length);
 
 #endif /* TCPCONNECTION_H */
 
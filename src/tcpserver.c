@@ -22,6 +22,7 @@
 #include "eloop.h"
 #include "logger.h"
 #include "memory.h"
+#include "metrics.h"
 #include "tcpconnection.h"
 #include "tcpserver.h"
 
@@ -106,6 +107,8 @@ on_incoming_connection(int         server_fd,
       return 0;
   }
 
+  metrics_count(METRICS_ACCEPTS, 1);
+
   if ((connection = tcp_connection_with_fd(client_fd, server->logger, server->eloop)) == NULL) {
     close(client_fd);
     return -1;
@@ -0,0 +1,40 @@
+#include <string.h>
+#include <rapp/rapp_version.h>
+#define VERSION "dev"
+#define GIT_SHA1 "3a67dab9732ea0bbcd2d3e36d99cd5322af83deb"
+#define GIT_TAG "-128-NOTFOUND"
+#define FULL_VERSION VERSION "." GIT_SHA1
+#define BANNER "RApp-" FULL_VERSION
+
+
+const char*
+rapp_get_version_full(void)
+{
+    return FULL_VERSION;
+}
+
+const char*
+rapp_get_version(void)
+{
+    return VERSION;
+}
+
+const char*
+rapp_get_version_sha1(void)
+{
+    return GIT_SHA1;
+}
+
+const char*
+rapp_get_version_tag(void)
+{
+    if (strcmp(GIT_TAG, "-128-NOTFOUND") == 0)
+        return "";
+    return GIT_TAG;
+}
+
+const char*
+rapp_get_banner(void)
+{
+  return BANNER;
+}
@@ -0,0 +1,244 @@
+/*
+ * worker.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include <pthread.h>
+
+#include "rapp/rapp_config.h"
+
+#include "eloop.h"
+#include "httpconnection.h"
+#include "httpserver.h"
+#include "logger.h"
+#include "memory.h"
+#include "metrics.h"
+#include "requesttracer.h"
+#include "worker.h"
+
+
+/*
+ * A worker is an event loop running on its own thread, with its own
+ * listening socket (SO_REUSEPORT lets the kernel spread the incoming
+ * connections among the workers). Everything reachable from a worker is
+ * private to its thread, except the router and the containers, which are
+ * shared and only read while serving.
+ */
+struct Worker {
+  pthread_t thread;
+  int running;
+
+  struct ELoop *eloop;
+  struct HTTPServer *http_server;
+  struct Metrics *metrics;
+  struct RequestTracer *tracer;
+
+  struct Logger *logger;
+};
+
+
+/* applies the core settings; a NULL config means defaults */
+static void
+worker_configure(struct Worker           *worker,
+                 const struct RappConfig *config)
+{
+  int edge_triggered = 0;
+  long timeout = 0;
+  long max_body_size = 0;
+  long slow_request = 0;
+  long trace_sample = 1;
+  struct HTTPConnectionTimeouts timeouts = {
+    HTTP_CONNECTION_DEFAULT_HEADER_TIMEOUT,
+    HTTP_CONNECTION_DEFAULT_BODY_TIMEOUT,
+    HTTP_CONNECTION_DEFAULT_KEEP_ALIVE_TIMEOUT,
+  };
+
+  if (config == NULL)
+    return;
+
+  if (rapp_config_get_bool(config, RAPP_CONFIG_SECTION, "edge_triggered", &edge_triggered) == 0)
+    http_server_set_edge_triggered(worker->http_server, edge_triggered);
+
+  /* seconds in the config */
+  if (rapp_config_get_int(config, RAPP_CONFIG_SECTION, "header_timeout", &timeout) == 0)
+    timeouts.header = timeout * 1000;
+  if (rapp_config_get_int(config, RAPP_CONFIG_SECTION, "body_timeout", &timeout) == 0)
+    timeouts.body = timeout * 1000;
+  if (rapp_config_get_int(config, RAPP_CONFIG_SECTION, "keepalive_timeout", &timeout) == 0)
+    timeouts.keep_alive = timeout * 1000;
+
+  http_server_set_timeouts(worker->http_server, &timeouts);
+
+  if (rapp_config_get_int(config, RAPP_CONFIG_SECTION, "max_body_size", &max_body_size) == 0)
+    http_server_set_max_body_size(worker->http_server, max_body_size);
+
+  /* without a tracer the requests just aren't traced */
+  if (rapp_config_get_int(config, RAPP_CONFIG_SECTION, "trace_sample", &trace_sample) != 0 || trace_sample < 1)
+    trace_sample = 1;
+  if (rapp_config_get_int(config, RAPP_CONFIG_SECTION, "slow_request", &slow_request) == 0 && slow_request > 0 &&
+      (worker->tracer = request_tracer_new(worker->logger, slow_request, trace_sample)) != NULL)
+    http_server_set_tracer(worker->http_server, worker->tracer);
+}
+
+struct Worker *
+worker_new(struct Logger           *logger,
+           struct HTTPRouter       *router,
+           const struct RappConfig *config)
+{
+  struct Worker *worker = NULL;
+
+  assert(logger != NULL);
+  assert(router != NULL);
+
+  if ((worker = memory_create(sizeof(struct Worker))) == NULL) {
+    LOGGER_PERROR(logger, "memory_create");
+    return NULL;
+  }
+
+  if ((worker->eloop = event_loop_new(logger)) == NULL) {
+    memory_destroy(worker);
+    return NULL;
+  }
+
+  if ((worker->http_server = http_server_new(logger, worker->eloop, router)) == NULL) {
+    event_loop_destroy(worker->eloop);
+    memory_destroy(worker);
+    return NULL;
+  }
+
+  worker->logger = logger;
+
+  worker_configure(worker, config);
+
+  return worker;
+}
+
+void
+worker_destroy(struct Worker *worker)
+{
+  assert(worker != NULL);
+
+  if (worker->running) {
+    worker_stop(worker);
+    worker_join(worker);
+  }
+
+  http_server_destroy(worker->http_server);
+  event_loop_destroy(worker->eloop);
+
+  if (worker->tracer != NULL)
+    request_tracer_destroy(worker->tracer);
+
+  memory_destroy(worker);
+}
+
+void
+worker_set_offload_pool(struct Worker      *worker,
+                        struct OffloadPool *pool)
+{
+  assert(worker != NULL);
+
+  http_server_set_offload_pool(worker->http_server, pool);
+}
+
+void
+worker_set_access_log(struct Worker    *worker,
+                      struct AccessLog *log)
+{
+  assert(worker != NULL);
+
+  http_server_set_access_log(worker->http_server, log);
+}
+
+void
+worker_set_metrics(struct Worker  *worker,
+                   struct Metrics *metrics)
+{
+  assert(worker != NULL);
+
+  worker->metrics = metrics;
+}
+
+static void *
+worker_run(void *data)
+{
+  struct Worker *worker = NULL;
+
+  assert(data != NULL);
+
+  worker = (struct Worker *)data;
+
+  /* the loop counts in a shard of its own; without one it just doesn't count */
+  if (worker->metrics != NULL)
+    metrics_attach_thread(worker->metrics);
+
+  event_loop_run(worker->eloop);
+
+  metrics_detach_thread();
+
+  return NULL;
+}
+
+int
+worker_start(struct Worker *worker,
+             const char    *host,
+             uint16_t       port)
+{
+  int err = 0;
+
+  assert(worker != NULL);
+  assert(host != NULL);
+
+  /* bind in the caller's thread, so errors are reported synchronously */
+  if (http_server_start(worker->http_server, host, port) < 0)
+    return -1;
+
+  if ((err = pthread_create(&(worker->thread), NULL, worker_run, worker)) != 0) {
+    logger_trace(worker->logger, LOG_ERROR, "worker", "pthread_create: %s", strerror(err));
+    return -1;
+  }
+
+  worker->running = 1;
+
+  return 0;
+}
+
+void
+worker_stop(struct Worker *worker)
+{
+  assert(worker != NULL);
+
+  event_loop_stop(worker->eloop);
+}
+
+int
+worker_join(struct Worker *worker)
+{
+  int err = 0;
+
+  assert(worker != NULL);
+
+  if (!worker->running)
+    return 0;
+
+  if ((err = pthread_join(worker->thread, NULL)) != 0) {
+    logger_trace(worker->logger, LOG_ERROR, "worker", "pthread_join: %s", strerror(err));
+    return -1;
+  }
+
+  worker->running = 0;
+
+  return 0;
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
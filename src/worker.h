@@ -0,0 +1,39 @@
+/*
+ * worker.h - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <inttypes.h>
+
+struct Logger;
+struct HTTPRouter;
+struct RappConfig;
+struct OffloadPool;
+struct AccessLog;
+struct Metrics;
+struct Worker;
+
+struct Worker *worker_new(struct Logger *logger, struct HTTPRouter *router, const struct RappConfig *config);
+void worker_destroy(struct Worker *worker);
+
+/* the pool is shared by the workers, and must outlive their loops */
+void worker_set_offload_pool(struct Worker *worker, struct OffloadPool *pool);
+/* the access log is written by the worker's thread alone */
+void worker_set_access_log(struct Worker *worker, struct AccessLog *log);
+/* the metrics are shared by the workers, and must outlive their threads */
+void worker_set_metrics(struct Worker *worker, struct Metrics *metrics);
+
+int worker_start(struct Worker *worker, const char *host, uint16_t port);
+void worker_stop(struct Worker *worker);
+int worker_join(struct Worker *worker);
+
+#endif /* WORKER_H */
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
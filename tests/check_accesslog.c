@@ -0,0 +1,244 @@
+/*
+ * check_accesslog.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include <logger.h>
+#include <httprequest.h>
+#include <accesslog.h>
+
+#define RECORD_SIZE sizeof(struct AccessLogRecord)
+#define HEADER_SIZE sizeof(struct AccessLogHeader)
+
+struct Logger *logger = NULL;
+char dir[] = "/tmp/check_accesslog.XXXXXX";
+char path[PATH_MAX];
+
+static void
+remove_file(const char *name)
+{
+  char file[PATH_MAX];
+
+  snprintf(file, sizeof(file), "%s%s", path, name);
+  unlink(file);
+}
+
+void
+setup(void)
+{
+  logger = logger_new_null();
+  strcpy(dir, "/tmp/check_accesslog.XXXXXX");
+  ck_assert(mkdtemp(dir) != NULL);
+  snprintf(path, sizeof(path), "%s/access.log", dir);
+}
+
+void
+teardown(void)
+{
+  remove_file("");
+  remove_file(".1");
+  remove_file(".2");
+  rmdir(dir);
+  logger_destroy(logger);
+}
+
+/* name is appended to the path, n is the number of records expected */
+static FILE *
+open_log(const char *name,
+         size_t      n)
+{
+  char file[PATH_MAX];
+  struct AccessLogHeader header;
+  FILE *fp = NULL;
+
+  snprintf(file, sizeof(file), "%s%s", path, name);
+  ck_assert((fp = fopen(file, "rb")) != NULL);
+
+  fseek(fp, 0, SEEK_END);
+  ck_assert_int_eq(ftell(fp), HEADER_SIZE + n * RECORD_SIZE);
+  rewind(fp);
+
+  ck_assert_int_eq(fread(&header, sizeof(header), 1, fp), 1);
+  ck_assert(memcmp(header.magic, ACCESS_LOG_MAGIC, sizeof(header.magic)) == 0);
+  ck_assert_int_eq(header.version, ACCESS_LOG_VERSION);
+  ck_assert_int_eq(header.record_size, RECORD_SIZE);
+
+  return fp;
+}
+
+static void
+log_request(struct AccessLog *log,
+            const char       *url,
+            unsigned          status)
+{
+  struct AccessLogEntry entry;
+  struct HTTPRequest *request = NULL;
+
+  ck_assert((request = http_request_new_fake_url(logger, url)) != NULL);
+  http_request_set_method(request, HTTP_METHOD_POST);
+
+  access_log_begin(&entry, request);
+  http_request_destroy(request);
+
+  entry.record.bytes = 1234;
+  ck_assert_int_eq(access_log_commit(log, &entry, status), 0);
+}
+
+START_TEST(test_accesslog_records_the_requests)
+{
+  struct AccessLog *log = NULL;
+  struct AccessLogRecord record;
+  struct AccessLogEntry entry;
+  FILE *fp = NULL;
+  time_t before = time(NULL);
+
+  ck_assert((log = access_log_new(logger, path, 4096)) != NULL);
+  log_request(log, "/hello/world", 200);
+
+  /* one that couldn't even be parsed */
+  access_log_begin(&entry, NULL);
+  ck_assert_int_eq(access_log_commit(log, &entry, 413), 0);
+  access_log_destroy(log);
+
+  fp = open_log("", 2);
+
+  ck_assert_int_eq(fread(&record, sizeof(record), 1, fp), 1);
+  ck_assert(record.timestamp / 1000000 >= before && record.timestamp / 1000000 <= time(NULL));
+  ck_assert_int_eq(record.method, HTTP_METHOD_POST);
+  ck_assert_int_eq(record.status, 200);
+  ck_assert_int_eq(record.bytes, 1234);
+  ck_assert(record.latency < 1000000);
+  ck_assert_int_eq(record.url_length, strlen("/hello/world"));
+  ck_assert(memcmp(record.url, "/hello/world", record.url_length) == 0);
+
+  ck_assert_int_eq(fread(&record, sizeof(record), 1, fp), 1);
+  ck_assert_int_eq(record.method, ACCESS_LOG_NO_METHOD);
+  ck_assert_int_eq(record.status, 413);
+  ck_assert_int_eq(record.bytes, 0);
+  ck_assert_int_eq(record.url_length, 0);
+
+  fclose(fp);
+}
+END_TEST
+
+START_TEST(test_accesslog_truncates_the_long_urls)
+{
+  struct AccessLog *log = NULL;
+  struct AccessLogRecord record;
+  char url[ACCESS_LOG_URL_LEN * 2];
+  FILE *fp = NULL;
+
+  memset(url, 'a', sizeof(url) - 1);
+  url[0] = '/';
+  url[sizeof(url) - 1] = '\0';
+
+  ck_assert((log = access_log_new(logger, path, 4096)) != NULL);
+  log_request(log, url, 200);
+  access_log_destroy(log);
+
+  fp = open_log("", 1);
+  ck_assert_int_eq(fread(&record, sizeof(record), 1, fp), 1);
+  ck_assert_int_eq(record.url_length, strlen(url));
+  ck_assert(memcmp(record.url, url, ACCESS_LOG_URL_LEN) == 0);
+  fclose(fp);
+}
+END_TEST
+
+START_TEST(test_accesslog_rotates_the_full_segments)
+{
+  struct AccessLog *log = NULL;
+  struct AccessLogRecord record;
+  FILE *fp = NULL;
+  int i;
+
+  ck_assert((log = access_log_new(logger, path, HEADER_SIZE + 2 * RECORD_SIZE)) != NULL);
+  for (i = 0; i < 5; i++)
+    log_request(log, "/", 200 + i);
+  access_log_destroy(log);
+
+  fp = open_log(".1", 2);
+  ck_assert_int_eq(fread(&record, sizeof(record), 1, fp), 1);
+  ck_assert_int_eq(record.status, 200);
+  fclose(fp);
+
+  fp = open_log(".2", 2);
+  ck_assert_int_eq(fread(&record, sizeof(record), 1, fp), 1);
+  ck_assert_int_eq(record.status, 202);
+  fclose(fp);
+
+  fp = open_log("", 1);
+  ck_assert_int_eq(fread(&record, sizeof(record), 1, fp), 1);
+  ck_assert_int_eq(record.status, 204);
+  fclose(fp);
+}
+END_TEST
+
+START_TEST(test_accesslog_moves_the_previous_log_away)
+{
+  struct AccessLog *log = NULL;
+  FILE *fp = NULL;
+
+  ck_assert((log = access_log_new(logger, path, 4096)) != NULL);
+  log_request(log, "/", 200);
+  access_log_destroy(log);
+
+  ck_assert((log = access_log_new(logger, path, 4096)) != NULL);
+  access_log_destroy(log);
+
+  fclose(open_log(".1", 1));
+  fclose(open_log("", 0));
+
+  /* the rotated ones are never overwritten */
+  ck_assert((fp = fopen(path, "w")) != NULL);
+  fclose(fp);
+  ck_assert((log = access_log_new(logger, path, 4096)) != NULL);
+  access_log_destroy(log);
+
+  fclose(open_log(".1", 1));
+  fclose(open_log("", 0));
+}
+END_TEST
+
+static Suite *
+accesslog_suite(void)
+{
+  Suite *s = suite_create("rapp.core.accesslog");
+  TCase *tc = tcase_create("rapp.core.accesslog");
+
+  tcase_add_checked_fixture(tc, setup, teardown);
+  tcase_add_test(tc, test_accesslog_records_the_requests);
+  tcase_add_test(tc, test_accesslog_truncates_the_long_urls);
+  tcase_add_test(tc, test_accesslog_rotates_the_full_segments);
+  tcase_add_test(tc, test_accesslog_moves_the_previous_log_away);
+  suite_add_tcase(s, tc);
+
+  return s;
+}
+
+int
+main (void)
+{
+  int number_failed = 0;
+
+  Suite *s = accesslog_suite();
+  SRunner *sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
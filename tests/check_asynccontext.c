@@ -0,0 +1,352 @@
+/*
+ * check_asynccontext.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <check.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <logger.h>
+#include <eloop.h>
+#include <asynccontext.h>
+#include <offloadpool.h>
+
+#include "test_utils.h"
+
+#define MESSAGE "Hello world!"
+#define MESSAGE_LEN STRLEN(MESSAGE)
+
+#define WATCHED 0
+#define OTHER 1
+
+struct ELoop *eloop = NULL;
+struct RappAsyncContext *context = NULL;
+struct OffloadPool *pool = NULL;
+struct Logger *logger;
+int fds[2];
+int completed;
+int cancelled;
+int events;
+int worked;
+int offloads_done;
+int offloads_orphaned;
+int flushes;
+int drains;
+
+static void
+on_complete(struct RappAsyncContext *context,
+            void                    *data)
+{
+  completed++;
+}
+
+static void
+on_flush(struct RappAsyncContext *context,
+         void                    *data)
+{
+  flushes++;
+}
+
+/* what a plugin streaming its response does: the next part once sent */
+static void
+flush_again(struct RappAsyncContext *context,
+            void                    *data)
+{
+  drains++;
+
+  if (drains < 3)
+    rapp_async_flush(context);
+}
+
+static void
+on_cancel(struct RappAsyncContext *context,
+          void                    *data)
+{
+  cancelled++;
+}
+
+/* what a plugin waiting for its backend does */
+static void
+read_and_complete(struct RappAsyncContext *context,
+                  int                      fd,
+                  void                    *data)
+{
+  char buf[MESSAGE_LEN];
+
+  ck_assert_int_eq(fd, fds[WATCHED]);
+  ck_assert(data == eloop);
+
+  read(fd, buf, MESSAGE_LEN);
+  events++;
+
+  rapp_async_complete(context);
+  event_loop_stop(eloop);
+}
+
+static void
+offload_work(void *data)
+{
+  worked++;
+}
+
+/* the plugin frees data in both cases */
+static void
+offload_done(struct RappAsyncContext *offload_context,
+             void                    *data)
+{
+  ck_assert(data == eloop);
+
+  if (offload_context == NULL) {
+    offloads_orphaned++;
+  }
+  else {
+    ck_assert(offload_context == context);
+    offloads_done++;
+    rapp_async_complete(offload_context);
+  }
+
+  event_loop_stop(eloop);
+}
+
+void
+setup(void)
+{
+  logger = logger_new_null();
+  eloop = event_loop_new(logger);
+  context = async_context_new(logger, eloop);
+  pool = offload_pool_new(logger, 1);
+  async_context_set_complete_callback(context, on_complete, NULL);
+  async_context_set_flush_callback(context, on_flush, NULL);
+
+  socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+  completed = 0;
+  cancelled = 0;
+  events = 0;
+  worked = 0;
+  offloads_done = 0;
+  offloads_orphaned = 0;
+  flushes = 0;
+  drains = 0;
+}
+
+void
+teardown(void)
+{
+  close(fds[WATCHED]);
+  close(fds[OTHER]);
+  async_context_destroy(context);
+  offload_pool_destroy(pool);
+  event_loop_destroy(eloop);
+  logger_destroy(logger);
+}
+
+START_TEST(test_asynccontext_not_pending_when_serve_returns)
+{
+  async_context_begin(context);
+  ck_assert_int_eq(async_context_end(context, 0), 0);
+  ck_assert_int_eq(async_context_is_pending(context), 0);
+  ck_assert_int_eq(completed, 0);
+}
+END_TEST
+
+START_TEST(test_asynccontext_completed_inside_serve)
+{
+  async_context_begin(context);
+  rapp_async_complete(context);
+  ck_assert_int_eq(async_context_end(context, RAPP_SERVE_PENDING), 0);
+  ck_assert_int_eq(async_context_is_pending(context), 0);
+  ck_assert_int_eq(completed, 0);
+}
+END_TEST
+
+START_TEST(test_asynccontext_pending_until_completed)
+{
+  async_context_begin(context);
+  ck_assert_int_eq(async_context_end(context, RAPP_SERVE_PENDING), 1);
+  ck_assert_int_eq(async_context_is_pending(context), 1);
+  ck_assert_int_eq(completed, 0);
+
+  rapp_async_complete(context);
+  ck_assert_int_eq(async_context_is_pending(context), 0);
+  ck_assert_int_eq(completed, 1);
+
+  /* completing twice is harmless */
+  rapp_async_complete(context);
+  ck_assert_int_eq(completed, 1);
+}
+END_TEST
+
+START_TEST(test_asynccontext_calls_fd_callback_on_the_loop)
+{
+  async_context_begin(context);
+  ck_assert_int_eq(rapp_async_watch_fd(context, fds[WATCHED], RAPP_ASYNC_READ, read_and_complete, eloop), 0);
+  ck_assert_int_eq(async_context_end(context, RAPP_SERVE_PENDING), 1);
+
+  write(fds[OTHER], MESSAGE, MESSAGE_LEN);
+  event_loop_run(eloop);
+
+  ck_assert_int_eq(events, 1);
+  ck_assert_int_eq(completed, 1);
+
+  /* the completion removed the watch */
+  ck_assert_int_eq(event_loop_remove_fd_watch(eloop, fds[WATCHED], ELOOP_CALLBACK_READ), -1);
+}
+END_TEST
+
+START_TEST(test_asynccontext_unwatch)
+{
+  async_context_begin(context);
+  ck_assert_int_eq(rapp_async_watch_fd(context, fds[WATCHED], RAPP_ASYNC_READ, read_and_complete, eloop), 0);
+  ck_assert_int_eq(rapp_async_unwatch_fd(context, fds[WATCHED], RAPP_ASYNC_READ), 0);
+  ck_assert_int_eq(rapp_async_unwatch_fd(context, fds[WATCHED], RAPP_ASYNC_READ), -1);
+  ck_assert_int_eq(event_loop_remove_fd_watch(eloop, fds[WATCHED], ELOOP_CALLBACK_READ), -1);
+  ck_assert_int_eq(async_context_end(context, 0), 0);
+}
+END_TEST
+
+START_TEST(test_asynccontext_watch_needs_pending_request)
+{
+  ck_assert_int_eq(rapp_async_watch_fd(context, fds[WATCHED], RAPP_ASYNC_READ, read_and_complete, eloop), -1);
+}
+END_TEST
+
+START_TEST(test_asynccontext_cancel)
+{
+  async_context_begin(context);
+  rapp_async_set_cancel_callback(context, on_cancel, NULL);
+  ck_assert_int_eq(rapp_async_watch_fd(context, fds[WATCHED], RAPP_ASYNC_WRITE, read_and_complete, eloop), 0);
+  ck_assert_int_eq(async_context_end(context, RAPP_SERVE_PENDING), 1);
+
+  async_context_cancel(context);
+  ck_assert_int_eq(cancelled, 1);
+  ck_assert_int_eq(completed, 0);
+  ck_assert_int_eq(async_context_is_pending(context), 0);
+  ck_assert_int_eq(event_loop_remove_fd_watch(eloop, fds[WATCHED], ELOOP_CALLBACK_WRITE), -1);
+
+  /* nothing left to cancel */
+  async_context_cancel(context);
+  ck_assert_int_eq(cancelled, 1);
+}
+END_TEST
+
+START_TEST(test_asynccontext_drains_after_flushes)
+{
+  async_context_begin(context);
+  rapp_async_set_drain_callback(context, flush_again, NULL);
+
+  /* inside the serve call the caller sends it on return */
+  rapp_async_flush(context);
+  ck_assert_int_eq(flushes, 0);
+  ck_assert_int_eq(async_context_end(context, RAPP_SERVE_PENDING), 1);
+
+  ck_assert_int_eq(async_context_drain(context), 1);
+  ck_assert_int_eq(drains, 1);
+  ck_assert_int_eq(flushes, 1);
+
+  ck_assert_int_eq(async_context_drain(context), 1);
+  ck_assert_int_eq(drains, 2);
+  ck_assert_int_eq(flushes, 2);
+
+  /* the plugin is done flushing: it's not waiting anymore */
+  ck_assert_int_eq(async_context_drain(context), 1);
+  ck_assert_int_eq(async_context_drain(context), 0);
+  ck_assert_int_eq(drains, 3);
+  ck_assert_int_eq(flushes, 2);
+
+  rapp_async_flush(context);
+  rapp_async_complete(context);
+  ck_assert_int_eq(async_context_drain(context), 0);
+  ck_assert_int_eq(drains, 3);
+}
+END_TEST
+
+START_TEST(test_asynccontext_offload_completes_on_the_loop)
+{
+  async_context_set_offload_pool(context, pool);
+
+  async_context_begin(context);
+  ck_assert_int_eq(rapp_async_offload(context, offload_work, offload_done, eloop), 0);
+  ck_assert_int_eq(async_context_end(context, RAPP_SERVE_PENDING), 1);
+
+  event_loop_run(eloop);
+
+  ck_assert_int_eq(worked, 1);
+  ck_assert_int_eq(offloads_done, 1);
+  ck_assert_int_eq(completed, 1);
+}
+END_TEST
+
+START_TEST(test_asynccontext_offload_outlives_the_request)
+{
+  async_context_set_offload_pool(context, pool);
+
+  async_context_begin(context);
+  ck_assert_int_eq(rapp_async_offload(context, offload_work, offload_done, eloop), 0);
+  ck_assert_int_eq(async_context_end(context, RAPP_SERVE_PENDING), 1);
+
+  async_context_cancel(context);
+  event_loop_run(eloop);
+
+  ck_assert_int_eq(offloads_orphaned, 1);
+  ck_assert_int_eq(offloads_done, 0);
+  ck_assert_int_eq(completed, 0);
+}
+END_TEST
+
+START_TEST(test_asynccontext_offload_needs_a_pool)
+{
+  async_context_begin(context);
+  ck_assert_int_eq(rapp_async_offload(context, offload_work, offload_done, eloop), -1);
+  ck_assert_int_eq(async_context_end(context, 0), 0);
+
+  async_context_set_offload_pool(context, pool);
+  ck_assert_int_eq(rapp_async_offload(context, offload_work, offload_done, eloop), -1);
+}
+END_TEST
+
+static Suite *
+asynccontext_suite(void)
+{
+  Suite *s = suite_create("rapp.core.asynccontext");
+  TCase *tc = tcase_create("rapp.core.asynccontext");
+
+  tcase_add_checked_fixture(tc, setup, teardown);
+  tcase_add_test(tc, test_asynccontext_not_pending_when_serve_returns);
+  tcase_add_test(tc, test_asynccontext_completed_inside_serve);
+  tcase_add_test(tc, test_asynccontext_pending_until_completed);
+  tcase_add_test(tc, test_asynccontext_calls_fd_callback_on_the_loop);
+  tcase_add_test(tc, test_asynccontext_unwatch);
+  tcase_add_test(tc, test_asynccontext_watch_needs_pending_request);
+  tcase_add_test(tc, test_asynccontext_cancel);
+  tcase_add_test(tc, test_asynccontext_drains_after_flushes);
+  tcase_add_test(tc, test_asynccontext_offload_completes_on_the_loop);
+  tcase_add_test(tc, test_asynccontext_offload_outlives_the_request);
+  tcase_add_test(tc, test_asynccontext_offload_needs_a_pool);
+  suite_add_tcase(s, tc);
+
+  return s;
+}
+
+int
+main (void)
+{
+  int number_failed = 0;
+
+  Suite *s = asynccontext_suite();
+  SRunner *sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
@@ -56,12 +56,14 @@ START_TEST(test_config_early_options)
   char *logout_invalid_path[] = {"rapp", "--log-output", "/this/path/should/not/exists"};
   char *load[] = {"rapp", "--load", NULL};
   char *logcolor[] = {"rapp", "--log-nocolor"};
+  char *logasync[] = {"rapp", "--log-async"};
   ck_assert_call_fail(config_parse_early_commandline, &arguments, 0, 0);
   ck_assert_call_fail(config_parse_early_commandline, &arguments, 1, 0);
   ck_assert_call_ok(config_parse_early_commandline, &arguments, 1, empty);
   // defaults:
   ck_assert_int_eq(arguments.loglevel, LOG_INFO);
   ck_assert_int_eq(arguments.lognocolor, 0);
+  ck_assert_int_eq(arguments.logasync, 0);
   ck_assert(arguments.logoutput == stderr);
   ck_assert_int_eq(arguments.logoutput_is_console, 1);
   ck_assert(arguments.container == NULL);
@@ -92,6 +94,9 @@ START_TEST(test_config_early_options)
   ck_assert_call_ok(config_parse_early_commandline, &arguments, 2, logcolor);
   ck_assert_int_eq(arguments.lognocolor, 1);
 
+  ck_assert_call_ok(config_parse_early_commandline, &arguments, 2, logasync);
+  ck_assert_int_eq(arguments.logasync, 1);
+
   ck_assert_call_fail(config_parse_early_commandline, &arguments, 3, load);
   load[2] = strdup("path/to/container.so");
   ck_assert_call_ok(config_parse_early_commandline, &arguments, 3, load);
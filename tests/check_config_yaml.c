@@ -122,6 +122,36 @@ START_TEST(test_yaml_invalid_data)
 }
 END_TEST
 
+START_TEST(test_yaml_routes)
+{
+  const char *prefix, *plugin;
+
+  rapp_config_opt_add(conf, "core", "address", PARAM_STRING, NULL, NULL);
+  ck_assert_call_ok(config_parse_string, conf, yaml_routes);
+  ck_assert_int_eq(config_get_num_routes(conf), 2);
+  ck_assert_call_ok(config_get_nth_route, conf, 0, &prefix, &plugin);
+  ck_assert_str_eq(prefix, "/");
+  ck_assert_str_eq(plugin, "/usr/lib/rapp/hello.so");
+  ck_assert_call_ok(config_get_nth_route, conf, 1, &prefix, &plugin);
+  ck_assert_str_eq(prefix, "/static");
+  ck_assert_str_eq(plugin, "/usr/lib/rapp/files.so");
+  ck_assert_call_fail(config_get_nth_route, conf, 2, &prefix, &plugin);
+
+  /* a prefix mounted again moves to the new plugin */
+  ck_assert_call_ok(config_parse_string, conf, yaml_routes_inline);
+  ck_assert_int_eq(config_get_num_routes(conf), 3);
+  ck_assert_call_ok(config_get_nth_route, conf, 0, &prefix, &plugin);
+  ck_assert_str_eq(prefix, "/");
+  ck_assert_str_eq(plugin, "/usr/lib/rapp/index.so");
+  ck_assert_call_ok(config_get_nth_route, conf, 2, &prefix, &plugin);
+  ck_assert_str_eq(prefix, "/api");
+  ck_assert_str_eq(plugin, "/usr/lib/rapp/api.so");
+
+  ck_assert_call_fail(config_parse_string, conf, yaml_wrong_route);
+  ck_assert_call_fail(config_parse_string, conf, yaml_wrong_route2);
+}
+END_TEST
+
 START_TEST(test_yaml_file)
 {
   char tmp[16] = { '\0' };
@@ -200,6 +230,7 @@ config_yaml_parse_suite(void)
   tcase_add_test(tc, test_config_yaml_parse);
   tcase_add_test(tc, test_yaml_empty);
   tcase_add_test(tc, test_yaml_invalid_data);
+  tcase_add_test(tc, test_yaml_routes);
   tcase_add_test(tc, test_yaml_file);
   tcase_add_test(tc, test_yaml_dir);
   suite_add_tcase(s, tc);
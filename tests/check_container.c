@@ -185,6 +185,99 @@ START_TEST(test_container_serve_dummy)
 }
 END_TEST
 
+START_TEST(test_container_serve_async_dummy)
+{
+  struct Logger *logger = NULL;
+  struct Container *container = NULL;
+  struct RappConfig *config = NULL;
+  struct Symbol syms[] = {
+    { "rapp_get_abi_version", DLSTUB_ERR_NONE },
+    { "rapp_create",          DLSTUB_ERR_NONE },
+    { "rapp_destroy",         DLSTUB_ERR_NONE },
+    { "rapp_serve_async",     DLSTUB_ERR_NONE },
+    { "rapp_init",            DLSTUB_ERR_NONE },
+    { NULL, 0 }
+  };
+  dlstub_setup(DLSTUB_ERR_NONE, syms);
+  logger = logger_new_null();
+  config = config_new(logger);
+  /* rapp_serve can be omitted */
+  container = container_new(logger, "dummy", config);
+  ck_assert(container != NULL);
+  container_init(container, config);
+  ck_assert_int_eq(container_serve_async(container,
+                                         (struct HTTPRequest *)syms,
+                                         (struct HTTPResponse *)syms,
+                                         (struct RappAsyncContext *)syms), RAPP_SERVE_PENDING); /* FIXME */
+  ck_assert_int_eq(container_serve(container,
+                                   (struct HTTPRequest *)syms,
+                                   (struct HTTPResponse *)syms), -1); /* FIXME */
+  container_destroy(container);
+  ck_assert_int_eq(dlstub_get_invoke_count("rapp_serve_async"), 1);
+  logger_destroy(logger);
+}
+END_TEST
+
+START_TEST(test_container_serve_async_falls_back_to_serve)
+{
+  struct Logger *logger = NULL;
+  struct Container *container = NULL;
+  struct RappConfig *config = NULL;
+  struct Symbol syms[] = {
+    { "rapp_get_abi_version", DLSTUB_ERR_NONE },
+    { "rapp_create",          DLSTUB_ERR_NONE },
+    { "rapp_destroy",         DLSTUB_ERR_NONE },
+    { "rapp_serve",           DLSTUB_ERR_NONE },
+    { "rapp_init",            DLSTUB_ERR_NONE },
+    { NULL, 0 }
+  };
+  dlstub_setup(DLSTUB_ERR_NONE, syms);
+  logger = logger_new_null();
+  config = config_new(logger);
+  container = container_new(logger, "dummy", config);
+  ck_assert(container != NULL);
+  container_init(container, config);
+  ck_assert_int_eq(container_serve_async(container,
+                                         (struct HTTPRequest *)syms,
+                                         (struct HTTPResponse *)syms,
+                                         (struct RappAsyncContext *)syms), 0); /* FIXME */
+  container_destroy(container);
+  ck_assert_int_eq(dlstub_get_invoke_count("rapp_serve"), 1);
+  logger_destroy(logger);
+}
+END_TEST
+
+START_TEST(test_container_stream_body_needs_serve_async)
+{
+  struct Logger *logger = NULL;
+  struct Container *container = NULL;
+  struct RappConfig *config = NULL;
+  struct Symbol syms[] = {
+    { "rapp_get_abi_version", DLSTUB_ERR_NONE },
+    { "rapp_create",          DLSTUB_ERR_NONE },
+    { "rapp_destroy",         DLSTUB_ERR_NONE },
+    { "rapp_serve",           DLSTUB_ERR_NONE },
+    { "rapp_stream_body",     DLSTUB_ERR_NONE },
+    { "rapp_init",            DLSTUB_ERR_NONE },
+    { NULL, 0 }
+  };
+  dlstub_setup(DLSTUB_ERR_NONE, syms);
+  logger = logger_new_null();
+  config = config_new(logger);
+  container = container_new(logger, "dummy", config);
+  ck_assert(container != NULL);
+  container_init(container, config);
+  /* a blocking serve can't receive the body later */
+  ck_assert_int_eq(container_stream_body(container, (struct HTTPRequest *)syms), 0);
+  ck_assert_int_eq(dlstub_get_invoke_count("rapp_stream_body"), 0);
+  container_set_serve_async(container, (RappServeAsyncCallback)syms);
+  ck_assert_int_eq(container_stream_body(container, (struct HTTPRequest *)syms), 1);
+  ck_assert_int_eq(dlstub_get_invoke_count("rapp_stream_body"), 1);
+  container_destroy(container);
+  logger_destroy(logger);
+}
+END_TEST
+
 START_TEST(test_container_logger_get)
 {
   struct Logger *logger = NULL;
@@ -313,6 +406,9 @@ container_suite(void)
   tcase_add_test(tc, test_container_new_abi_version_mismatch);
   tcase_add_test(tc, test_container_new_dummy);
   tcase_add_test(tc, test_container_serve_dummy);
+  tcase_add_test(tc, test_container_serve_async_dummy);
+  tcase_add_test(tc, test_container_serve_async_falls_back_to_serve);
+  tcase_add_test(tc, test_container_stream_body_needs_serve_async);
   tcase_add_test(tc, test_container_logger_get);
   tcase_add_test(tc, test_container_new_null_new_destroy);
   tcase_add_test(tc, test_container_new_null_serve);
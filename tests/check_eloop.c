@@ -7,8 +7,11 @@
 
 #include <check.h>
 #include <stdlib.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <time.h>
 
 #include <logger.h>
 #include <eloop.h>
@@ -22,11 +25,24 @@
 #define WATCHED 0
 #define OTHER 1
 
+#define HIGH_FD 4000
+
+#define POSTS 3
+
+/* milliseconds, well under the timer tick */
+#define STOP_DELAY 10
+#define STOP_TIME 50
+
 struct ELoop *eloop = NULL;
 ELoopWatchFdCallback callbacks[ELOOP_CALLBACK_MAX];
 char buf[MESSAGE_LEN];
 int fds[2];
 struct Logger *logger;
+int timer_calls;
+struct ELoopPost posts[POSTS];
+int posted[POSTS];
+int posts_run;
+pthread_t loop_thread;
 
 static int
 read_func(int         fd,
@@ -43,6 +59,30 @@ read_func(int         fd,
   return 0;
 }
 
+static int
+high_fd_read_func(int         fd,
+                  const void *data)
+{
+  struct ELoop *eloop = (struct ELoop *)data;
+
+  ck_assert(fd >= HIGH_FD);
+
+  read(fd, buf, MESSAGE_LEN);
+
+  event_loop_stop(eloop);
+
+  return 0;
+}
+
+static int
+fail_func(int         fd,
+          const void *data)
+{
+  ck_assert_msg(0, "removed watch called");
+
+  return 0;
+}
+
 static int
 write_func(int         fd,
            const void *data)
@@ -71,6 +111,22 @@ close_func(int         fd,
   return 0;
 }
 
+static void
+timer_func(const void *data)
+{
+  struct ELoop *eloop = (struct ELoop *)data;
+
+  timer_calls++;
+
+  event_loop_stop(eloop);
+}
+
+static void
+fail_timer_func(const void *data)
+{
+  ck_assert_msg(0, "cancelled timer called");
+}
+
 static void
 free_func(void *data)
 {
@@ -79,6 +135,52 @@ free_func(void *data)
   event_loop_stop(eloop);
 }
 
+static void
+post_func(void *data)
+{
+  int *slot = (int *)data;
+
+  ck_assert(pthread_equal(pthread_self(), loop_thread));
+
+  *slot = ++posts_run;
+
+  if (posts_run == POSTS)
+    event_loop_stop(eloop);
+}
+
+static void *
+post_thread(void *data)
+{
+  int i = 0;
+
+  for (i = 0; i < POSTS; i++) {
+    posts[i].callback = post_func;
+    posts[i].data = &(posted[i]);
+    event_loop_post(eloop, &(posts[i]));
+  }
+
+  return NULL;
+}
+
+static void *
+stop_thread(void *data)
+{
+  usleep(STOP_DELAY * 1000);
+  event_loop_stop(eloop);
+
+  return NULL;
+}
+
+static long
+elapsed_ms(struct timespec *start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
 void
 setup(void)
 {
@@ -89,6 +191,9 @@ setup(void)
 
   memset(callbacks, 0, sizeof(ELoopWatchFdCallback) * ELOOP_CALLBACK_MAX);
   memset(buf, 0, MESSAGE_LEN);
+  timer_calls = 0;
+  memset(posted, 0, sizeof(posted));
+  posts_run = 0;
 }
 
 void teardown(void)
@@ -135,12 +240,120 @@ START_TEST(test_eloop_calls_close_func_when_fd_is_closed)
 }
 END_TEST
 
+START_TEST(test_eloop_calls_read_func_on_high_fds)
+{
+  int high_fd = fcntl(fds[WATCHED], F_DUPFD, HIGH_FD);
+
+  ck_assert(high_fd >= HIGH_FD);
+
+  ck_assert_call_ok(event_loop_add_fd_watch, eloop, fds[WATCHED], ELOOP_CALLBACK_WRITE, write_func, eloop);
+  ck_assert_call_ok(event_loop_add_fd_watch, eloop, high_fd, ELOOP_CALLBACK_READ, high_fd_read_func, eloop);
+
+  write(fds[OTHER], MESSAGE, MESSAGE_LEN);
+  ck_assert_call_ok(event_loop_remove_fd_watch, eloop, fds[WATCHED], ELOOP_CALLBACK_WRITE);
+
+  event_loop_run(eloop);
+
+  ck_assert_str_eq(buf, MESSAGE);
+
+  close(high_fd);
+}
+END_TEST
+
+START_TEST(test_eloop_does_not_call_removed_watches)
+{
+  ck_assert_call_ok(event_loop_add_fd_watch, eloop, fds[WATCHED], ELOOP_CALLBACK_READ, fail_func, eloop);
+  ck_assert_call_ok(event_loop_add_fd_watch, eloop, fds[WATCHED], ELOOP_CALLBACK_WRITE, write_func, eloop);
+  ck_assert_call_ok(event_loop_remove_fd_watch, eloop, fds[WATCHED], ELOOP_CALLBACK_READ);
+
+  write(fds[OTHER], MESSAGE, MESSAGE_LEN);
+
+  event_loop_run(eloop);
+
+  ck_assert_call_ok(event_loop_remove_fd_watch, eloop, fds[WATCHED], ELOOP_CALLBACK_WRITE);
+  ck_assert_call_fail(event_loop_remove_fd_watch, eloop, fds[WATCHED], ELOOP_CALLBACK_WRITE);
+}
+END_TEST
+
+START_TEST(test_eloop_calls_read_func_in_edge_triggered_mode)
+{
+  ck_assert_call_fail(event_loop_set_fd_edge_triggered, eloop, fds[WATCHED], 1);
+
+  ck_assert_call_ok(event_loop_add_fd_watch, eloop, fds[WATCHED], ELOOP_CALLBACK_READ, read_func, eloop);
+  ck_assert_call_ok(event_loop_set_fd_edge_triggered, eloop, fds[WATCHED], 1);
+
+  write(fds[OTHER], MESSAGE, MESSAGE_LEN);
+
+  event_loop_run(eloop);
+
+  ck_assert_str_eq(buf, MESSAGE);
+}
+END_TEST
+
+START_TEST(test_eloop_calls_timer_func_when_timer_expires)
+{
+  ck_assert(event_loop_add_timer(eloop, 10, timer_func, eloop) != NULL);
+
+  event_loop_run(eloop);
+
+  ck_assert_int_eq(timer_calls, 1);
+}
+END_TEST
+
+START_TEST(test_eloop_does_not_call_cancelled_timers)
+{
+  struct ELoopTimer *timer = event_loop_add_timer(eloop, 10, fail_timer_func, eloop);
+
+  ck_assert(timer != NULL);
+  event_loop_cancel_timer(eloop, timer);
+
+  ck_assert(event_loop_add_timer(eloop, 200, timer_func, eloop) != NULL);
+
+  event_loop_run(eloop);
+
+  ck_assert_int_eq(timer_calls, 1);
+}
+END_TEST
+
 START_TEST(test_eloop_calls_free_func_when_is_scheduled)
 {
   event_loop_schedule_free(eloop, free_func, eloop);
 }
 END_TEST
 
+START_TEST(test_eloop_runs_posts_from_other_threads_in_order)
+{
+  pthread_t thread;
+  int i = 0;
+
+  loop_thread = pthread_self();
+
+  ck_assert_int_eq(pthread_create(&thread, NULL, post_thread, NULL), 0);
+
+  event_loop_run(eloop);
+  pthread_join(thread, NULL);
+
+  for (i = 0; i < POSTS; i++)
+    ck_assert_int_eq(posted[i], i + 1);
+}
+END_TEST
+
+START_TEST(test_eloop_stops_right_away_from_other_threads)
+{
+  pthread_t thread;
+  struct timespec start;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  ck_assert_int_eq(pthread_create(&thread, NULL, stop_thread, NULL), 0);
+
+  event_loop_run(eloop);
+  pthread_join(thread, NULL);
+
+  /* woken up, not at the next tick */
+  ck_assert(elapsed_ms(&start) < STOP_TIME);
+}
+END_TEST
+
 START_TEST(test_eloop_new_fails)
 {
   struct Logger *logger = logger_new_null();
@@ -161,7 +374,14 @@ eloop_suite(void)
   tcase_add_test(tc, test_eloop_calls_read_func_when_fd_has_pending_data);
   tcase_add_test(tc, test_eloop_calls_write_func_when_fd_becomes_writable);
   tcase_add_test(tc, test_eloop_calls_close_func_when_fd_is_closed);
+  tcase_add_test(tc, test_eloop_calls_read_func_on_high_fds);
+  tcase_add_test(tc, test_eloop_does_not_call_removed_watches);
+  tcase_add_test(tc, test_eloop_calls_read_func_in_edge_triggered_mode);
+  tcase_add_test(tc, test_eloop_calls_timer_func_when_timer_expires);
+  tcase_add_test(tc, test_eloop_does_not_call_cancelled_timers);
   tcase_add_test(tc, test_eloop_calls_free_func_when_is_scheduled);
+  tcase_add_test(tc, test_eloop_runs_posts_from_other_threads_in_order);
+  tcase_add_test(tc, test_eloop_stops_right_away_from_other_threads);
   tcase_add_test(tc, test_eloop_new_fails);
   suite_add_tcase(s, tc);
 
@@ -0,0 +1,258 @@
+/*
+ * check_httpconnection.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <check.h>
+
+#include <logger.h>
+#include <accesslog.h>
+#include <eloop.h>
+#include <container.h>
+#include <httpconnection.h>
+#include <httpresponse.h>
+#include <httprouter.h>
+#include <tcpconnection.h>
+
+#include "rapp/rapp_async.h"
+
+#include "test_memstubs.h"
+#include "test_utils.h"
+
+#define HOST "127.0.0.1"
+#define PORT 8002
+
+#define REQUEST "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"
+#define ERROR_REQUEST "GET /error HTTP/1.1\r\nHost: localhost\r\n\r\n"
+
+/* milliseconds */
+#define KEEP_ALIVE_TIMEOUT 200
+#define SERVE_TIME 500
+#define RUN_TIME 1000
+
+static struct Logger *logger = NULL;
+static struct ELoop *eloop = NULL;
+static struct HTTPRouter *router = NULL;
+static struct Container *container = NULL;
+static struct Container *error_container = NULL;
+static struct HTTPConnection *http_connection = NULL;
+static int server_fd = -1;
+static int client_fd = -1;
+
+static int finished = 0;
+static struct HTTPResponse *pending_response = NULL;
+static struct RappAsyncContext *pending_context = NULL;
+
+static void
+on_finish(struct HTTPConnection *connection,
+          void                  *data)
+{
+  finished = 1;
+  event_loop_stop(eloop);
+}
+
+static void
+on_run_time(const void *data)
+{
+  event_loop_stop(eloop);
+}
+
+static void
+on_serve_time(const void *data)
+{
+  http_response_write_status_line_by_code(pending_response, 200);
+  http_response_write_header(pending_response, "Content-Length", "0");
+  http_response_end_headers(pending_response);
+
+  /* the response is sent right away */
+  rapp_async_complete(pending_context);
+  event_loop_stop(eloop);
+}
+
+static int
+serve(struct RappContainer *handle,
+      struct HTTPRequest   *request,
+      struct HTTPResponse  *response)
+{
+  return -1;
+}
+
+static int
+serve_error(struct RappContainer *handle,
+            struct HTTPRequest   *request,
+            struct HTTPResponse  *response)
+{
+  return http_response_write_error_by_code(response, 404) < 0 ? -1 : 0;
+}
+
+/* answers after SERVE_TIME, longer than the keep alive timeout */
+static int
+serve_later(struct RappContainer    *handle,
+            struct HTTPRequest      *request,
+            struct HTTPResponse     *response,
+            struct RappAsyncContext *context)
+{
+  pending_response = response;
+  pending_context = context;
+
+  event_loop_add_timer(eloop, SERVE_TIME, on_serve_time, NULL);
+
+  return RAPP_SERVE_PENDING;
+}
+
+static int
+init(struct RappContainer *handle,
+     struct RappConfig    *config)
+{
+  return 0;
+}
+
+static int
+destroy(struct RappContainer *handle)
+{
+  return 0;
+}
+
+static void
+run(void)
+{
+  event_loop_add_timer(eloop, RUN_TIME, on_run_time, NULL);
+  event_loop_run(eloop);
+}
+
+void
+setup(void)
+{
+  struct HTTPConnectionTimeouts timeouts = {10000, 10000, KEEP_ALIVE_TIMEOUT};
+  struct TcpConnection *tcp_connection = NULL;
+
+  finished = 0;
+
+  logger = logger_new_null();
+  eloop = event_loop_new(logger);
+
+  router = http_router_new(logger, ROUTE_MATCH_FIRST);
+  container = container_new_custom(logger, "later", init, serve, destroy, NULL);
+  container_set_serve_async(container, serve_later);
+  error_container = container_new_custom(logger, "error", init, serve_error, destroy, NULL);
+  /* the first binding matching wins */
+  ck_assert_call_ok(http_router_bind, router, "/error", error_container);
+  ck_assert_call_ok(http_router_bind, router, "/", container);
+
+  server_fd = listen_to(HOST, PORT);
+  client_fd = connect_to(HOST, PORT);
+
+  tcp_connection = tcp_connection_with_fd(accept(server_fd, NULL, NULL), logger, eloop);
+  ck_assert(tcp_connection != NULL);
+
+  http_connection = http_connection_new(logger, eloop, tcp_connection, router);
+  ck_assert(http_connection != NULL);
+  http_connection_set_finish_callback(http_connection, on_finish, NULL);
+  http_connection_set_timeouts(http_connection, &timeouts);
+}
+
+void
+teardown(void)
+{
+  http_connection_destroy(http_connection);
+  close(client_fd);
+  close(server_fd);
+  http_router_destroy(router);
+  container_destroy(container);
+  container_destroy(error_container);
+  event_loop_destroy(eloop);
+  logger_destroy(logger);
+}
+
+START_TEST(test_httpconnection_keeps_alive_the_pending_requests)
+{
+  char buffer[256] = {'\0'};
+
+  ck_assert_int_eq(write(client_fd, REQUEST, strlen(REQUEST)), strlen(REQUEST));
+
+  run();
+  ck_assert_int_eq(finished, 0);
+
+  ck_assert(recv(client_fd, buffer, sizeof(buffer) - 1, MSG_DONTWAIT) > 0);
+  ck_assert(strncmp(buffer, "HTTP/1.1 200", strlen("HTTP/1.1 200")) == 0);
+
+  /* all sent: now the connection is idle */
+  run();
+  ck_assert_int_eq(finished, 1);
+}
+END_TEST
+
+START_TEST(test_httpconnection_logs_the_status_of_the_error_pages)
+{
+  char dir[] = "/tmp/check_httpconnection.XXXXXX";
+  char path[sizeof(dir) + 16];
+  struct AccessLog *log = NULL;
+  struct AccessLogRecord record;
+  FILE *fp = NULL;
+
+  ck_assert(mkdtemp(dir) != NULL);
+  snprintf(path, sizeof(path), "%s/access.log", dir);
+
+  ck_assert((log = access_log_new(logger, path, 4096)) != NULL);
+  ck_assert_call_ok(http_connection_set_access_log, http_connection, log);
+
+  ck_assert_int_eq(write(client_fd, ERROR_REQUEST, strlen(ERROR_REQUEST)), strlen(ERROR_REQUEST));
+
+  /* until the keep alive timeout */
+  run();
+  ck_assert_int_eq(finished, 1);
+  access_log_destroy(log);
+
+  ck_assert((fp = fopen(path, "rb")) != NULL);
+  ck_assert_int_eq(fseek(fp, sizeof(struct AccessLogHeader), SEEK_SET), 0);
+  ck_assert_int_eq(fread(&record, sizeof(record), 1, fp), 1);
+  fclose(fp);
+
+  ck_assert_int_eq(record.status, 404);
+  ck_assert_int_eq(record.url_length, strlen("/error"));
+
+  unlink(path);
+  rmdir(dir);
+}
+END_TEST
+
+static Suite *
+httpconnection_suite(void)
+{
+  Suite *s = suite_create("rapp.core.httpconnection");
+  TCase *tc = tcase_create("rapp.core.httpconnection");
+
+  tcase_add_checked_fixture(tc, setup, teardown);
+  tcase_add_test(tc, test_httpconnection_keeps_alive_the_pending_requests);
+  tcase_add_test(tc, test_httpconnection_logs_the_status_of_the_error_pages);
+  suite_add_tcase(s, tc);
+
+  return s;
+}
+
+int
+main (void)
+{
+  int number_failed = 0;
+
+  Suite *s = httpconnection_suite();
+  SRunner *sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
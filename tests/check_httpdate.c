@@ -0,0 +1,123 @@
+/*
+ * check_httpdate.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <logger.h>
+#include <eloop.h>
+#include <httpdate.h>
+
+struct ELoop *eloop = NULL;
+struct HTTPDate *date = NULL;
+struct Logger *logger;
+time_t created;
+
+static void
+stop_loop(const void *data)
+{
+  event_loop_stop(eloop);
+}
+
+/* the second can change in between: it's checked against both ends */
+static void
+assert_header_is_now(time_t before)
+{
+  char expected[HTTP_DATE_HEADER_SIZE];
+  const char *header = NULL;
+  size_t length = 0;
+  time_t after = time(NULL);
+
+  header = http_date_get_header(date, &length);
+  ck_assert_int_eq(length, strlen(header));
+
+  http_date_format_header(expected, after);
+  if (strcmp(header, expected) != 0) {
+    http_date_format_header(expected, before);
+    ck_assert_str_eq(header, expected);
+  }
+}
+
+void
+setup(void)
+{
+  logger = logger_new_null();
+  eloop = event_loop_new(logger);
+  created = time(NULL);
+  date = http_date_new(logger, eloop);
+}
+
+void
+teardown(void)
+{
+  http_date_destroy(date);
+  event_loop_destroy(eloop);
+  logger_destroy(logger);
+}
+
+START_TEST(test_httpdate_formats_the_header_line)
+{
+  char header[HTTP_DATE_HEADER_SIZE];
+
+  ck_assert_int_eq(http_date_format_header(header, 784111777), 39);
+  ck_assert_str_eq(header, "Date: Sun, 06 Nov 1994 08:49:37 +0000\r\n");
+}
+END_TEST
+
+START_TEST(test_httpdate_starts_from_now)
+{
+  assert_header_is_now(created);
+}
+END_TEST
+
+START_TEST(test_httpdate_is_refreshed_by_the_loop)
+{
+  time_t before = time(NULL);
+
+  event_loop_add_timer(eloop, 2200, stop_loop, NULL);
+  event_loop_run(eloop);
+
+  ck_assert_int_ne(time(NULL), before);
+  assert_header_is_now(time(NULL) - 1);
+}
+END_TEST
+
+static Suite *
+httpdate_suite(void)
+{
+  Suite *s = suite_create("rapp.core.httpdate");
+  TCase *tc = tcase_create("rapp.core.httpdate");
+
+  tcase_add_checked_fixture(tc, setup, teardown);
+  tcase_add_test(tc, test_httpdate_formats_the_header_line);
+  tcase_add_test(tc, test_httpdate_starts_from_now);
+  tcase_add_test(tc, test_httpdate_is_refreshed_by_the_loop);
+  suite_add_tcase(s, tc);
+
+  return s;
+}
+
+int
+main (void)
+{
+  int number_failed = 0;
+
+  Suite *s = httpdate_suite();
+  SRunner *sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
@@ -6,6 +6,8 @@
  */
 
 #define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #include <check.h>
@@ -233,6 +235,61 @@ START_TEST(test_httprequest_error_on_not_existent_header)
 }
 END_TEST
 
+START_TEST(test_httprequest_gets_the_first_of_repeated_headers)
+{
+  char *request = "GET / HTTP/1.1\r\nX-Foo: first\r\nHost: someserver\r\nx-FOO: second\r\n\r\n";
+  const char *request_buffer = NULL;
+  struct MemoryRange range;
+  char *value = NULL;
+
+  http_request_queue_append_data(queue, request, strlen(request));
+
+  http_request = http_request_queue_get_next_request(queue);
+  ck_assert(http_request != NULL);
+
+  request_buffer = http_request_get_headers_buffer(http_request);
+
+  ck_assert_int_eq(http_request_get_header_value_range(http_request, "X-FOO", &range), 0);
+  EXTRACT_MEMORY_RANGE(value, request_buffer, range);
+  ck_assert_str_eq(value, "first");
+
+  ck_assert_int_eq(http_request_get_header_value_range(http_request, "X-Fo", &range), -1);
+}
+END_TEST
+
+START_TEST(test_httprequest_gets_the_known_headers)
+{
+  char *request = "POST / HTTP/1.1\r\n"
+                  "accept: 0\r\nAccept-Encoding: 1\r\nAuthorization: 2\r\nConnection: 3\r\n"
+                  "Content-Length: 0\r\nContent-Type: 5\r\nCookie: 6\r\nHOST: 7\r\n"
+                  "If-Modified-Since: 8\r\nIf-None-Match: 9\r\nX-Transfer-Encoding: 10\r\nUser-Agent: 11\r\n\r\n";
+  const char *request_buffer = NULL;
+  struct MemoryRange range;
+  char *value = NULL;
+  char expected[8];
+  int header = 0;
+
+  http_request_queue_append_data(queue, request, strlen(request));
+
+  http_request = http_request_queue_get_next_request(queue);
+  ck_assert(http_request != NULL);
+
+  request_buffer = http_request_get_headers_buffer(http_request);
+
+  for (header = 0; header < HTTP_HEADER_MAX; header++) {
+    if (header == HTTP_HEADER_TRANSFER_ENCODING) {
+      ck_assert_int_eq(http_request_get_known_header_range(http_request, header, &range), -1);
+      continue;
+    }
+
+    ck_assert_int_eq(http_request_get_known_header_range(http_request, header, &range), 0);
+    EXTRACT_MEMORY_RANGE(value, request_buffer, range);
+    snprintf(expected, sizeof(expected), "%d", header == HTTP_HEADER_CONTENT_LENGTH ? 0 : header);
+    ck_assert_str_eq(value, expected);
+  }
+}
+END_TEST
+
 /*START_TEST(test_httprequest_returns_error_on_too_many_headers)*/
 /*{*/
   /*char *request = strdup("GET /hello/world/ HTTP/1.1\r\n");*/
@@ -267,7 +324,128 @@ START_TEST(test_httprequest_gets_the_body)
   ck_assert(http_request != NULL);
 
   body = http_request_get_body(http_request);
-  ck_assert_str_eq(body, "Hello world!");
+  ck_assert(body != NULL);
+  ck_assert_int_eq(http_request_get_body_length(http_request), 12);
+  ck_assert(strncmp(body, "Hello world!", 12) == 0);
+}
+END_TEST
+
+START_TEST(test_httprequest_gets_the_chunked_body)
+{
+  char *request = "POST /hello/world/ HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n6\r\nHello \r\n6\r\nworld!\r\n0\r\n\r\n";
+  const char *body = NULL;
+
+  http_request_queue_append_data(queue, request, strlen(request));
+
+  http_request = http_request_queue_get_next_request(queue);
+  ck_assert(http_request != NULL);
+
+  body = http_request_get_body(http_request);
+  ck_assert(body != NULL);
+  ck_assert_int_eq(http_request_get_body_length(http_request), 12);
+  ck_assert(strncmp(body, "Hello world!", 12) == 0);
+}
+END_TEST
+
+START_TEST(test_httprequest_gets_the_url_split_across_reads)
+{
+  char *first = "GET /hello/wo";
+  char *second = "rld/ HTTP/1.1\r\nHo";
+  char *third = "st: someserver\r\n\r\n";
+  const char *request_buffer = NULL;
+  struct MemoryRange range;
+  char *value = NULL;
+
+  http_request_queue_append_data(queue, first, strlen(first));
+  http_request_queue_append_data(queue, second, strlen(second));
+  http_request_queue_append_data(queue, third, strlen(third));
+
+  http_request = http_request_queue_get_next_request(queue);
+  ck_assert(http_request != NULL);
+
+  request_buffer = http_request_get_headers_buffer(http_request);
+
+  http_request_get_url_range(http_request, &range);
+  EXTRACT_MEMORY_RANGE(value, request_buffer, range);
+  ck_assert_str_eq(value, "/hello/world/");
+
+  ck_assert_int_eq(http_request_get_header_value_range(http_request, "host", &range), 0);
+  EXTRACT_MEMORY_RANGE(value, request_buffer, range);
+  ck_assert_str_eq(value, "someserver");
+}
+END_TEST
+
+START_TEST(test_httprequest_gets_pipelined_requests)
+{
+  char *requests = "GET /first HTTP/1.1\r\n\r\nGET /second HTTP/1.1\r\n\r\n";
+  struct HTTPRequest *first = NULL;
+  struct MemoryRange url_range;
+  char *url = NULL;
+
+  http_request_queue_append_data(queue, requests, strlen(requests));
+
+  first = http_request_queue_get_next_request(queue);
+  ck_assert(first != NULL);
+  http_request_get_url_range(first, &url_range);
+  EXTRACT_MEMORY_RANGE(url, http_request_get_headers_buffer(first), url_range);
+  ck_assert_str_eq(url, "/first");
+  http_request_destroy(first);
+
+  http_request = http_request_queue_get_next_request(queue);
+  ck_assert(http_request != NULL);
+  http_request_get_url_range(http_request, &url_range);
+  EXTRACT_MEMORY_RANGE(url, http_request_get_headers_buffer(http_request), url_range);
+  ck_assert_str_eq(url, "/second");
+}
+END_TEST
+
+START_TEST(test_httprequest_arena_keeps_the_allocations_apart)
+{
+  char *values[100];
+  char expected[16];
+  char *big = NULL;
+  int i = 0;
+
+  http_request = http_request_new(logger);
+
+  for (i = 0; i < 100; i++) {
+    values[i] = rapp_request_sprintf(http_request, "value-%d", i);
+    ck_assert(values[i] != NULL);
+    ck_assert_int_eq((uintptr_t)values[i] % sizeof(void *), 0);
+  }
+
+  /* bigger than a block */
+  big = rapp_request_alloc(http_request, 10000);
+  ck_assert(big != NULL);
+  memset(big, 'x', 10000);
+
+  ck_assert_str_eq(rapp_request_sprintf(http_request, "%s", "after"), "after");
+
+  for (i = 0; i < 100; i++) {
+    snprintf(expected, sizeof(expected), "value-%d", i);
+    ck_assert_str_eq(values[i], expected);
+  }
+}
+END_TEST
+
+START_TEST(test_httprequest_arena_formats_strings_longer_than_a_block)
+{
+  char *long_string = malloc(8192);
+  char *formatted = NULL;
+
+  memset(long_string, 'a', 8191);
+  long_string[8191] = 0;
+
+  http_request = http_request_new(logger);
+
+  rapp_request_sprintf(http_request, "%s", "some room already used");
+  formatted = rapp_request_sprintf(http_request, "<%s>", long_string);
+
+  ck_assert(formatted != NULL);
+  ck_assert_int_eq(strlen(formatted), 8193);
+  ck_assert_int_eq(formatted[8192], '>');
+
+  free(long_string);
 }
 END_TEST
 
@@ -284,7 +462,14 @@ httprequest_suite(void)
   tcase_add_test(tc, test_httprequest_gets_all_the_headers);
   tcase_add_test(tc, test_httprequest_gets_a_specific_header);
   tcase_add_test(tc, test_httprequest_error_on_not_existent_header);
+  tcase_add_test(tc, test_httprequest_gets_the_first_of_repeated_headers);
+  tcase_add_test(tc, test_httprequest_gets_the_known_headers);
   tcase_add_test(tc, test_httprequest_gets_the_body);
+  tcase_add_test(tc, test_httprequest_gets_the_chunked_body);
+  tcase_add_test(tc, test_httprequest_gets_the_url_split_across_reads);
+  tcase_add_test(tc, test_httprequest_gets_pipelined_requests);
+  tcase_add_test(tc, test_httprequest_arena_keeps_the_allocations_apart);
+  tcase_add_test(tc, test_httprequest_arena_formats_strings_longer_than_a_block);
   suite_add_tcase(s, tc);
 
   return s;
@@ -15,9 +15,16 @@
 #include "httprequest.h"
 
 
+#define STREAM_CHUNKS 200
+#define STREAM_CHUNK "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+
 struct Logger *logger = NULL;
 struct HTTPRequestQueue *queue = NULL;
 
+struct HTTPRequest *streamed = NULL;
+size_t streamed_length;
+int streamed_ends;
+
 void setup()
 {
   logger = logger_new_null();
@@ -81,6 +88,185 @@ START_TEST(test_httprequestqueue_returns_error_on_too_many_headers)
 }
 END_TEST
 
+START_TEST(test_httprequestqueue_tracks_the_request_part_being_received)
+{
+  char *headers = "POST /hello/world/ HTTP/1.1\r\nHost: someserver\r\n";
+  char *end_of_headers = "Content-Length: 12\r\n\r\nHello ";
+  char *body = "world!";
+
+  ck_assert_int_eq(http_request_queue_get_state(queue), HTTP_REQUEST_QUEUE_IDLE);
+
+  http_request_queue_append_data(queue, headers, strlen(headers));
+  ck_assert_int_eq(http_request_queue_get_state(queue), HTTP_REQUEST_QUEUE_HEADERS);
+
+  http_request_queue_append_data(queue, end_of_headers, strlen(end_of_headers));
+  ck_assert_int_eq(http_request_queue_get_state(queue), HTTP_REQUEST_QUEUE_BODY);
+
+  http_request_queue_append_data(queue, body, strlen(body));
+  ck_assert_int_eq(http_request_queue_get_state(queue), HTTP_REQUEST_QUEUE_IDLE);
+}
+END_TEST
+
+static void
+serve_request_func(struct HTTPRequestQueue *q,
+                   void                    *data)
+{
+  struct HTTPRequest *request = http_request_queue_get_next_request(q);
+
+  ck_assert(request != NULL);
+  ck_assert_int_eq(http_request_is_last(request), 0);
+  http_request_destroy(request);
+
+  (*(int *)(data))++;
+}
+
+static void
+pause_func(struct HTTPRequestQueue *q,
+           void                    *data)
+{
+  serve_request_func(q, data);
+  http_request_queue_pause(q);
+}
+
+START_TEST(test_httprequestqueue_serves_any_number_of_requests)
+{
+  int served = 0;
+  int i = 0;
+  char *request = "GET /hello/world/ HTTP/1.1\r\n\r\n";
+
+  http_request_queue_set_new_request_callback(queue, serve_request_func, &served);
+
+  for (i = 0; i < 1000; i++)
+    ck_assert_int_eq(http_request_queue_append_data(queue, request, strlen(request)), 0);
+
+  ck_assert_int_eq(served, 1000);
+}
+END_TEST
+
+START_TEST(test_httprequestqueue_parses_the_data_received_while_paused_on_resume)
+{
+  int served = 0;
+  char *requests = "GET /first HTTP/1.1\r\n\r\nGET /second HTTP/1.1\r\n\r\n";
+
+  http_request_queue_set_new_request_callback(queue, pause_func, &served);
+
+  ck_assert_int_eq(http_request_queue_append_data(queue, requests, strlen(requests)), 0);
+  ck_assert_int_eq(served, 1);
+
+  ck_assert_int_eq(http_request_queue_resume(queue), 0);
+  ck_assert_int_eq(served, 2);
+}
+END_TEST
+
+START_TEST(test_httprequestqueue_refuses_a_content_length_too_large)
+{
+  char *request = "POST /upload HTTP/1.1\r\nContent-Length: 12\r\n\r\n";
+
+  http_request_queue_set_max_body_size(queue, 8);
+
+  ck_assert_int_eq(http_request_queue_append_data(queue, request, strlen(request)), -1);
+  ck_assert_int_eq(http_request_queue_get_error(queue), HTTP_REQUEST_QUEUE_ERROR_BODY_TOO_LARGE);
+}
+END_TEST
+
+START_TEST(test_httprequestqueue_refuses_a_chunked_body_too_large)
+{
+  int served = 0;
+  char *request = "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                  "5\r\nhello\r\n";
+  char *more = "5\r\nworld\r\n0\r\n\r\n";
+
+  http_request_queue_set_new_request_callback(queue, serve_request_func, &served);
+  http_request_queue_set_max_body_size(queue, 8);
+
+  ck_assert_int_eq(http_request_queue_append_data(queue, request, strlen(request)), 0);
+  ck_assert_int_eq(http_request_queue_append_data(queue, more, strlen(more)), -1);
+  ck_assert_int_eq(http_request_queue_get_error(queue), HTTP_REQUEST_QUEUE_ERROR_BODY_TOO_LARGE);
+  ck_assert_int_eq(served, 0);
+}
+END_TEST
+
+static int
+stream_func(struct HTTPRequestQueue *q,
+            struct HTTPRequest      *request,
+            void                    *data)
+{
+  return 1;
+}
+
+static void
+take_streamed_func(struct HTTPRequestQueue *q,
+                   void                    *data)
+{
+  struct HTTPRequest *request = http_request_queue_get_next_request(q);
+
+  ck_assert(request != NULL);
+
+  if (http_request_get_method(request) == HTTP_METHOD_POST) {
+    ck_assert(http_request_get_body(request) == NULL);
+    streamed = request;
+  }
+  else {
+    http_request_destroy(request);
+  }
+
+  (*(int *)(data))++;
+}
+
+static void
+body_func(struct HTTPRequestQueue *q,
+          const char              *chunk,
+          size_t                   length,
+          void                    *data)
+{
+  ck_assert(streamed != NULL);
+
+  if (length == 0) {
+    streamed_ends++;
+    http_request_destroy(streamed);
+    streamed = NULL;
+    return;
+  }
+
+  ck_assert(memcmp(chunk, STREAM_CHUNK, length) == 0);
+  streamed_length += length;
+}
+
+START_TEST(test_httprequestqueue_streams_bodies_larger_than_the_limit)
+{
+  int served = 0;
+  int i = 0;
+  char *headers = "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+  char *chunk = "40\r\n" STREAM_CHUNK "\r\n";
+  char *end = "0\r\n\r\nGET /next HTTP/1.1\r\n\r\n";
+  struct MemoryRange range;
+
+  http_request_queue_set_new_request_callback(queue, take_streamed_func, &served);
+  http_request_queue_set_stream_callbacks(queue, stream_func, body_func, NULL);
+  http_request_queue_set_max_body_size(queue, 8);
+  streamed_length = 0;
+  streamed_ends = 0;
+
+  /* the request is handed out before its body */
+  ck_assert_int_eq(http_request_queue_append_data(queue, headers, strlen(headers)), 0);
+  ck_assert_int_eq(served, 1);
+  ck_assert(streamed != NULL);
+
+  for (i = 0; i < STREAM_CHUNKS; i++) {
+    ck_assert_int_eq(http_request_queue_append_data(queue, chunk, strlen(chunk)), 0);
+
+    /* the headers are kept while the body is dropped */
+    http_request_get_url_range(streamed, &range);
+    ck_assert(strncmp(&(http_request_get_headers_buffer(streamed)[range.offset]), "/upload", range.length) == 0);
+  }
+
+  ck_assert_int_eq(http_request_queue_append_data(queue, end, strlen(end)), 0);
+  ck_assert_int_eq(streamed_length, STREAM_CHUNKS * strlen(STREAM_CHUNK));
+  ck_assert_int_eq(streamed_ends, 1);
+  ck_assert_int_eq(served, 2);
+  ck_assert_int_eq(http_request_queue_get_state(queue), HTTP_REQUEST_QUEUE_IDLE);
+}
+END_TEST
 
 static Suite *
 httprequestqueue_suite(void)
@@ -92,6 +278,12 @@ httprequestqueue_suite(void)
   tcase_add_test(tc, test_httprequestqueue_error_on_invalid_request);
   tcase_add_test(tc, test_httprequestqueue_calls_callback_when_new_request_is_processed);
   tcase_add_test(tc, test_httprequestqueue_returns_error_on_too_many_headers);
+  tcase_add_test(tc, test_httprequestqueue_tracks_the_request_part_being_received);
+  tcase_add_test(tc, test_httprequestqueue_serves_any_number_of_requests);
+  tcase_add_test(tc, test_httprequestqueue_parses_the_data_received_while_paused_on_resume);
+  tcase_add_test(tc, test_httprequestqueue_refuses_a_content_length_too_large);
+  tcase_add_test(tc, test_httprequestqueue_refuses_a_chunked_body_too_large);
+  tcase_add_test(tc, test_httprequestqueue_streams_bodies_larger_than_the_limit);
   suite_add_tcase(s, tc);
 
   return s;
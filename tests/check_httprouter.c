@@ -6,6 +6,8 @@
  */
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 
 #include <check.h>
 
@@ -308,6 +310,7 @@ static struct RouteTestData test_data[] = {
   { "/app",           },
   { "/app/sub",       },
   { "/app/sub/path",  },
+  { "/stats",         },
   { NULL, }
 };
 
@@ -387,6 +390,291 @@ START_TEST(test_httproter_match_right_route_longest2)
 }
 END_TEST
 
+START_TEST(test_httproter_match_right_route_longest3)
+{
+  check_match_right_route("/app/sub/other", 3, ROUTE_MATCH_LONGEST);
+}
+END_TEST
+
+START_TEST(test_httproter_match_right_route_longest4)
+{
+  check_match_right_route("/stats/today", 5, ROUTE_MATCH_LONGEST);
+}
+END_TEST
+
+START_TEST(test_httproter_match_right_route_longest5)
+{
+  check_match_right_route("/stat", 0, ROUTE_MATCH_LONGEST);
+}
+END_TEST
+
+START_TEST(test_httproter_match_right_route_first3)
+{
+  check_match_right_route("/stats/today", 0, ROUTE_MATCH_FIRST);
+}
+END_TEST
+
+START_TEST(test_httprouter_match_longest_whatever_the_bind_order)
+{
+  struct Logger *logger = logger_new_null();
+  struct HTTPRouter *router = NULL;
+  struct HTTPRequest *request = NULL;
+  struct RappContainer long_data = { 0, 0 };
+  struct RappContainer short_data = { 0, 0 };
+  struct Container *long_route = NULL;
+  struct Container *short_route = NULL;
+
+  long_route = container_new_custom(logger, "long", debug_init, debug_serve, debug_destroy, &long_data);
+  short_route = container_new_custom(logger, "short", debug_init, debug_serve, debug_destroy, &short_data);
+
+  router = http_router_new(logger, ROUTE_MATCH_LONGEST);
+  ck_assert_int_eq(http_router_bind(router, "/app/sub", long_route), 0);
+  ck_assert_int_eq(http_router_bind(router, "/app", short_route), 0);
+
+  request = http_request_new_fake_url(logger, "/app/sub/path");
+  ck_assert_int_eq(http_router_serve(router, request, (struct HTTPResponse *)request), 0); /* FIXME */
+  http_request_destroy(request);
+
+  ck_assert_int_eq(long_data.invoke_count, 1);
+  ck_assert_int_eq(short_data.invoke_count, 0);
+
+  container_destroy(long_route);
+  container_destroy(short_route);
+  http_router_destroy(router);
+  logger_destroy(logger);
+}
+END_TEST
+
+
+/* a request as the queue would parse it, with just the Host header */
+static struct HTTPRequest *
+new_request(struct Logger  *logger,
+            enum HTTPMethod method,
+            const char     *host,
+            const char     *path)
+{
+  struct HTTPRequest *request = NULL;
+  char *buffer = NULL;
+
+  request = http_request_new(logger);
+  ck_assert(request != NULL);
+  buffer = rapp_request_sprintf(request, "%sHost%s", path, host);
+  ck_assert(buffer != NULL);
+
+  http_request_set_headers_buffer(request, buffer);
+  http_request_set_method(request, method);
+  http_request_set_url_range(request, 0, strlen(path));
+  http_request_set_url_field_range(request, HTTP_URL_FIELD_PATH, 0, strlen(path));
+  http_request_set_header_key_range(request, 0, strlen(path), 4, http_header_hash(HTTP_HEADER_HASH_INIT, "Host", 4));
+  http_request_set_header_value_range(request, 0, strlen(path) + 4, strlen(host));
+
+  return request;
+}
+
+static void
+check_param(struct HTTPRequest *request,
+            const char         *name,
+            const char         *value)
+{
+  struct MemoryRange range;
+
+  ck_assert_int_eq(http_request_get_param_range(request, name, &range), 0);
+  ck_assert_int_eq(range.length, strlen(value));
+  ck_assert(strncmp(http_request_get_headers_buffer(request) + range.offset, value, range.length) == 0);
+}
+
+START_TEST(test_httprouter_pattern_captures_params)
+{
+  struct Logger *logger = logger_new_null();
+  struct HTTPRouter *router = NULL;
+  struct HTTPRequest *request = NULL;
+  struct RappContainer data = { 0, 0 };
+  struct MemoryRange range;
+  struct Container *debug = NULL;
+
+  debug = container_new_custom(logger, "debug", debug_init, debug_serve, debug_destroy, &data);
+
+  router = http_router_new(logger, ROUTE_MATCH_LONGEST);
+  ck_assert_int_eq(http_router_bind_pattern(router, HTTP_ROUTER_ANY_METHOD, NULL, "/users/:user/posts/:post", debug), 0);
+
+  request = http_request_new_fake_url(logger, "/users/42/posts/7");
+  ck_assert_int_eq(http_router_serve(router, request, (struct HTTPResponse *)request), 0); /* FIXME */
+  ck_assert_int_eq(data.invoke_count, 1);
+  check_param(request, "user", "42");
+  check_param(request, "post", "7");
+  ck_assert_int_eq(http_request_get_param_range(request, "comment", &range), -1);
+  http_request_destroy(request);
+
+  /* the whole path must match, and the params can't be empty */
+  request = http_request_new_fake_url(logger, "/users/42/posts");
+  ck_assert_int_eq(http_router_serve(router, request, (struct HTTPResponse *)request), -1); /* FIXME */
+  http_request_destroy(request);
+  request = http_request_new_fake_url(logger, "/users//posts/7");
+  ck_assert_int_eq(http_router_serve(router, request, (struct HTTPResponse *)request), -1); /* FIXME */
+  http_request_destroy(request);
+  ck_assert_int_eq(data.invoke_count, 1);
+
+  container_destroy(debug);
+  http_router_destroy(router);
+  logger_destroy(logger);
+}
+END_TEST
+
+START_TEST(test_httprouter_pattern_static_before_params_before_wildcard)
+{
+  struct Logger *logger = logger_new_null();
+  struct HTTPRouter *router = NULL;
+  struct HTTPRequest *request = NULL;
+  struct RappContainer static_data = { 0, 0 };
+  struct RappContainer param_data = { 0, 0 };
+  struct RappContainer wildcard_data = { 0, 0 };
+  struct Container *static_route = NULL;
+  struct Container *param_route = NULL;
+  struct Container *wildcard_route = NULL;
+
+  static_route = container_new_custom(logger, "static", debug_init, debug_serve, debug_destroy, &static_data);
+  param_route = container_new_custom(logger, "param", debug_init, debug_serve, debug_destroy, &param_data);
+  wildcard_route = container_new_custom(logger, "wildcard", debug_init, debug_serve, debug_destroy, &wildcard_data);
+
+  router = http_router_new(logger, ROUTE_MATCH_FIRST);
+  ck_assert_int_eq(http_router_bind_pattern(router, HTTP_ROUTER_ANY_METHOD, NULL, "/files/*path", wildcard_route), 0);
+  ck_assert_int_eq(http_router_bind_pattern(router, HTTP_ROUTER_ANY_METHOD, NULL, "/files/:name/raw", param_route), 0);
+  ck_assert_int_eq(http_router_bind_pattern(router, HTTP_ROUTER_ANY_METHOD, NULL, "/files/index/raw", static_route), 0);
+
+  request = http_request_new_fake_url(logger, "/files/index/raw");
+  ck_assert_int_eq(http_router_serve(router, request, (struct HTTPResponse *)request), 0); /* FIXME */
+  http_request_destroy(request);
+  ck_assert_int_eq(static_data.invoke_count, 1);
+
+  request = http_request_new_fake_url(logger, "/files/readme/raw");
+  ck_assert_int_eq(http_router_serve(router, request, (struct HTTPResponse *)request), 0); /* FIXME */
+  check_param(request, "name", "readme");
+  http_request_destroy(request);
+  ck_assert_int_eq(param_data.invoke_count, 1);
+
+  /* backtracks from the param to the wildcard */
+  request = http_request_new_fake_url(logger, "/files/readme/raw/more");
+  ck_assert_int_eq(http_router_serve(router, request, (struct HTTPResponse *)request), 0); /* FIXME */
+  check_param(request, "path", "readme/raw/more");
+  http_request_destroy(request);
+
+  request = http_request_new_fake_url(logger, "/files/");
+  ck_assert_int_eq(http_router_serve(router, request, (struct HTTPResponse *)request), 0); /* FIXME */
+  check_param(request, "path", "");
+  http_request_destroy(request);
+  ck_assert_int_eq(wildcard_data.invoke_count, 2);
+
+  container_destroy(static_route);
+  container_destroy(param_route);
+  container_destroy(wildcard_route);
+  http_router_destroy(router);
+  logger_destroy(logger);
+}
+END_TEST
+
+START_TEST(test_httprouter_pattern_before_prefix)
+{
+  struct Logger *logger = logger_new_null();
+  struct HTTPRouter *router = NULL;
+  struct HTTPRequest *request = NULL;
+  struct RappContainer prefix_data = { 0, 0 };
+  struct RappContainer pattern_data = { 0, 0 };
+  struct Container *prefix_route = NULL;
+  struct Container *pattern_route = NULL;
+
+  prefix_route = container_new_custom(logger, "prefix", debug_init, debug_serve, debug_destroy, &prefix_data);
+  pattern_route = container_new_custom(logger, "pattern", debug_init, debug_serve, debug_destroy, &pattern_data);
+
+  router = http_router_new(logger, ROUTE_MATCH_LONGEST);
+  ck_assert_int_eq(http_router_bind(router, "/api", prefix_route), 0);
+  ck_assert_int_eq(http_router_bind_pattern(router, HTTP_ROUTER_ANY_METHOD, NULL, "/api/:version", pattern_route), 0);
+
+  request = http_request_new_fake_url(logger, "/api/v1");
+  ck_assert_int_eq(http_router_serve(router, request, (struct HTTPResponse *)request), 0); /* FIXME */
+  http_request_destroy(request);
+  request = http_request_new_fake_url(logger, "/api/v1/users");
+  ck_assert_int_eq(http_router_serve(router, request, (struct HTTPResponse *)request), 0); /* FIXME */
+  http_request_destroy(request);
+
+  ck_assert_int_eq(pattern_data.invoke_count, 1);
+  ck_assert_int_eq(prefix_data.invoke_count, 1);
+
+  container_destroy(prefix_route);
+  container_destroy(pattern_route);
+  http_router_destroy(router);
+  logger_destroy(logger);
+}
+END_TEST
+
+START_TEST(test_httprouter_pattern_by_method_and_host)
+{
+  struct Logger *logger = logger_new_null();
+  struct HTTPRouter *router = NULL;
+  struct HTTPRequest *request = NULL;
+  struct RappContainer any_data = { 0, 0 };
+  struct RappContainer post_data = { 0, 0 };
+  struct RappContainer host_data = { 0, 0 };
+  struct Container *any_route = NULL;
+  struct Container *post_route = NULL;
+  struct Container *host_route = NULL;
+
+  any_route = container_new_custom(logger, "any", debug_init, debug_serve, debug_destroy, &any_data);
+  post_route = container_new_custom(logger, "post", debug_init, debug_serve, debug_destroy, &post_data);
+  host_route = container_new_custom(logger, "host", debug_init, debug_serve, debug_destroy, &host_data);
+
+  router = http_router_new(logger, ROUTE_MATCH_FIRST);
+  ck_assert_int_eq(http_router_bind_pattern(router, HTTP_ROUTER_ANY_METHOD, NULL, "/items", any_route), 0);
+  ck_assert_int_eq(http_router_bind_pattern(router, HTTP_METHOD_POST, NULL, "/items", post_route), 0);
+  ck_assert_int_eq(http_router_bind_pattern(router, HTTP_ROUTER_ANY_METHOD, "admin.example.org", "/items", host_route), 0);
+
+  request = new_request(logger, HTTP_METHOD_GET, "www.example.org", "/items");
+  ck_assert_int_eq(http_router_serve(router, request, (struct HTTPResponse *)request), 0); /* FIXME */
+  http_request_destroy(request);
+  ck_assert_int_eq(any_data.invoke_count, 1);
+
+  request = new_request(logger, HTTP_METHOD_POST, "www.example.org", "/items");
+  ck_assert_int_eq(http_router_serve(router, request, (struct HTTPResponse *)request), 0); /* FIXME */
+  http_request_destroy(request);
+  ck_assert_int_eq(post_data.invoke_count, 1);
+
+  /* the host is more specific than the method, and compared without the port */
+  request = new_request(logger, HTTP_METHOD_POST, "Admin.Example.org:8080", "/items");
+  ck_assert_int_eq(http_router_serve(router, request, (struct HTTPResponse *)request), 0); /* FIXME */
+  http_request_destroy(request);
+  ck_assert_int_eq(host_data.invoke_count, 1);
+
+  ck_assert_int_eq(any_data.invoke_count, 1);
+  ck_assert_int_eq(post_data.invoke_count, 1);
+
+  container_destroy(any_route);
+  container_destroy(post_route);
+  container_destroy(host_route);
+  http_router_destroy(router);
+  logger_destroy(logger);
+}
+END_TEST
+
+START_TEST(test_httprouter_pattern_invalid)
+{
+  struct Logger *logger = logger_new_null();
+  struct HTTPRouter *router = NULL;
+  struct RappContainer data = { 0, 0 };
+  struct Container *debug = NULL;
+
+  debug = container_new_custom(logger, "debug", debug_init, debug_serve, debug_destroy, &data);
+
+  router = http_router_new(logger, ROUTE_MATCH_FIRST);
+  ck_assert_int_eq(http_router_bind_pattern(router, HTTP_ROUTER_ANY_METHOD, NULL, "users/:id", debug), -1);
+  ck_assert_int_eq(http_router_bind_pattern(router, HTTP_ROUTER_ANY_METHOD, NULL, "/users/:", debug), -1);
+  ck_assert_int_eq(http_router_bind_pattern(router, HTTP_ROUTER_ANY_METHOD, NULL, "/files/*path/raw", debug), -1);
+  ck_assert_int_eq(http_router_bind_pattern(router, HTTP_ROUTER_ANY_METHOD, NULL, "/:a/:b/:c/:d/:e/:f/:g/:h/:i", debug), -1);
+
+  container_destroy(debug);
+  http_router_destroy(router);
+  logger_destroy(logger);
+}
+END_TEST
+
 
 static Suite *
 httprouter_suite(void)
@@ -416,6 +704,17 @@ httprouter_suite(void)
   tcase_add_test(tc, test_httproter_match_right_route_longest1);
   tcase_add_test(tc, test_httproter_match_right_route_first2);
   tcase_add_test(tc, test_httproter_match_right_route_longest2);
+  tcase_add_test(tc, test_httproter_match_right_route_longest3);
+  tcase_add_test(tc, test_httproter_match_right_route_longest4);
+  tcase_add_test(tc, test_httproter_match_right_route_longest5);
+  tcase_add_test(tc, test_httproter_match_right_route_first3);
+  tcase_add_test(tc, test_httprouter_match_longest_whatever_the_bind_order);
+
+  tcase_add_test(tc, test_httprouter_pattern_captures_params);
+  tcase_add_test(tc, test_httprouter_pattern_static_before_params_before_wildcard);
+  tcase_add_test(tc, test_httprouter_pattern_before_prefix);
+  tcase_add_test(tc, test_httprouter_pattern_by_method_and_host);
+  tcase_add_test(tc, test_httprouter_pattern_invalid);
 
   suite_add_tcase(s, tc);
 
@@ -8,6 +8,7 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <check.h>
 
@@ -208,6 +209,106 @@ START_TEST(test_logger_custom)
 }
 END_TEST
 
+static int evaluated = 0;
+
+static const char *
+evaluate(void)
+{
+  evaluated++;
+  return TEST_MSG;
+}
+
+START_TEST(test_logger_trace_macro_checks_the_level_first)
+{
+  char buf[128] = { '\0' };
+  struct Buffer logbuf;
+  struct Logger *logger = NULL;
+
+  logbuf.data = buf;
+  logbuf.size = sizeof(buf);
+  evaluated = 0;
+
+  logger = logger_new_custom(LOG_INFO, buffer_logger, &logbuf);
+  ck_assert(logger != NULL);
+
+  LOGGER_DEBUG(logger, "", "%s", evaluate());
+  ck_assert_int_eq(evaluated, 0);
+  ck_assert_str_eq(logbuf.data, "");
+
+  LOGGER_INFO(logger, "", "%s", evaluate());
+  ck_assert_int_eq(evaluated, 1);
+  ck_assert_str_eq(logbuf.data, TEST_MSG);
+
+  logger_destroy(logger);
+
+  logger = logger_new_null();
+  LOGGER_ERROR(logger, "", "%s", evaluate());
+  ck_assert_int_eq(evaluated, 1);
+  logger_destroy(logger);
+}
+END_TEST
+
+START_TEST(test_logger_async)
+{
+  int err = 0;
+  FILE *sink = NULL;
+  struct Logger *logger = NULL;
+
+  sink = tmpfile();
+  ck_assert(sink != NULL);
+
+  logger = logger_new_async(LOG_MARK, sink, 0);
+  ck_assert(logger != NULL);
+  err = logger_trace(logger, LOG_CRITICAL, __FILE__, "%s", TEST_MSG);
+  ck_assert_int_eq(err, 0);
+  err = logger_flush(logger);
+  ck_assert_int_eq(err, 0);
+
+  ck_assert_file_content(sink, TEST_MSG, strlen(TEST_MSG));
+  ck_assert_int_eq(logger_get_dropped(logger), 0);
+
+  logger_destroy(logger);
+  fclose(sink);
+}
+END_TEST
+
+
+#define ASYNC_LINES   1000
+
+START_TEST(test_logger_async_counts_the_dropped_lines)
+{
+  char line[HUGE_BUF_SZ] = { '\0' };
+  FILE *sink = NULL;
+  struct Logger *logger = NULL;
+  unsigned long dropped = 0;
+  long written = 0;
+  int i = 0;
+
+  memset(line, 'Z', HUGE_MSG_LEN);
+
+  sink = tmpfile();
+  ck_assert(sink != NULL);
+
+  logger = logger_new_async(LOG_MARK, sink, 0);
+  ck_assert(logger != NULL);
+
+  /* way more than the writer can take at once, it must never block */
+  for (i = 0; i < ASYNC_LINES; i++) {
+    ck_assert_int_eq(logger_trace(logger, LOG_MARK, __FILE__, "%s", line), 0);
+  }
+  logger_flush(logger);
+  dropped = logger_get_dropped(logger);
+  logger_destroy(logger);
+
+  fseek(sink, 0, SEEK_END);
+  written = ftell(sink);
+  ck_assert(dropped <= ASYNC_LINES);
+  ck_assert_int_eq(written, (ASYNC_LINES - dropped) * HUGE_MSG_LEN);
+
+  fclose(sink);
+}
+END_TEST
+
 static Suite *
 logger_suite(void)
 {
@@ -220,6 +321,9 @@ logger_suite(void)
   tcase_add_test(tc, test_logger_file_huge_msg);
   tcase_add_test(tc, test_logger_console_plain);
   tcase_add_test(tc, test_logger_custom);
+  tcase_add_test(tc, test_logger_trace_macro_checks_the_level_first);
+  tcase_add_test(tc, test_logger_async);
+  tcase_add_test(tc, test_logger_async_counts_the_dropped_lines);
   suite_add_tcase(s, tc);
 
   return s;
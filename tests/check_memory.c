@@ -0,0 +1,152 @@
+/*
+ * check_memory.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include <check.h>
+
+#include "memory.h"
+
+
+void
+teardown(void)
+{
+  memory_pool_cleanup();
+}
+
+START_TEST(test_memory_pool_reuses_the_last_destroyed_object)
+{
+  void *first = memory_pool_create(MEMORY_POOL_HTTP_REQUEST, 100);
+  void *second = memory_pool_create(MEMORY_POOL_HTTP_REQUEST, 100);
+
+  ck_assert(first != NULL);
+  ck_assert(second != NULL);
+  ck_assert(first != second);
+
+  memory_pool_destroy(MEMORY_POOL_HTTP_REQUEST, first);
+  ck_assert(memory_pool_create(MEMORY_POOL_HTTP_REQUEST, 100) == first);
+
+  memory_pool_destroy(MEMORY_POOL_HTTP_REQUEST, second);
+  memory_pool_destroy(MEMORY_POOL_HTTP_REQUEST, first);
+}
+END_TEST
+
+START_TEST(test_memory_pool_creates_zeroed_aligned_objects)
+{
+  unsigned char *object = NULL;
+  size_t i = 0;
+
+  object = memory_pool_create(MEMORY_POOL_HTTP_RESPONSE, 40);
+  memset(object, 0xff, 40);
+  memory_pool_destroy(MEMORY_POOL_HTTP_RESPONSE, object);
+
+  object = memory_pool_create(MEMORY_POOL_HTTP_RESPONSE, 40);
+  ck_assert_int_eq((uintptr_t)object % 16, 0);
+  for (i = 0; i < 40; i++)
+    ck_assert_int_eq(object[i], 0);
+
+  memory_pool_destroy(MEMORY_POOL_HTTP_RESPONSE, object);
+}
+END_TEST
+
+START_TEST(test_memory_pool_creates_objects_bigger_than_a_slab)
+{
+  size_t size = 100 * 1024;
+  char *first = memory_pool_create(MEMORY_POOL_HTTP_RESPONSE_CHUNK, size);
+  char *second = memory_pool_create(MEMORY_POOL_HTTP_RESPONSE_CHUNK, size);
+
+  ck_assert(first != NULL);
+  ck_assert(second != NULL);
+  ck_assert(first + size <= second || second + size <= first);
+
+  memset(first, 1, size);
+  memset(second, 2, size);
+  ck_assert_int_eq(first[size - 1], 1);
+
+  memory_pool_destroy(MEMORY_POOL_HTTP_RESPONSE_CHUNK, first);
+  memory_pool_destroy(MEMORY_POOL_HTTP_RESPONSE_CHUNK, second);
+}
+END_TEST
+
+static void *
+create_objects(void *data)
+{
+  void **objects = (void **)data;
+  int i = 0;
+
+  for (i = 0; i < 1000; i++)
+    objects[i] = memory_pool_create(MEMORY_POOL_TCP_CONNECTION, 64);
+
+  return NULL;
+}
+
+START_TEST(test_memory_pool_objects_can_be_destroyed_by_another_thread)
+{
+  void *objects[2][1000];
+  pthread_t threads[2];
+  int i = 0;
+  int j = 0;
+
+  for (i = 0; i < 2; i++)
+    pthread_create(&(threads[i]), NULL, create_objects, objects[i]);
+  for (i = 0; i < 2; i++)
+    pthread_join(threads[i], NULL);
+
+  /* no object is handed out twice */
+  for (i = 0; i < 1000; i++) {
+    ck_assert(objects[0][i] != NULL);
+    for (j = 0; j < 1000; j++)
+      ck_assert(objects[0][i] != objects[1][j]);
+  }
+
+  for (i = 0; i < 2; i++) {
+    for (j = 0; j < 1000; j++)
+      memory_pool_destroy(MEMORY_POOL_TCP_CONNECTION, objects[i][j]);
+  }
+
+  ck_assert(memory_pool_create(MEMORY_POOL_TCP_CONNECTION, 64) == objects[1][999]);
+}
+END_TEST
+
+static Suite *
+memory_suite(void)
+{
+  Suite *s = suite_create("rapp.core.memory");
+  TCase *tc = tcase_create("rapp.core.memory");
+
+  tcase_add_checked_fixture(tc, NULL, teardown);
+  tcase_add_test(tc, test_memory_pool_reuses_the_last_destroyed_object);
+  tcase_add_test(tc, test_memory_pool_creates_zeroed_aligned_objects);
+  tcase_add_test(tc, test_memory_pool_creates_objects_bigger_than_a_slab);
+  tcase_add_test(tc, test_memory_pool_objects_can_be_destroyed_by_another_thread);
+  suite_add_tcase(s, tc);
+
+  return s;
+}
+
+int
+main (void)
+{
+ int number_failed = 0;
+
+ Suite *s = memory_suite();
+ SRunner *sr = srunner_create(s);
+
+ srunner_run_all(sr, CK_NORMAL);
+ number_failed = srunner_ntests_failed(sr);
+ srunner_free(sr);
+
+ return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
@@ -0,0 +1,209 @@
+/*
+ * check_metrics.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <logger.h>
+#include <memory.h>
+#include <metrics.h>
+
+struct Logger *logger = NULL;
+struct Metrics *metrics = NULL;
+
+void
+setup(void)
+{
+  logger = logger_new_null();
+  metrics = metrics_new(logger);
+  ck_assert(metrics != NULL);
+}
+
+void
+teardown(void)
+{
+  metrics_destroy(metrics);
+  logger_destroy(logger);
+}
+
+/* the text must contain line, as a whole line */
+static void
+assert_has_line(const char *text,
+                const char *line)
+{
+  const char *found = text;
+  size_t length = strlen(line);
+
+  while ((found = strstr(found, line)) != NULL) {
+    if ((found == text || found[-1] == '\n') && found[length] == '\n')
+      return;
+    found += length;
+  }
+
+  ck_abort_msg("missing line: %s", line);
+}
+
+static char *
+format(void)
+{
+  char *text = NULL;
+  size_t length = 0;
+
+  ck_assert((text = metrics_format(metrics, &length)) != NULL);
+  ck_assert_int_eq(strlen(text), length);
+
+  return text;
+}
+
+START_TEST(test_metrics_buckets_bound_their_values)
+{
+  uint64_t usec;
+  unsigned bucket;
+
+  for (usec = 0; usec < 4; usec++) {
+    ck_assert_int_eq(metrics_bucket(usec), usec);
+    ck_assert_int_eq(metrics_bucket_bound(usec), usec);
+  }
+
+  for (usec = 4; usec < 10000000; usec += 1 + usec / 64) {
+    bucket = metrics_bucket(usec);
+    ck_assert(bucket < METRICS_BUCKETS);
+    ck_assert(metrics_bucket_bound(bucket) >= usec);
+    ck_assert(metrics_bucket_bound(bucket - 1) < usec);
+    /* log-linear: the buckets are at most a quarter of their values wide */
+    ck_assert(metrics_bucket_bound(bucket) - metrics_bucket_bound(bucket - 1) <= usec / 4 + 1);
+  }
+
+  ck_assert_int_eq(metrics_bucket(UINT64_MAX), METRICS_BUCKETS - 1);
+}
+END_TEST
+
+START_TEST(test_metrics_not_attached_count_nothing)
+{
+  char *text = NULL;
+
+  ck_assert(!metrics_is_enabled());
+  metrics_count(METRICS_REQUESTS, 1);
+  metrics_observe_route(0, metrics_clock());
+
+  text = format();
+  assert_has_line(text, "rapp_requests_total 0");
+  assert_has_line(text, "rapp_handler_duration_seconds_count{route=\"default\"} 0");
+  memory_destroy(text);
+}
+END_TEST
+
+static void *
+count_requests(void *data)
+{
+  ck_assert_int_eq(metrics_attach_thread(metrics), 0);
+  metrics_count(METRICS_REQUESTS, 2);
+  metrics_count(METRICS_CONNECTIONS, -1);
+  metrics_detach_thread();
+
+  return NULL;
+}
+
+START_TEST(test_metrics_threads_are_merged)
+{
+  pthread_t thread;
+  char *text = NULL;
+
+  ck_assert_int_eq(metrics_attach_thread(metrics), 0);
+  ck_assert(metrics_is_enabled());
+  metrics_count(METRICS_REQUESTS, 1);
+  metrics_count(METRICS_BYTES_IN, 1000);
+
+  ck_assert_int_eq(pthread_create(&thread, NULL, count_requests, NULL), 0);
+  ck_assert_int_eq(pthread_join(thread, NULL), 0);
+
+  text = format();
+  assert_has_line(text, "# TYPE rapp_requests_total counter");
+  assert_has_line(text, "rapp_requests_total 3");
+  assert_has_line(text, "rapp_received_bytes_total 1000");
+  assert_has_line(text, "# TYPE rapp_connections gauge");
+  assert_has_line(text, "rapp_connections -1");
+  memory_destroy(text);
+}
+END_TEST
+
+START_TEST(test_metrics_routes_have_histograms)
+{
+  unsigned route;
+  char *text = NULL;
+
+  ck_assert((route = metrics_add_route(metrics, "/say \"hi\"")) == 1);
+  ck_assert_int_eq(metrics_attach_thread(metrics), 0);
+
+  metrics_observe_route(route, metrics_clock() - 1000000);
+  metrics_observe_route(route, metrics_clock() - 1000000);
+  metrics_observe_route(METRICS_MAX_ROUTES, metrics_clock());
+
+  text = format();
+  assert_has_line(text, "# TYPE rapp_handler_duration_seconds histogram");
+  assert_has_line(text, "rapp_handler_duration_seconds_bucket{route=\"/say \\\"hi\\\"\",le=\"+Inf\"} 2");
+  assert_has_line(text, "rapp_handler_duration_seconds_count{route=\"/say \\\"hi\\\"\"} 2");
+  assert_has_line(text, "rapp_handler_duration_seconds_count{route=\"default\"} 1");
+  /* one second and a bit, in the same bucket */
+  ck_assert(strstr(text, "rapp_handler_duration_seconds_bucket{route=\"/say \\\"hi\\\"\",le=\"1.") != NULL);
+  ck_assert(strstr(text, "rapp_handler_duration_seconds_sum{route=\"/say \\\"hi\\\"\"} 2.") != NULL);
+  memory_destroy(text);
+}
+END_TEST
+
+START_TEST(test_metrics_routes_are_limited)
+{
+  char label[16];
+  unsigned i;
+
+  for (i = 1; i < METRICS_MAX_ROUTES; i++) {
+    snprintf(label, sizeof(label), "/%u", i);
+    ck_assert_int_eq(metrics_add_route(metrics, label), i);
+  }
+
+  ck_assert_int_eq(metrics_add_route(metrics, "/more"), 0);
+}
+END_TEST
+
+static Suite *
+metrics_suite(void)
+{
+  Suite *s = suite_create("rapp.core.metrics");
+  TCase *tc = tcase_create("rapp.core.metrics");
+
+  tcase_add_checked_fixture(tc, setup, teardown);
+  tcase_add_test(tc, test_metrics_buckets_bound_their_values);
+  tcase_add_test(tc, test_metrics_not_attached_count_nothing);
+  tcase_add_test(tc, test_metrics_threads_are_merged);
+  tcase_add_test(tc, test_metrics_routes_have_histograms);
+  tcase_add_test(tc, test_metrics_routes_are_limited);
+  suite_add_tcase(s, tc);
+
+  return s;
+}
+
+int
+main (void)
+{
+  int number_failed = 0;
+
+  Suite *s = metrics_suite();
+  SRunner *sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
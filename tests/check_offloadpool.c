@@ -0,0 +1,144 @@
+/*
+ * check_offloadpool.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <check.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <logger.h>
+#include <eloop.h>
+#include <offloadpool.h>
+
+#define THREADS 2
+#define JOBS 8
+
+struct ELoop *eloop = NULL;
+struct OffloadPool *pool = NULL;
+struct Logger *logger;
+pthread_t loop_thread;
+struct OffloadJob jobs[JOBS];
+int worked;
+int done;
+
+static void
+work_func(struct OffloadJob *job)
+{
+  ck_assert(!pthread_equal(pthread_self(), loop_thread));
+
+  __atomic_add_fetch(&worked, 1, __ATOMIC_RELAXED);
+}
+
+static void
+done_func(void *data)
+{
+  ck_assert(pthread_equal(pthread_self(), loop_thread));
+  ck_assert(data == eloop);
+
+  if (++done == JOBS)
+    event_loop_stop(eloop);
+}
+
+static void
+prepare_jobs(void)
+{
+  int i = 0;
+
+  for (i = 0; i < JOBS; i++) {
+    jobs[i].work = work_func;
+    jobs[i].eloop = eloop;
+    jobs[i].done.callback = done_func;
+    jobs[i].done.data = eloop;
+  }
+}
+
+void
+setup(void)
+{
+  logger = logger_new_null();
+  eloop = event_loop_new(logger);
+  pool = offload_pool_new(logger, THREADS);
+
+  loop_thread = pthread_self();
+  worked = 0;
+  done = 0;
+
+  prepare_jobs();
+}
+
+void
+teardown(void)
+{
+  if (pool != NULL)
+    offload_pool_destroy(pool);
+  event_loop_destroy(eloop);
+  logger_destroy(logger);
+}
+
+START_TEST(test_offloadpool_runs_jobs_and_posts_done_on_the_loop)
+{
+  int i = 0;
+
+  for (i = 0; i < JOBS; i++)
+    ck_assert_int_eq(offload_pool_submit(pool, &(jobs[i])), 0);
+
+  event_loop_run(eloop);
+
+  ck_assert_int_eq(worked, JOBS);
+  ck_assert_int_eq(done, JOBS);
+}
+END_TEST
+
+START_TEST(test_offloadpool_destroy_runs_the_queued_jobs)
+{
+  int i = 0;
+
+  for (i = 0; i < JOBS; i++)
+    ck_assert_int_eq(offload_pool_submit(pool, &(jobs[i])), 0);
+
+  offload_pool_destroy(pool);
+  pool = NULL;
+
+  ck_assert_int_eq(worked, JOBS);
+
+  /* the completions are waiting for the loop */
+  event_loop_run(eloop);
+  ck_assert_int_eq(done, JOBS);
+}
+END_TEST
+
+static Suite *
+offloadpool_suite(void)
+{
+  Suite *s = suite_create("rapp.core.offloadpool");
+  TCase *tc = tcase_create("rapp.core.offloadpool");
+
+  tcase_add_checked_fixture(tc, setup, teardown);
+  tcase_add_test(tc, test_offloadpool_runs_jobs_and_posts_done_on_the_loop);
+  tcase_add_test(tc, test_offloadpool_destroy_runs_the_queued_jobs);
+  suite_add_tcase(s, tc);
+
+  return s;
+}
+
+int
+main (void)
+{
+  int number_failed = 0;
+
+  Suite *s = offloadpool_suite();
+  SRunner *sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
@@ -0,0 +1,164 @@
+/*
+ * check_requesttracer.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <logger.h>
+#include <httprequest.h>
+#include <requesttracer.h>
+
+#define MSEC 1000000ULL
+
+struct Logger *logger = NULL;
+struct HTTPRequest *request = NULL;
+char logged[512];
+int lines = 0;
+
+static int
+buffer_logger(void       *data,
+              LogLevel    level,
+              const char *tag,
+              const char *fmt,
+              va_list     args)
+{
+  vsnprintf(logged, sizeof(logged), fmt, args);
+  lines++;
+
+  return 0;
+}
+
+void
+setup(void)
+{
+  logged[0] = '\0';
+  lines = 0;
+
+  logger = logger_new_custom(LOG_DEBUG, buffer_logger, NULL);
+  ck_assert(logger != NULL);
+
+  request = http_request_new_fake_url(logger, "/slow/one");
+  ck_assert(request != NULL);
+  http_request_set_method(request, HTTP_METHOD_GET);
+}
+
+void
+teardown(void)
+{
+  http_request_destroy(request);
+  logger_destroy(logger);
+}
+
+START_TEST(test_requesttracer_logs_the_slow_requests)
+{
+  struct RequestTracer *tracer = NULL;
+  struct RequestTrace trace;
+  uint64_t now = request_tracer_clock();
+
+  ck_assert((tracer = request_tracer_new(logger, 100, 1)) != NULL);
+
+  request_tracer_begin(tracer, &trace, request, now - 500 * MSEC);
+  ck_assert(trace.sampled);
+  ck_assert_str_eq(trace.url, "/slow/one");
+
+  /* as if the handler took 300ms */
+  trace.at[REQUEST_PHASE_PARSED] = now - 400 * MSEC;
+  trace.at[REQUEST_PHASE_ROUTED] = now - 400 * MSEC;
+  trace.at[REQUEST_PHASE_SERVED] = now - 100 * MSEC;
+  request_tracer_end(tracer, &trace);
+
+  ck_assert_int_eq(lines, 1);
+  ck_assert(strncmp(logged, "GET /slow/one took 5", strlen("GET /slow/one took 5")) == 0);
+  ck_assert(strstr(logged, " parse=100.000ms route=0.000ms serve=300.000ms write=") != NULL);
+
+  request_tracer_destroy(tracer);
+}
+END_TEST
+
+START_TEST(test_requesttracer_ignores_the_fast_requests)
+{
+  struct RequestTracer *tracer = NULL;
+  struct RequestTrace trace;
+
+  ck_assert((tracer = request_tracer_new(logger, 100, 1)) != NULL);
+
+  request_tracer_begin(tracer, &trace, request, request_tracer_clock());
+  request_trace_mark(&trace, REQUEST_PHASE_ROUTED);
+  request_trace_mark(&trace, REQUEST_PHASE_SERVED);
+  request_tracer_end(tracer, &trace);
+  ck_assert_int_eq(lines, 0);
+
+  /* the requests never parsed aren't traced */
+  request_tracer_begin(tracer, &trace, NULL, 1);
+  ck_assert(!trace.sampled);
+  request_tracer_end(tracer, &trace);
+  ck_assert_int_eq(lines, 0);
+
+  request_tracer_destroy(tracer);
+}
+END_TEST
+
+START_TEST(test_requesttracer_samples_the_requests)
+{
+  struct RequestTracer *tracer = NULL;
+  struct RequestTrace trace;
+  int sampled = 0;
+  int i;
+
+  ck_assert((tracer = request_tracer_new(logger, 0, 4)) != NULL);
+
+  for (i = 0; i < 12; i++) {
+    request_tracer_begin(tracer, &trace, request, 0);
+    if (trace.sampled)
+      sampled++;
+    request_tracer_end(tracer, &trace);
+  }
+
+  /* the first one is always taken */
+  ck_assert_int_eq(sampled, 3);
+  ck_assert_int_eq(lines, 3);
+
+  request_tracer_destroy(tracer);
+}
+END_TEST
+
+static Suite *
+requesttracer_suite(void)
+{
+  Suite *s = suite_create("rapp.core.requesttracer");
+  TCase *tc = tcase_create("rapp.core.requesttracer");
+
+  tcase_add_checked_fixture(tc, setup, teardown);
+  tcase_add_test(tc, test_requesttracer_logs_the_slow_requests);
+  tcase_add_test(tc, test_requesttracer_ignores_the_fast_requests);
+  tcase_add_test(tc, test_requesttracer_samples_the_requests);
+  suite_add_tcase(s, tc);
+
+  return s;
+}
+
+int
+main (void)
+{
+  int number_failed = 0;
+
+  Suite *s = requesttracer_suite();
+  SRunner *sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
@@ -128,7 +128,7 @@ START_TEST(test_tcp_connection_sendfile)
 
   file_fd = open("test_file.txt", O_RDONLY);
 
-  tcp_connection_sendfile(tcp_connection, file_fd, MESSAGE_LEN);
+  tcp_connection_sendfile(tcp_connection, file_fd, NULL, MESSAGE_LEN);
 
   close(file_fd);
   unlink("test_file.txt");
@@ -139,6 +139,28 @@ START_TEST(test_tcp_connection_sendfile)
 }
 END_TEST
 
+START_TEST(test_tcp_connection_sendfile_from_offset)
+{
+  int file_fd = open("test_file.txt", O_WRONLY | O_CREAT, 0640);
+  off_t offset = 6;
+
+  write(file_fd, MESSAGE, MESSAGE_LEN);
+  close(file_fd);
+
+  file_fd = open("test_file.txt", O_RDONLY);
+
+  ck_assert_int_eq(tcp_connection_sendfile(tcp_connection, file_fd, &offset, MESSAGE_LEN - 6), MESSAGE_LEN - 6);
+  ck_assert_int_eq(offset, MESSAGE_LEN);
+
+  close(file_fd);
+  unlink("test_file.txt");
+
+  read(client_fd, buf, MESSAGE_LEN - 6);
+
+  ck_assert_str_eq(buf, "world!");
+}
+END_TEST
+
 START_TEST(test_tcp_connection_fails)
 {
   struct TcpConnection *tcp_connection = NULL;
@@ -159,6 +181,7 @@ tcp_connection_suite(void)
   tcase_add_test(tc, test_tcp_connection_calls_write_callback_when_can_read);
   tcase_add_test(tc, test_tcp_connection_calls_close_callback_when_the_peer_disconnects);
   tcase_add_test(tc, test_tcp_connection_sendfile);
+  tcase_add_test(tc, test_tcp_connection_sendfile_from_offset);
   tcase_add_test(tc, test_tcp_connection_fails);
   suite_add_tcase(s, tc);
 
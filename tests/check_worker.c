@@ -0,0 +1,141 @@
+/*
+ * check_worker.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <check.h>
+
+#include <config.h>
+
+#include <logger.h>
+#include <httprouter.h>
+#include <worker.h>
+
+#include "test_memstubs.h"
+#include "test_utils.h"
+
+#define HOST "127.0.0.1"
+#define PORT 8001
+
+
+static struct Logger *logger = NULL;
+static struct HTTPRouter *router = NULL;
+
+void
+setup(void)
+{
+  logger = logger_new_null();
+  router = http_router_new(logger, ROUTE_MATCH_FIRST);
+}
+
+void
+teardown(void)
+{
+  http_router_destroy(router);
+  logger_destroy(logger);
+}
+
+START_TEST(test_worker_accepts_connections)
+{
+  struct Worker *worker = worker_new(logger, router, NULL);
+  int client_fd = -1;
+
+  ck_assert(worker != NULL);
+  ck_assert_call_ok(worker_start, worker, HOST, PORT);
+
+  client_fd = connect_to(HOST, PORT);
+  ck_assert(client_fd >= 0);
+  close(client_fd);
+
+  worker_stop(worker);
+  ck_assert_call_ok(worker_join, worker);
+  worker_destroy(worker);
+}
+END_TEST
+
+START_TEST(test_worker_stop_before_running)
+{
+  struct Worker *worker = worker_new(logger, router, NULL);
+
+  ck_assert(worker != NULL);
+  ck_assert_call_ok(worker_start, worker, HOST, PORT);
+
+  worker_stop(worker);
+  worker_destroy(worker);
+}
+END_TEST
+
+#ifdef SO_REUSEPORT_FOUND
+START_TEST(test_workers_share_the_same_port)
+{
+  struct Worker *first = worker_new(logger, router, NULL);
+  struct Worker *second = worker_new(logger, router, NULL);
+  int client_fd = -1;
+
+  ck_assert(first != NULL);
+  ck_assert(second != NULL);
+  ck_assert_call_ok(worker_start, first, HOST, PORT);
+  ck_assert_call_ok(worker_start, second, HOST, PORT);
+
+  client_fd = connect_to(HOST, PORT);
+  ck_assert(client_fd >= 0);
+  close(client_fd);
+
+  worker_destroy(first);
+  worker_destroy(second);
+}
+END_TEST
+#endif
+
+START_TEST(test_worker_new_fails)
+{
+  struct Worker *worker = NULL;
+
+  memstub_failure_enable(0, 1);
+  worker = worker_new(logger, router, NULL);
+  ck_assert(worker == NULL);
+  memstub_failure_disable();
+}
+END_TEST
+
+static Suite *
+worker_suite(void)
+{
+  Suite *s = suite_create("rapp.core.worker");
+  TCase *tc = tcase_create("rapp.core.worker");
+
+  tcase_add_checked_fixture(tc, setup, teardown);
+  tcase_add_test(tc, test_worker_accepts_connections);
+  tcase_add_test(tc, test_worker_stop_before_running);
+#ifdef SO_REUSEPORT_FOUND
+  tcase_add_test(tc, test_workers_share_the_same_port);
+#endif
+  tcase_add_test(tc, test_worker_new_fails);
+  suite_add_tcase(s, tc);
+
+  return s;
+}
+
+int
+main (void)
+{
+ int number_failed = 0;
+
+ Suite *s = worker_suite ();
+ SRunner *sr = srunner_create (s);
+
+ srunner_run_all (sr, CK_NORMAL);
+ number_failed = srunner_ntests_failed (sr);
+ srunner_free (sr);
+
+ return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */
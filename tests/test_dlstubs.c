@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include "rapp/rapp_async.h"
 #include "rapp/rapp_version.h"
 
 #include "test_dlstubs.h"
@@ -145,6 +146,27 @@ dummy_serve(void *handle,
   return 0;
 }
 
+static int
+dummy_serve_async(void *handle,
+                  void *http_request,
+                  void *response,
+                  void *context)
+{
+  mark_invoked("rapp_serve_async");
+  if (has_flag("rapp_serve_async", DLSTUB_ERR_PLUGIN)) {
+    return -1;
+  }
+  return RAPP_SERVE_PENDING;
+}
+
+static int
+dummy_stream_body(void *handle,
+                  void *http_request)
+{
+  mark_invoked("rapp_stream_body");
+  return 1;
+}
+
 static void *
 lookup_sym(const char *sym)
 {
@@ -157,6 +179,10 @@ lookup_sym(const char *sym)
     return &dummy_destroy;
   } else if (!strcmp(sym, "rapp_serve")) {
     return &dummy_serve;
+  } else if (!strcmp(sym, "rapp_serve_async")) {
+    return &dummy_serve_async;
+  } else if (!strcmp(sym, "rapp_stream_body")) {
+    return &dummy_stream_body;
   } else if (!strcmp(sym, "rapp_init")) {
     return &dummy_init;
   }
@@ -198,7 +224,11 @@ dlopen(const char *filename,
 char *
 dlerror(void)
 {
-   return (dummy.errors) ?"dlstub error" :NULL;
+   /* like the real one, an error is reported once */
+   if (dummy.errors == 0)
+     return NULL;
+   dummy.errors = 0;
+   return "dlstub error";
 }
 
 void
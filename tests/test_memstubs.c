@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "memory.h"
 #include "test_memstubs.h"
 
 struct MemConf {
@@ -112,6 +113,25 @@ memory_destroy(void *mem)
   free(mem);
 }
 
+void *
+memory_pool_create(enum MemoryPoolType type,
+                   size_t              size)
+{
+  return memory_create(size);
+}
+
+void
+memory_pool_destroy(enum MemoryPoolType type,
+                    void               *mem)
+{
+  free(mem);
+}
+
+void
+memory_pool_cleanup(void)
+{
+}
+
 /*
  * vim: expandtab shiftwidth=2 tabstop=2:
  */
@@ -31,3 +31,18 @@ const char *yaml_wrong_bool = "---\ncore: {boolvalue: absderrg}";
 const char *yaml_wrong_string = "---\ncore: {strvalue: }";
 const char *yaml_wrong_multivalued = "---\ncore: {singlevalue: [1,2,3]}";
 const char *yaml_malformed = "---\ncore: {: [1,2,3]}";
+
+const char *yaml_routes =
+"---\n"
+"core:\n"
+"    address : \"127.0.0.1\"\n"
+"routes:\n"
+"    /: /usr/lib/rapp/hello.so\n"
+"    /static: /usr/lib/rapp/files.so\n";
+
+const char *yaml_routes_inline =
+"---\n"
+"routes: {/: /usr/lib/rapp/index.so, /api: /usr/lib/rapp/api.so}";
+
+const char *yaml_wrong_route = "---\nroutes: {static: /usr/lib/rapp/files.so}";
+const char *yaml_wrong_route2 = "---\nroutes: {/static: [1,2,3]}";
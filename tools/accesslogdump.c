@@ -0,0 +1,142 @@
+/*
+ * accesslogdump.c - is part of RApp.
+ * RApp is a modular web application container made for linux and for speed.
+ * (C) 2013-2014 the RApp devs. Licensed under GPLv2 with additional rights.
+ *     see LICENSE for all the details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "rapp/rapp_httprequest.h"
+
+#include "accesslog.h"
+
+
+/*
+ * Prints the records of binary access logs one per line, in the order
+ * they were written:
+ *   <time> <method> <url> <status> <bytes> <latency in microseconds>
+ * A url ending with ... has been truncated.
+ */
+
+static const char *method_names[HTTP_METHOD_MAX] = {
+  [HTTP_METHOD_DELETE] = "DELETE",
+  [HTTP_METHOD_GET] = "GET",
+  [HTTP_METHOD_HEAD] = "HEAD",
+  [HTTP_METHOD_POST] = "POST",
+  [HTTP_METHOD_PUT] = "PUT",
+  [HTTP_METHOD_CONNECT] = "CONNECT",
+  [HTTP_METHOD_OPTIONS] = "OPTIONS",
+  [HTTP_METHOD_TRACE] = "TRACE",
+  [HTTP_METHOD_COPY] = "COPY",
+  [HTTP_METHOD_LOCK] = "LOCK",
+  [HTTP_METHOD_MKCOL] = "MKCOL",
+  [HTTP_METHOD_MOVE] = "MOVE",
+  [HTTP_METHOD_PROPFIND] = "PROPFIND",
+  [HTTP_METHOD_PROPPATCH] = "PROPPATCH",
+  [HTTP_METHOD_SEARCH] = "SEARCH",
+  [HTTP_METHOD_UNLOCK] = "UNLOCK",
+  [HTTP_METHOD_REPORT] = "REPORT",
+  [HTTP_METHOD_MKACTIVITY] = "MKACTIVITY",
+  [HTTP_METHOD_CHECKOUT] = "CHECKOUT",
+  [HTTP_METHOD_MERGE] = "MERGE",
+  [HTTP_METHOD_MSEARCH] = "M-SEARCH",
+  [HTTP_METHOD_NOTIFY] = "NOTIFY",
+  [HTTP_METHOD_SUBSCRIBE] = "SUBSCRIBE",
+  [HTTP_METHOD_UNSUBSCRIBE] = "UNSUBSCRIBE",
+  [HTTP_METHOD_PATCH] = "PATCH",
+  [HTTP_METHOD_PURGE] = "PURGE",
+};
+
+static void
+print_record(const struct AccessLogRecord *record)
+{
+  char datetime[32];
+  time_t seconds = record->timestamp / 1000000;
+  struct tm tm;
+  const char *method = "-";
+  size_t url_length = record->url_length;
+
+  gmtime_r(&seconds, &tm);
+  strftime(datetime, sizeof(datetime), "%Y-%m-%dT%H:%M:%S", &tm);
+
+  if (record->method < HTTP_METHOD_MAX)
+    method = method_names[record->method];
+
+  if (url_length > ACCESS_LOG_URL_LEN)
+    url_length = ACCESS_LOG_URL_LEN;
+
+  printf("%s.%06uZ %s %.*s%s %u %" PRIu64 " %" PRIu32 "\n",
+         datetime, (unsigned)(record->timestamp % 1000000), method,
+         (int)url_length, url_length > 0 ? record->url : "-",
+         record->url_length > ACCESS_LOG_URL_LEN ? "..." : "",
+         record->status, record->bytes, record->latency);
+}
+
+static int
+dump_file(const char *path)
+{
+  struct AccessLogHeader header;
+  struct AccessLogRecord record;
+  FILE *file = NULL;
+  int ret = 0;
+
+  if ((file = fopen(path, "rb")) == NULL) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      memcmp(header.magic, ACCESS_LOG_MAGIC, sizeof(header.magic)) != 0) {
+    fprintf(stderr, "%s: not an access log\n", path);
+    fclose(file);
+    return -1;
+  }
+
+  if (header.version != ACCESS_LOG_VERSION || header.record_size != sizeof(record)) {
+    fprintf(stderr, "%s: unsupported version %u (record size %u)\n", path, header.version, header.record_size);
+    fclose(file);
+    return -1;
+  }
+
+  /* a segment still being written ends with zeroes */
+  while (fread(&record, sizeof(record), 1, file) == 1 && record.timestamp != 0)
+    print_record(&record);
+
+  if (ferror(file)) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    ret = -1;
+  }
+
+  fclose(file);
+
+  return ret;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int ret = EXIT_SUCCESS;
+  int i;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s FILE...\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  for (i = 1; i < argc; i++) {
+    if (dump_file(argv[i]) < 0)
+      ret = EXIT_FAILURE;
+  }
+
+  return ret;
+}
+
+/*
+ * vim: expandtab shiftwidth=2 tabstop=2:
+ */